@@ -0,0 +1,467 @@
+#include "AdaptiveWaterGrid.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+
+AdaptiveWaterGrid::AdaptiveWaterGrid(int width, int height,
+                                     float stretchness, float lossyness) :
+    maxLeafSize(16),
+    adaptPeriod(8),
+    refineThreshold(2.0e-3f),
+    coarsenThreshold(4.0e-4f),
+    groundTolerance(1.0e-3f),
+    _WIDTH(width),
+    _HEIGHT(height),
+    // The lattice stencil weights neighbors by 1/d^2 over a radius of 2,
+    // which approximates 3/7 of the laplacian. Faces use the same speed.
+    _GAIN(stretchness * 3.0f / 7.0f),
+    _LOSSYNESS(lossyness),
+    _ground(),
+    _nodes(),
+    _leafOf(),
+    _leaves(),
+    _faces(),
+    _oldFaces(),
+    _outflow(),
+    _stepCount(0)
+{
+}
+
+void AdaptiveWaterGrid::setup(const FieldArray& ground,
+                              const FieldArray& water)
+{
+    _ground.assign(ground.begin(), ground.end());
+    _nodes.clear();
+    _faces.clear();
+    _leafOf.assign(_WIDTH * _HEIGHT, -1);
+    _stepCount = 0;
+
+    int rootSize = 1;
+    while(rootSize < max(_WIDTH, _HEIGHT))
+        rootSize *= 2;
+
+    _nodes.reserve((4 * _WIDTH * _HEIGHT) / 3 + rootSize);
+    buildNode(0, 0, rootSize, -1);
+
+    // Start fully refined, then let the calm regions collapse
+    for(size_t n=0; n<_nodes.size(); ++n)
+    {
+        QuadNode& node = _nodes[n];
+        if(node.size != 1)
+            continue;
+
+        int cell = node.y * _WIDTH + node.x;
+        node.isLeaf = true;
+        node.volume = max(water[cell] - ground[cell], 0.0f);
+        fillLevel(node);
+        paintLeaf(static_cast<int>(n));
+    }
+
+    collectLeaves();
+    buildFaces();
+
+    for(int s=1; s < maxLeafSize; s *= 2)
+        adapt();
+}
+
+int AdaptiveWaterGrid::buildNode(int x, int y, int size, int parent)
+{
+    if(x >= _WIDTH || y >= _HEIGHT)
+        return -1;
+
+    int n = static_cast<int>(_nodes.size());
+    _nodes.push_back(QuadNode());
+
+    QuadNode node;
+    node.x = x;
+    node.y = y;
+    node.w = min(size, _WIDTH - x);
+    node.h = min(size, _HEIGHT - y);
+    node.size = size;
+    node.parent = parent;
+    node.isLeaf = false;
+    node.volume = 0.0;
+    node.level = 0.0f;
+    node.activity = 0.0f;
+    node.firstFace = 0;
+    node.faceCount = 0;
+    fill(node.children, node.children + 4, -1);
+
+    if(size == 1)
+    {
+        float g = _ground[y * _WIDTH + x];
+        node.groundMin = g;
+        node.groundMax = g;
+        node.groundSum = g;
+    }
+    else
+    {
+        int half = size / 2;
+        node.children[0] = buildNode(x,        y,        half, n);
+        node.children[1] = buildNode(x + half, y,        half, n);
+        node.children[2] = buildNode(x,        y + half, half, n);
+        node.children[3] = buildNode(x + half, y + half, half, n);
+
+        node.groundMin =  INFINITY;
+        node.groundMax = -INFINITY;
+        node.groundSum = 0.0;
+        for(int c=0; c<4; ++c)
+        {
+            if(node.children[c] < 0)
+                continue;
+
+            const QuadNode& child = _nodes[node.children[c]];
+            node.groundMin = min(node.groundMin, child.groundMin);
+            node.groundMax = max(node.groundMax, child.groundMax);
+            node.groundSum += child.groundSum;
+        }
+    }
+
+    _nodes[n] = node;
+    return n;
+}
+
+void AdaptiveWaterGrid::fillLevel(QuadNode& node)
+{
+    double area = node.w * node.h;
+
+    if(node.volume <= 0.0)
+    {
+        node.volume = 0.0;
+        node.level = node.groundMin;
+    }
+    else if(node.volume >= area * node.groundMax - node.groundSum)
+    {
+        node.level = static_cast<float>((node.volume + node.groundSum) / area);
+    }
+    else
+    {
+        // Partially wet leaf, only happens over nearly flat ground
+        float low = node.groundMin;
+        float high = node.groundMax;
+        for(int it=0; it < 24; ++it)
+        {
+            float mid = (low + high) * 0.5f;
+            if(volumeUnder(node, mid) < node.volume)
+                low = mid;
+            else
+                high = mid;
+        }
+        node.level = (low + high) * 0.5f;
+    }
+}
+
+double AdaptiveWaterGrid::volumeUnder(const QuadNode& node, float level) const
+{
+    if(level >= node.groundMax)
+        return node.w * node.h * static_cast<double>(level) - node.groundSum;
+
+    double volume = 0.0;
+    for(int j=node.y; j < node.y + node.h; ++j)
+        for(int i=node.x; i < node.x + node.w; ++i)
+            volume += max(level - _ground[j * _WIDTH + i], 0.0f);
+    return volume;
+}
+
+void AdaptiveWaterGrid::step()
+{
+    _outflow.resize(_nodes.size());
+    for(size_t l=0; l<_leaves.size(); ++l)
+        _outflow[_leaves[l]] = 0.0;
+
+    for(size_t f=0; f<_faces.size(); ++f)
+    {
+        Face& face = _faces[f];
+        float dLevel = _nodes[face.a].level - _nodes[face.b].level;
+        face.flux = face.flux * (1.0f - _LOSSYNESS) +
+                    _GAIN * dLevel * face.edge / face.distance;
+
+        if(face.flux > 0.0f)
+            _outflow[face.a] += face.flux;
+        else
+            _outflow[face.b] -= face.flux;
+    }
+
+    // A leaf can not give more water than it holds
+    for(size_t f=0; f<_faces.size(); ++f)
+    {
+        Face& face = _faces[f];
+        int giver = face.flux > 0.0f ? face.a : face.b;
+        double available = _nodes[giver].volume;
+        double out = _outflow[giver];
+        if(out > available)
+            face.flux = static_cast<float>(face.flux * (available / out));
+    }
+
+    for(size_t f=0; f<_faces.size(); ++f)
+    {
+        const Face& face = _faces[f];
+        _nodes[face.a].volume -= face.flux;
+        _nodes[face.b].volume += face.flux;
+    }
+
+    for(size_t l=0; l<_leaves.size(); ++l)
+        fillLevel(_nodes[_leaves[l]]);
+
+    ++_stepCount;
+    if(_stepCount % adaptPeriod == 0)
+        adapt();
+}
+
+void AdaptiveWaterGrid::resample(FieldArray& water) const
+{
+    water.resize(_WIDTH * _HEIGHT);
+
+    for(size_t l=0; l<_leaves.size(); ++l)
+    {
+        const QuadNode& node = _nodes[_leaves[l]];
+        for(int j=node.y; j < node.y + node.h; ++j)
+        {
+            const float* ground = &_ground[j * _WIDTH];
+            float* surface = &water[j * _WIDTH];
+            for(int i=node.x; i < node.x + node.w; ++i)
+                surface[i] = max(node.level, ground[i]);
+        }
+    }
+}
+
+double AdaptiveWaterGrid::volume() const
+{
+    double total = 0.0;
+    for(size_t l=0; l<_leaves.size(); ++l)
+        total += _nodes[_leaves[l]].volume;
+    return total;
+}
+
+void AdaptiveWaterGrid::adapt()
+{
+    for(size_t l=0; l<_leaves.size(); ++l)
+        _nodes[_leaves[l]].activity = 0.0f;
+
+    for(size_t f=0; f<_faces.size(); ++f)
+    {
+        const Face& face = _faces[f];
+        QuadNode& a = _nodes[face.a];
+        QuadNode& b = _nodes[face.b];
+
+        // Dry sides of a wet front are not waves, unless water is flowing
+        float slope = 0.0f;
+        if(a.volume > 0.0 && b.volume > 0.0)
+            slope = fabs(a.level - b.level) / face.distance;
+        float flow = fabs(face.flux) / face.edge;
+
+        float activity = max(slope, flow);
+        a.activity = max(a.activity, activity);
+        b.activity = max(b.activity, activity);
+    }
+
+    bool changed = false;
+    vector<int> leaves = _leaves;
+
+    for(size_t l=0; l<leaves.size(); ++l)
+    {
+        int n = leaves[l];
+        const QuadNode& node = _nodes[n];
+        if(node.isLeaf && node.size > 1 && !isCalm(node))
+        {
+            refine(n);
+            changed = true;
+        }
+    }
+
+    for(size_t l=0; l<leaves.size(); ++l)
+    {
+        int p = _nodes[leaves[l]].parent;
+        if(p < 0 || !canCoarsen(_nodes[p]))
+            continue;
+
+        coarsen(p);
+        changed = true;
+    }
+
+    if(changed)
+    {
+        collectLeaves();
+        buildFaces();
+    }
+}
+
+bool AdaptiveWaterGrid::isCalm(const QuadNode& node) const
+{
+    return node.activity < refineThreshold;
+}
+
+bool AdaptiveWaterGrid::canCoarsen(const QuadNode& parent) const
+{
+    if(parent.isLeaf || parent.size > maxLeafSize)
+        return false;
+    if(parent.groundMax - parent.groundMin > groundTolerance)
+        return false;
+
+    for(int c=0; c<4; ++c)
+    {
+        if(parent.children[c] < 0)
+            continue;
+
+        const QuadNode& child = _nodes[parent.children[c]];
+        if(!child.isLeaf || child.activity >= coarsenThreshold)
+            return false;
+    }
+
+    return true;
+}
+
+void AdaptiveWaterGrid::refine(int n)
+{
+    QuadNode& node = _nodes[n];
+    node.isLeaf = false;
+
+    // Children share the parent's level, the last one takes the rounding
+    double remaining = node.volume;
+    int last = -1;
+    for(int c=0; c<4; ++c)
+    {
+        int k = node.children[c];
+        if(k < 0)
+            continue;
+
+        QuadNode& child = _nodes[k];
+        child.isLeaf = true;
+        child.activity = node.activity;
+        child.faceCount = 0;
+        child.volume = min(volumeUnder(child, node.level), remaining);
+        remaining -= child.volume;
+        last = k;
+    }
+    _nodes[last].volume += remaining;
+
+    for(int c=0; c<4; ++c)
+    {
+        int k = node.children[c];
+        if(k < 0)
+            continue;
+
+        fillLevel(_nodes[k]);
+        paintLeaf(k);
+    }
+}
+
+void AdaptiveWaterGrid::coarsen(int n)
+{
+    QuadNode& node = _nodes[n];
+    node.isLeaf = true;
+    node.volume = 0.0;
+    node.activity = 0.0f;
+    node.faceCount = 0;
+
+    for(int c=0; c<4; ++c)
+    {
+        int k = node.children[c];
+        if(k < 0)
+            continue;
+
+        QuadNode& child = _nodes[k];
+        child.isLeaf = false;
+        node.volume += child.volume;
+        node.activity = max(node.activity, child.activity);
+    }
+
+    fillLevel(node);
+    paintLeaf(n);
+}
+
+void AdaptiveWaterGrid::paintLeaf(int n)
+{
+    const QuadNode& node = _nodes[n];
+    for(int j=node.y; j < node.y + node.h; ++j)
+        fill(&_leafOf[j * _WIDTH + node.x],
+             &_leafOf[j * _WIDTH + node.x] + node.w, n);
+}
+
+void AdaptiveWaterGrid::collectLeaves()
+{
+    _leaves.clear();
+
+    vector<int> stack(1, 0);
+    while(!stack.empty())
+    {
+        int n = stack.back();
+        stack.pop_back();
+
+        const QuadNode& node = _nodes[n];
+        if(node.isLeaf)
+        {
+            _leaves.push_back(n);
+            continue;
+        }
+
+        for(int c=0; c<4; ++c)
+            if(node.children[c] >= 0)
+                stack.push_back(node.children[c]);
+    }
+}
+
+void AdaptiveWaterGrid::buildFaces()
+{
+    // Faces between leaves that survived keep their momentum
+    _oldFaces.swap(_faces);
+    _faces.clear();
+
+    for(size_t l=0; l<_leaves.size(); ++l)
+    {
+        int a = _leaves[l];
+        QuadNode& node = _nodes[a];
+
+        int oldFirst = node.firstFace;
+        int oldCount = node.faceCount;
+        node.firstFace = static_cast<int>(_faces.size());
+
+        // Each leaf owns the faces on its right and top borders
+        for(int side=0; side < 2; ++side)
+        {
+            bool isRight = (side == 0);
+            int border = isRight ? node.x + node.w : node.y + node.h;
+            if(border >= (isRight ? _WIDTH : _HEIGHT))
+                continue;
+
+            int first = isRight ? node.y : node.x;
+            int last  = isRight ? node.y + node.h : node.x + node.w;
+
+            int t = first;
+            while(t < last)
+            {
+                int cell = isRight ? t * _WIDTH + border : border * _WIDTH + t;
+                int b = _leafOf[cell];
+                const QuadNode& other = _nodes[b];
+
+                int runEnd = isRight ? min(last, other.y + other.h) :
+                                       min(last, other.x + other.w);
+
+                Face face;
+                face.a = a;
+                face.b = b;
+                face.edge = static_cast<float>(runEnd - t);
+                face.distance = isRight ? (node.w + other.w) * 0.5f :
+                                          (node.h + other.h) * 0.5f;
+                face.flux = 0.0f;
+
+                for(int f=oldFirst; f < oldFirst + oldCount; ++f)
+                {
+                    if(_oldFaces[f].b == b)
+                    {
+                        face.flux = _oldFaces[f].flux;
+                        break;
+                    }
+                }
+
+                _faces.push_back(face);
+                t = runEnd;
+            }
+        }
+
+        node.faceCount = static_cast<int>(_faces.size()) - node.firstFace;
+    }
+}
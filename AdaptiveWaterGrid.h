@@ -0,0 +1,112 @@
+#ifndef ADAPTIVEWATERGRID_H
+#define ADAPTIVEWATERGRID_H
+
+#include <vector>
+
+#include "FieldAllocator.h"
+
+
+// Multi-resolution water surface stored as the leaves of a quadtree laid
+// over the lattice. Calm regions are merged into large leaves while wavy
+// regions are refined down to single cells.
+//
+// Each leaf stores a water volume. Its surface is the level at which that
+// volume fills the leaf's ground. Water moves through fluxes carried by the
+// faces shared between adjacent leaves, so every exchange removes from one
+// leaf exactly what it adds to the other. Refinement and coarsening only
+// redistribute volumes among siblings, which keeps the total constant.
+class AdaptiveWaterGrid
+{
+public:
+    AdaptiveWaterGrid(int width, int height, float stretchness, float lossyness);
+
+    void setup(const FieldArray& ground,
+               const FieldArray& water);
+    void step();
+    void resample(FieldArray& water) const;
+
+    int leafCount() const;
+    int faceCount() const;
+    double volume() const;
+
+    // Adaptation tuning
+    int maxLeafSize;
+    int adaptPeriod;
+    float refineThreshold;
+    float coarsenThreshold;
+    float groundTolerance;
+
+protected:
+    struct QuadNode
+    {
+        int x, y;
+        int w, h;
+        int size;
+        int parent;
+        int children[4];
+        bool isLeaf;
+
+        float groundMin;
+        float groundMax;
+        double groundSum;
+
+        double volume;
+        float level;
+        float activity;
+
+        int firstFace;
+        int faceCount;
+    };
+
+    struct Face
+    {
+        int a;
+        int b;
+        float edge;
+        float distance;
+        float flux;
+    };
+
+    int buildNode(int x, int y, int size, int parent);
+    void fillLevel(QuadNode& node);
+    double volumeUnder(const QuadNode& node, float level) const;
+
+    void adapt();
+    bool isCalm(const QuadNode& node) const;
+    bool canCoarsen(const QuadNode& parent) const;
+    void refine(int n);
+    void coarsen(int n);
+    void paintLeaf(int n);
+    void collectLeaves();
+    void buildFaces();
+
+private:
+    const int _WIDTH;
+    const int _HEIGHT;
+    const float _GAIN;
+    const float _LOSSYNESS;
+
+    std::vector<float> _ground;
+    std::vector<QuadNode> _nodes;
+    std::vector<int> _leafOf;
+    std::vector<int> _leaves;
+    std::vector<Face> _faces;
+    std::vector<Face> _oldFaces;
+    std::vector<double> _outflow;
+    int _stepCount;
+};
+
+
+
+// IMPLEMENTATION //
+inline int AdaptiveWaterGrid::leafCount() const
+{
+    return static_cast<int>(_leaves.size());
+}
+
+inline int AdaptiveWaterGrid::faceCount() const
+{
+    return static_cast<int>(_faces.size());
+}
+
+#endif // ADAPTIVEWATERGRID_H
@@ -0,0 +1,80 @@
+#include "BasinWaterRun.h"
+
+#include <iostream>
+
+#include "WaterScheduler.h"
+#include "WaterSimulation.h"
+#include "WorkerPool.h"
+
+using namespace std;
+
+
+BasinWaterRun::BasinWaterRun(const WaterOptions& options) :
+    HeadlessWaterRun(options),
+    _basins(),
+    _simulations(),
+    _stepCounts()
+{
+}
+
+BasinWaterRun::~BasinWaterRun()
+{
+}
+
+int BasinWaterRun::execute()
+{
+    _basins = WaterBasin::read(_options.basinsFile, _options.scenario);
+
+    WaterScheduler scheduler(getWorkerPool());
+    scheduler.setCellBudget(_options.cellBudget);
+
+    double cells = 0.0;
+    for(size_t b=0; b < _basins.size(); ++b)
+    {
+        const WaterBasin& basin = _basins[b];
+        _simulations.emplace_back(new WaterSimulation(basin.options(_options, b)));
+        _simulations.back()->schedule(scheduler, "basin " + to_string(b) + " " + basin.scenario,
+                                      basin.priority, basin.stepRate);
+        _simulations.back()->reset();
+        cells += double(basin.width) * basin.height;
+    }
+
+    cout << "Basin run: " << _basins.size() << " basins, " << cells
+         << " cells, " << _options.stepCount << " ticks" << endl;
+
+    for(int t=0; t < _options.stepCount; ++t)
+        scheduler.tick();
+
+    scheduler.report(cout);
+
+    for(int b=0; b < scheduler.instanceCount(); ++b)
+        _stepCounts.push_back(scheduler.stepCount(b));
+
+    return _options.verify ? verify() : 0;
+}
+
+int BasinWaterRun::verify() const
+{
+    int mismatches = 0;
+    for(size_t b=0; b < _basins.size(); ++b)
+    {
+        // Not published, the scheduled basin holds the segment
+        WaterOptions aloneOptions = _basins[b].options(_options, b);
+        aloneOptions.publishName.clear();
+        WaterSimulation alone(aloneOptions);
+        alone.reset();
+        for(int s=0; s < _stepCounts[b]; ++s)
+            alone.step();
+
+        if(alone.waterHeights() != _simulations[b]->waterHeights() ||
+           alone.checksum() != _simulations[b]->checksum())
+        {
+            cout << "Basin " << b << " differs from stepping it alone" << endl;
+            ++mismatches;
+        }
+    }
+
+    if(mismatches == 0)
+        cout << "Basin run: every basin matches stepping it alone" << endl;
+    return mismatches == 0 ? 0 : 1;
+}
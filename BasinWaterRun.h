@@ -0,0 +1,36 @@
+#ifndef BASINWATERRUN_H
+#define BASINWATERRUN_H
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "WaterBasin.h"
+#include "HeadlessWaterRun.h"
+
+class WaterSimulation;
+
+
+// Headless run of separate basins stepped together by one scheduler on the
+// process wide pool, the simulations the windowed play shows side by side.
+//
+// Verification steps a copy of each basin on its own and checks that the
+// scheduled surfaces are the same, bit for bit.
+class BasinWaterRun : public HeadlessWaterRun
+{
+public:
+    BasinWaterRun(const WaterOptions& options);
+    virtual ~BasinWaterRun();
+
+    virtual int execute();
+
+protected:
+    int verify() const;
+
+private:
+    std::vector<WaterBasin> _basins;
+    std::vector<std::unique_ptr<WaterSimulation>> _simulations;
+    std::vector<int> _stepCounts;
+};
+
+#endif // BASINWATERRUN_H
@@ -1,45 +1,34 @@
 #ifndef CPUWATERSIM_H
 #define CPUWATERSIM_H
 
-#include <DesignPattern/SpecificObserver.h>
-#include <Camera/Camera.h>
 #include <Camera/CameraManFree.h>
-#include <Light/Light3D.h>
-#include <GL/GlProgram.h>
-#include <GL/GlVao.h>
 #include <GL/GLFFmpegCamcorder.h>
 
 #include <Hud/TextHud.h>
 
 #include <Character/AbstractCharacter.h>
 
-#include <vector>
+#include <chrono>
+#include <memory>
+#include <string>
 
-#include <cassert>
+#include "FrameTimeStats.h"
+#include "SessionRecord.h"
+#include "WaterBasin.h"
+#include "WaterOptions.h"
+#include "WaterRenderer.h"
+#include "WaterSimulation.h"
 
 
-struct Node
-{
-    int index;
-    bool isExchangePermitted;
-    bool isSurpervisingExchange;
-    float baseContribution;
-    float currContribution;
-    float velocity;
-};
-
-struct Vertex
-{
-    Node node;
-    std::vector< Node > neighbors;
-};
-
-
-class CpuWaterSim : public scaena::AbstractCharacter,
-                    public cellar::SpecificObserver<media::CameraMsg>
+class CpuWaterSim : public scaena::AbstractCharacter
 {
 public:
-    CpuWaterSim(scaena::AbstractStage& stage);
+    CpuWaterSim(scaena::AbstractStage& stage, const WaterOptions& options);
+
+    // One basin of a scene, stepped by the scheduler's ticks and drawn
+    // beside the others. The first basin drives the camera.
+    CpuWaterSim(scaena::AbstractStage& stage, const WaterOptions& options,
+                WaterScheduler& scheduler, const WaterBasin& basin, int index);
     virtual ~CpuWaterSim();
 
     virtual void enterStage();
@@ -50,70 +39,40 @@ public:
 
     virtual bool keyPressEvent(const scaena::KeyboardEvent& event);
 
-    virtual void notify(media::CameraMsg &msg);
+    // Thread safe, commands are applied at the start of the next step
+    DisturbanceQueue& disturbances();
 
 protected:
-    void setupLattice();
-    void setupGround();
-    void setupWalls();
-    void setupWater();
-    void setupVerticesAndNeighbors();
-    void setupLight();
-    void setupTextures();
-    void setupShader();
-
-    // Vertex attribute
-    int index(int i, int j);
-    bool isInBounds(int i, int j);
-    bool isNeighbor(int ni, int nj);
-    float baseContribution(int ni, int nj);
-    void position(int index, int& i, int& j);
-    float height(int index);
-    float floorHeight(int index);
-    float overFloor(int index);
-    bool isOnFloor(int index);
-    float deltaHeight(int index1, int index2);
-    bool isExchangePermitted(int index1, int index2);
-    bool needExchangeHandling(const Node& neighbor);
-
-    void realPosition(int i, int j, float& x, float& y);
-    float groundInitHeight(int i, int j);
-    float waterInitHeight(int i, int j);
-    float waterInitVelocity(int i, int j);
+    bool stepSession(const scaena::StageTime& time);
+    void moveCamera(const scaena::StageTime& time);
+    void recordFrame();
+    void finishReplay();
 
 private:
-    const float _STRETCHNESS;
-    const float _LOSSYNESS;
-
-    const int _WIDTH;
-    const int _HEIGHT;
-    const int _ARRAY_SIZE;
-
-    const int _NEIGHBORS_RADIUS;
+    CpuWaterSim(scaena::AbstractStage& stage, const WaterOptions& options,
+                WaterScheduler* scheduler, const WaterBasin* basin, int index);
 
-    std::vector< Vertex > _vertices;
+    const WaterOptions _options;
+    const int _BASIN_INDEX;
+    const std::string _BASIN_NAME;
 
-    std::vector<unsigned int> _latticeIndices;
+    WaterSimulation _simulation;
 
-    GLuint _groundTex;
-    media::GlVao _groundVao;
-    std::vector<cellar::Vec3f> _groundPositions;
-    media::Material _groundMaterial;
+    // Session record and replay
+    std::unique_ptr<SessionRecorder> _recorder;
+    std::unique_ptr<SessionPlayer> _player;
+    SessionFrame _frame;
+    std::string _pendingKeys;
+    int _replayMismatches;
+    FrameTimeStats _frameTimes;
+    FrameTimeStats _stepTimes;
 
-    GLuint _wallsTex;
-    media::GlVao _wallsVao;
-    media::Material _wallsMaterial;
+    // Startup
+    std::chrono::steady_clock::time_point _startupTime;
+    bool _isFirstFrame;
 
-    GLuint _waterTex;
-    media::GlVao _waterVao;
-    std::vector<cellar::Vec3f> _waterPositions;
-    std::vector<cellar::Vec3f> _waterNormals;
-    std::vector<float> _waterVelocities;
-    media::Material _waterMaterial;
-
-    media::PointLight3D _pointLight;
+    WaterRenderer _renderer;
     media::CameraManFree _cameraMan;
-    media::GlProgram _renderShader;
 
     std::shared_ptr<prop2::TextHud> _fps;
 
@@ -123,92 +82,9 @@ private:
 
 
 // IMPLEMENTATION //
-inline int CpuWaterSim::index(int i, int j)
-{
-    assert( isInBounds(i, j) );
-    return j*_WIDTH + i;
-}
-
-inline bool CpuWaterSim::isInBounds(int i, int j)
-{
-    return cellar::inRange(i, 0, _WIDTH-1) &&
-           cellar::inRange(j, 0, _HEIGHT-1);
-}
-
-inline bool CpuWaterSim::isNeighbor(int ni, int nj)
-{
-    return cellar::Vec2f(ni, nj).length() <= _NEIGHBORS_RADIUS;
-}
-
-inline float CpuWaterSim::baseContribution(int ni, int nj)
-{
-    assert( !((ni == 0) && (nj == 0)) );
-    return 1.0f / cellar::Vec2f(ni, nj).length2();
-}
-
-inline void CpuWaterSim::position(int index, int& i, int& j)
-{
-    assert( (0 <= index) && (index < _WIDTH*_HEIGHT) );
-    i = index % _WIDTH;
-    j = index / _WIDTH;
-}
-
-inline float CpuWaterSim::height(int index)
-{
-    return _waterPositions[index].z();
-}
-
-inline float CpuWaterSim::floorHeight(int index)
-{
-    return _groundPositions[index].z();
-}
-
-inline float CpuWaterSim::overFloor(int index)
-{
-    float over = height(index) - floorHeight(index);
-    if(over < 0.0f)
-    {
-        _waterPositions[index].setZ(_groundPositions[index].z());
-        over = 0.0f;
-    }
-    return over;
-}
-
-inline bool CpuWaterSim::isOnFloor(int index)
-{
-    return height(index) <= floorHeight(index);
-}
-
-inline float CpuWaterSim::deltaHeight(int index1, int index2)
-{
-    return height(index2) - height(index1);
-}
-
-inline bool CpuWaterSim::isExchangePermitted(int index1, int index2)
-{
-    float dz = deltaHeight(index1, index2);
-
-    if(dz == 0.0f)
-        return false;
-    if(dz < 0.0f && isOnFloor(index1))
-        return false;
-    if(dz > 0.0f && isOnFloor(index2))
-        return false;
-
-    return true;
-}
-
-inline bool CpuWaterSim::needExchangeHandling(const Node& neighbor)
-{
-    return neighbor.isExchangePermitted &&
-          !neighbor.isSurpervisingExchange;
-}
-
-inline void CpuWaterSim::realPosition(int i, int j, float& x, float& y)
+inline DisturbanceQueue& CpuWaterSim::disturbances()
 {
-    assert( isInBounds(i, j) );
-    x = i / static_cast<float>(_WIDTH);
-    y = j / static_cast<float>(_HEIGHT);
+    return _simulation.disturbances();
 }
 
 #endif // CPUWATERSIM_H
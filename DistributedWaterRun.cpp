@@ -0,0 +1,348 @@
+#include "DistributedWaterRun.h"
+
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "ShmHaloTransport.h"
+#include "WaterSolver.h"
+
+using namespace std;
+
+
+namespace
+{
+    // A rank that is left waits on the others forever
+    void stopRanks(vector<pid_t>& children)
+    {
+        for(size_t c=0; c < children.size(); ++c)
+            kill(children[c], SIGKILL);
+        for(size_t c=0; c < children.size(); ++c)
+            waitpid(children[c], nullptr, 0);
+        children.clear();
+    }
+}
+
+DistributedWaterRun::DistributedWaterRun(const WaterOptions& options) :
+    HeadlessWaterRun(options),
+    _scenario(options.initialScenario()),
+    _ranksX(1),
+    _ranksY(1),
+    _subdomains()
+{
+}
+
+int DistributedWaterRun::execute()
+{
+    setupDecomposition();
+
+    int capacity = 0;
+    for(size_t r=0; r < _subdomains.size(); ++r)
+    {
+        const Subdomain& d = _subdomains[r];
+        capacity = max(capacity, _NEIGHBORS_RADIUS * max(d.i1 - d.i0, d.j1 - d.j0));
+    }
+
+    ShmHaloTransport transport("/WaterSurface-" + to_string(getpid()),
+                               _options.processCount, capacity);
+
+    // Only a verification run gathers the whole lattice
+    float* gathered = nullptr;
+    size_t gatheredSize = sizeof(float) * _options.width * _options.height;
+    if(_options.verify)
+    {
+        void* address = mmap(nullptr, gatheredSize, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if(address == MAP_FAILED)
+            throw runtime_error("Could not map the gathered lattice");
+        gathered = static_cast<float*>(address);
+    }
+
+    cout << "Distributed run: " << _options.width << "x" << _options.height
+         << " lattice over " << _ranksX << "x" << _ranksY << " processes, "
+         << _options.stepCount << " steps" << endl;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    vector<pid_t> children;
+    for(int r=0; r < _options.processCount; ++r)
+    {
+        cout.flush();
+        pid_t pid = fork();
+        if(pid < 0)
+        {
+            stopRanks(children);
+            if(gathered != nullptr)
+                munmap(gathered, gatheredSize);
+            throw runtime_error("Could not fork rank " + to_string(r));
+        }
+
+        if(pid == 0)
+        {
+            // The exception must not unwind into the parent's code
+            int status = 0;
+            try
+            {
+                transport.setRank(r);
+                runRank(transport, gathered);
+            }
+            catch(exception& e)
+            {
+                cerr << "Rank " << r << ": " << e.what() << endl;
+                status = 1;
+            }
+            catch(...)
+            {
+                cerr << "Rank " << r << ": unknown exception" << endl;
+                status = 1;
+            }
+            cout.flush();
+            _exit(status);
+        }
+
+        children.push_back(pid);
+    }
+
+    // The first rank to fail stops the others
+    bool allSucceeded = true;
+    while(!children.empty())
+    {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if(pid < 0)
+        {
+            stopRanks(children);
+            allSucceeded = false;
+            break;
+        }
+
+        children.erase(remove(children.begin(), children.end(), pid),
+                       children.end());
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            stopRanks(children);
+            allSucceeded = false;
+        }
+    }
+
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+    cout << "Distributed run: " << seconds << " s, "
+         << _options.stepCount / seconds << " steps/s" << endl;
+
+    int result = allSucceeded ? 0 : 1;
+    if(allSucceeded && gathered != nullptr)
+        result = verify(gathered);
+
+    if(gathered != nullptr)
+        munmap(gathered, gatheredSize);
+
+    return result;
+}
+
+void DistributedWaterRun::setupDecomposition()
+{
+    // Subdomains as square as the ranks count allows
+    int count = _options.processCount;
+    double aspect = _options.width / static_cast<double>(_options.height);
+    double bestError = INFINITY;
+    for(int px=1; px <= count; ++px)
+    {
+        if(count % px != 0)
+            continue;
+
+        int py = count / px;
+        double error = fabs(log((px / static_cast<double>(py)) / aspect));
+        if(error < bestError)
+        {
+            bestError = error;
+            _ranksX = px;
+            _ranksY = py;
+        }
+    }
+
+    _subdomains.clear();
+    for(int py=0; py < _ranksY; ++py)
+    {
+        for(int px=0; px < _ranksX; ++px)
+        {
+            Subdomain d;
+            d.px = px;
+            d.py = py;
+            d.i0 = px       * _options.width  / _ranksX;
+            d.i1 = (px + 1) * _options.width  / _ranksX;
+            d.j0 = py       * _options.height / _ranksY;
+            d.j1 = (py + 1) * _options.height / _ranksY;
+
+            if(d.i1 - d.i0 < 2 * _NEIGHBORS_RADIUS ||
+               d.j1 - d.j0 < 2 * _NEIGHBORS_RADIUS)
+                throw runtime_error("Too many processes for the lattice size");
+
+            _subdomains.push_back(d);
+        }
+    }
+}
+
+int DistributedWaterRun::rankAt(int px, int py) const
+{
+    if(px < 0 || px >= _ranksX || py < 0 || py >= _ranksY)
+        return -1;
+    return py * _ranksX + px;
+}
+
+void DistributedWaterRun::runRank(HaloTransport& transport, float* gathered)
+{
+    const Subdomain& d = _subdomains[transport.rank()];
+    const int R = _NEIGHBORS_RADIUS;
+
+    WaterSolver solver(_options.width, _options.height, R,
+                       _STRETCHNESS, _LOSSYNESS, d.i0, d.j0, d.i1, d.j1);
+    solver.setBoundaries(_options.initialBoundaries());
+    solver.setupScenario(_scenario);
+
+    // Cells that never read the halo
+    int ix0 = d.i0 + (d.px > 0           ? R : 0);
+    int ix1 = d.i1 - (d.px < _ranksX - 1 ? R : 0);
+    int iy0 = d.j0 + (d.py > 0           ? R : 0);
+    int iy1 = d.j1 - (d.py < _ranksY - 1 ? R : 0);
+
+    transport.barrier();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    for(int s=0; s < _options.stepCount; ++s)
+    {
+        postBorders(transport, solver, s);
+        solver.stepRegion(ix0, iy0, ix1, iy1);
+        receiveHalos(transport, solver, s);
+        stepBorder(solver, ix0, iy0, ix1, iy1);
+        solver.swapBuffers();
+    }
+
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+    cout << "Rank " << transport.rank() << ": "
+         << (d.i1 - d.i0) << "x" << (d.j1 - d.j0) << " cells, "
+         << seconds << " s" << endl;
+
+    if(gathered != nullptr)
+    {
+        for(int j=d.j0; j < d.j1; ++j)
+            for(int i=d.i0; i < d.i1; ++i)
+                gathered[j * _options.width + i] = solver.waterHeight(i, j);
+    }
+
+    transport.barrier();
+}
+
+void DistributedWaterRun::postBorders(HaloTransport& transport,
+                                      const WaterSolver& solver, int step)
+{
+    const Subdomain& d = _subdomains[transport.rank()];
+    const int R = _NEIGHBORS_RADIUS;
+    vector<float> strip;
+
+    for(int dy=-1; dy <= 1; ++dy)
+    {
+        for(int dx=-1; dx <= 1; ++dx)
+        {
+            int peer = rankAt(d.px + dx, d.py + dy);
+            if((dx == 0 && dy == 0) || peer < 0)
+                continue;
+
+            int i0 = dx > 0 ? d.i1 - R : d.i0;
+            int i1 = dx < 0 ? d.i0 + R : d.i1;
+            int j0 = dy > 0 ? d.j1 - R : d.j0;
+            int j1 = dy < 0 ? d.j0 + R : d.j1;
+
+            strip.clear();
+            for(int j=j0; j < j1; ++j)
+                for(int i=i0; i < i1; ++i)
+                    strip.push_back(solver.waterHeight(i, j));
+
+            transport.send(peer, step, strip);
+        }
+    }
+}
+
+void DistributedWaterRun::receiveHalos(HaloTransport& transport,
+                                       WaterSolver& solver, int step)
+{
+    const Subdomain& d = _subdomains[transport.rank()];
+    const int R = _NEIGHBORS_RADIUS;
+    FieldArray& heights = solver.waterHeights();
+    vector<float> strip;
+
+    for(int dy=-1; dy <= 1; ++dy)
+    {
+        for(int dx=-1; dx <= 1; ++dx)
+        {
+            int peer = rankAt(d.px + dx, d.py + dy);
+            if((dx == 0 && dy == 0) || peer < 0)
+                continue;
+
+            int i0 = dx > 0 ? d.i1 : (dx < 0 ? d.i0 - R : d.i0);
+            int i1 = dx > 0 ? d.i1 + R : (dx < 0 ? d.i0 : d.i1);
+            int j0 = dy > 0 ? d.j1 : (dy < 0 ? d.j0 - R : d.j0);
+            int j1 = dy > 0 ? d.j1 + R : (dy < 0 ? d.j0 : d.j1);
+
+            transport.receive(peer, step, strip);
+
+            size_t s = 0;
+            for(int j=j0; j < j1; ++j)
+                for(int i=i0; i < i1; ++i)
+                    heights[solver.storageIndex(i, j)] = strip[s++];
+        }
+    }
+}
+
+void DistributedWaterRun::stepBorder(WaterSolver& solver,
+                                     int i0, int j0, int i1, int j1)
+{
+    int x0 = solver.ownedX0();
+    int y0 = solver.ownedY0();
+    int x1 = solver.ownedX1();
+    int y1 = solver.ownedY1();
+
+    solver.stepRegion(x0, y0, x1, j0);
+    solver.stepRegion(x0, j1, x1, y1);
+    solver.stepRegion(x0, j0, i0, j1);
+    solver.stepRegion(i1, j0, x1, j1);
+}
+
+int DistributedWaterRun::verify(const float* gathered)
+{
+    WaterSolver solver(_options.width, _options.height, _NEIGHBORS_RADIUS,
+                       _STRETCHNESS, _LOSSYNESS);
+    solver.setBoundaries(_options.initialBoundaries());
+    solver.setupScenario(_scenario);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(int s=0; s < _options.stepCount; ++s)
+        solver.step();
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+
+    float maxDifference = 0.0f;
+    for(int j=0; j < _options.height; ++j)
+    {
+        for(int i=0; i < _options.width; ++i)
+        {
+            float difference = fabs(solver.waterHeight(i, j) -
+                                    gathered[j * _options.width + i]);
+            maxDifference = max(maxDifference, difference);
+        }
+    }
+
+    cout << "Single process: " << seconds << " s, "
+         << _options.stepCount / seconds << " steps/s" << endl;
+    cout << "Max difference with single process: " << maxDifference << endl;
+
+    return maxDifference == 0.0f ? 0 : 1;
+}
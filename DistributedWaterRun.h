@@ -0,0 +1,49 @@
+#ifndef DISTRIBUTEDWATERRUN_H
+#define DISTRIBUTEDWATERRUN_H
+
+#include <vector>
+
+#include "HeadlessWaterRun.h"
+#include "WaterScenario.h"
+
+class HaloTransport;
+class WaterSolver;
+
+
+// Headless run where the lattice is split into rectangular subdomains, one
+// per process. Each step a rank posts its borders, steps the cells that do
+// not depend on its halo, then receives the halo and finishes its border.
+class DistributedWaterRun : public HeadlessWaterRun
+{
+public:
+    DistributedWaterRun(const WaterOptions& options);
+
+    virtual int execute();
+
+protected:
+    struct Subdomain
+    {
+        int i0, j0;
+        int i1, j1;
+        int px, py;
+    };
+
+    void setupDecomposition();
+    int rankAt(int px, int py) const;
+
+    void runRank(HaloTransport& transport, float* gathered);
+    void postBorders(HaloTransport& transport, const WaterSolver& solver, int step);
+    void receiveHalos(HaloTransport& transport, WaterSolver& solver, int step);
+    void stepBorder(WaterSolver& solver, int i0, int j0, int i1, int j1);
+
+    int verify(const float* gathered);
+
+private:
+    WaterScenario _scenario;
+
+    int _ranksX;
+    int _ranksY;
+    std::vector<Subdomain> _subdomains;
+};
+
+#endif // DISTRIBUTEDWATERRUN_H
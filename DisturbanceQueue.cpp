@@ -0,0 +1,125 @@
+#include "DisturbanceQueue.h"
+
+#include <cassert>
+
+using namespace std;
+
+
+WaterDisturbance WaterDisturbance::drop(float x, float y, float radius, float height)
+{
+    WaterDisturbance disturbance;
+    disturbance.type = EType::DROP;
+    disturbance.x = x;
+    disturbance.y = y;
+    disturbance.radius = radius;
+    disturbance.amount = height;
+    disturbance.duration = 1;
+    disturbance.seed = 0;
+    return disturbance;
+}
+
+WaterDisturbance WaterDisturbance::rain(float x, float y, float radius, float height,
+                                        int duration, unsigned int seed)
+{
+    WaterDisturbance disturbance = drop(x, y, radius, height);
+    disturbance.type = EType::RAIN;
+    disturbance.duration = duration;
+    disturbance.seed = seed;
+    return disturbance;
+}
+
+WaterDisturbance WaterDisturbance::source(float x, float y, float radius, float rate,
+                                          int duration)
+{
+    WaterDisturbance disturbance = drop(x, y, radius, rate);
+    disturbance.type = EType::SOURCE;
+    disturbance.duration = duration;
+    return disturbance;
+}
+
+WaterDisturbance WaterDisturbance::sink(float x, float y, float radius, float rate,
+                                        int duration)
+{
+    WaterDisturbance disturbance = drop(x, y, radius, -rate);
+    disturbance.type = EType::SINK;
+    disturbance.duration = duration;
+    return disturbance;
+}
+
+WaterDisturbance WaterDisturbance::clear()
+{
+    WaterDisturbance disturbance = drop(0.0f, 0.0f, 0.0f, 0.0f);
+    disturbance.type = EType::CLEAR;
+    return disturbance;
+}
+
+WaterDisturbance WaterDisturbance::ground(float x, float y, float radius, float height)
+{
+    WaterDisturbance disturbance = drop(x, y, radius, height);
+    disturbance.type = EType::GROUND;
+    return disturbance;
+}
+
+
+DisturbanceQueue::DisturbanceQueue(int capacity) :
+    _MASK(capacity - 1),
+    _slots(new Slot[capacity]),
+    _tailPadding(),
+    _tail(0),
+    _headPadding(),
+    _head(0)
+{
+    assert( capacity > 0 && (capacity & (capacity - 1)) == 0 );
+
+    for(int s=0; s < capacity; ++s)
+        _slots[s].sequence.store(s, memory_order_relaxed);
+}
+
+bool DisturbanceQueue::push(const WaterDisturbance& disturbance)
+{
+    unsigned int ticket = _tail.load(memory_order_relaxed);
+    for(;;)
+    {
+        Slot& slot = _slots[ticket & _MASK];
+        unsigned int sequence = slot.sequence.load(memory_order_acquire);
+        int lag = static_cast<int>(sequence - ticket);
+
+        if(lag == 0)
+        {
+            // Slot is free for this ticket, try to claim it
+            if(_tail.compare_exchange_weak(ticket, ticket + 1,
+                                           memory_order_relaxed))
+            {
+                slot.disturbance = disturbance;
+                slot.sequence.store(ticket + 1, memory_order_release);
+                return true;
+            }
+        }
+        else if(lag < 0)
+        {
+            // Consumer has not released the slot yet
+            return false;
+        }
+        else
+        {
+            ticket = _tail.load(memory_order_relaxed);
+        }
+    }
+}
+
+int DisturbanceQueue::drain(std::vector<WaterDisturbance>& batch)
+{
+    // Stops at the first claimed but unpublished slot to keep ticket order
+    int count = 0;
+    for(;;)
+    {
+        Slot& slot = _slots[_head & _MASK];
+        if(slot.sequence.load(memory_order_acquire) != _head + 1)
+            return count;
+
+        batch.push_back(slot.disturbance);
+        slot.sequence.store(_head + _MASK + 1, memory_order_release);
+        ++_head;
+        ++count;
+    }
+}
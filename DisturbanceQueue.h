@@ -0,0 +1,73 @@
+#ifndef DISTURBANCEQUEUE_H
+#define DISTURBANCEQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <vector>
+
+
+// Runtime disturbance of the water, in lattice normalized coordinates.
+// Drops and ground edits are applied once, the other kinds keep going for a
+// number of nominal steps, or until a CLEAR when the duration is zero.
+struct WaterDisturbance
+{
+    enum class EType {DROP, RAIN, SOURCE, SINK, CLEAR, GROUND};
+
+    static WaterDisturbance drop(float x, float y, float radius, float height);
+    static WaterDisturbance rain(float x, float y, float radius, float height,
+                                 int duration, unsigned int seed);
+    static WaterDisturbance source(float x, float y, float radius, float rate,
+                                   int duration = 0);
+    static WaterDisturbance sink(float x, float y, float radius, float rate,
+                                 int duration = 0);
+    static WaterDisturbance clear();
+
+    // Sets the ground of a disk to a height : opens gates, breaks dams
+    static WaterDisturbance ground(float x, float y, float radius, float height);
+
+    EType type;
+    float x;
+    float y;
+    float radius;
+    float amount;
+    int duration;
+    unsigned int seed;
+};
+
+
+// Bounded queue with many producers and a single consumer. Producers claim
+// a slot with an atomic ticket and publish it through the slot sequence, so
+// neither side ever takes a lock. Commands come out in ticket order.
+class DisturbanceQueue
+{
+public:
+    DisturbanceQueue(int capacity = 1024);
+
+    // Any thread, returns false when the queue is full
+    bool push(const WaterDisturbance& disturbance);
+
+    // Consumer thread only, appends the published commands to batch
+    int drain(std::vector<WaterDisturbance>& batch);
+
+private:
+    struct Slot
+    {
+        std::atomic<unsigned int> sequence;
+        WaterDisturbance disturbance;
+    };
+
+    // Producers write the tail and the consumer the head, a cache line
+    // apart. Padding rather than alignas, plain new does not align past
+    // the fundamental alignment before C++17.
+    static const size_t _CACHE_LINE = 64;
+
+    const unsigned int _MASK;
+    std::unique_ptr<Slot[]> _slots;
+    char _tailPadding[_CACHE_LINE];
+    std::atomic<unsigned int> _tail;
+    char _headPadding[_CACHE_LINE - sizeof(std::atomic<unsigned int>)];
+    unsigned int _head;
+};
+
+#endif // DISTURBANCEQUEUE_H
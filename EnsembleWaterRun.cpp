@@ -0,0 +1,99 @@
+#include "EnsembleWaterRun.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+
+EnsembleWaterRun::EnsembleWaterRun(const WaterOptions& options) :
+    HeadlessWaterRun(options),
+    _ensemble(options.width, options.height, _NEIGHBORS_RADIUS,
+              options.initialScenario())
+{
+}
+
+int EnsembleWaterRun::execute()
+{
+    readMembers(_options.ensembleFile);
+    if(_ensemble.memberCount() == 0)
+        throw runtime_error("No member in " + _options.ensembleFile);
+
+    _ensemble.setup();
+
+    cout << "Ensemble run: " << _ensemble.memberCount() << " members on a "
+         << _options.width << "x" << _options.height << " lattice, "
+         << _options.stepCount << " steps" << endl;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    for(int s=0; s < _options.stepCount; ++s)
+        _ensemble.step();
+
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+    double memberSteps = _ensemble.memberCount() *
+                         static_cast<double>(_options.stepCount);
+    cout << "Ensemble run: " << seconds << " s, "
+         << memberSteps / seconds << " member steps/s, "
+         << memberSteps * _options.width * _options.height / seconds
+         << " cell updates/s" << endl;
+
+    string resultsFile = _options.resultsFile.empty() ?
+        "ensemble.csv" : _options.resultsFile;
+    ofstream results(resultsFile.c_str());
+    if(!results)
+        throw runtime_error("Could not open " + resultsFile);
+    _ensemble.writeSummaries(results);
+
+    cout << "Ensemble run: summaries written to " << resultsFile << endl;
+
+    return 0;
+}
+
+void EnsembleWaterRun::readMembers(const std::string& fileName)
+{
+    ifstream file(fileName.c_str());
+    if(!file)
+        throw runtime_error("Could not open " + fileName);
+
+    string line;
+    int lineNumber = 0;
+    while(getline(file, line))
+    {
+        ++lineNumber;
+
+        size_t comment = line.find('#');
+        if(comment != string::npos)
+            line.erase(comment);
+
+        istringstream fields(line);
+        EnsembleMember member;
+        if(!(fields >> member.stretchness))
+            continue;
+
+        string water;
+        bool ok = static_cast<bool>(fields >> member.lossyness);
+        if(ok && fields >> water)
+        {
+            ok = WaterScenario::waterByName(water, member.water);
+            float amplitudeScale = 0.0f;
+            if(fields >> amplitudeScale)
+                member.amplitudeScale = amplitudeScale;
+            else
+                ok = ok && fields.eof();
+        }
+
+        if(!ok)
+        {
+            throw runtime_error(fileName + ":" + to_string(lineNumber) +
+                                ": expected 'stretchness lossyness "
+                                "[water] [amplitude]'");
+        }
+
+        _ensemble.addMember(member);
+    }
+}
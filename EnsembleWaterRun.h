@@ -0,0 +1,26 @@
+#ifndef ENSEMBLEWATERRUN_H
+#define ENSEMBLEWATERRUN_H
+
+#include <string>
+
+#include "HeadlessWaterRun.h"
+#include "WaterEnsemble.h"
+
+
+// Headless run of a parameter sweep. Members are read from a text file, one
+// per line : stretchness lossyness [water] [amplitude scale]
+class EnsembleWaterRun : public HeadlessWaterRun
+{
+public:
+    EnsembleWaterRun(const WaterOptions& options);
+
+    virtual int execute();
+
+protected:
+    void readMembers(const std::string& fileName);
+
+private:
+    WaterEnsemble _ensemble;
+};
+
+#endif // ENSEMBLEWATERRUN_H
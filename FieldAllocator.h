@@ -0,0 +1,97 @@
+#ifndef FIELDALLOCATOR_H
+#define FIELDALLOCATOR_H
+
+#include <new>
+#include <vector>
+#include <utility>
+#include <cstdlib>
+#include <cstddef>
+
+#include <sys/mman.h>
+
+#include "MemoryAccounting.h"
+
+
+// Allocator of the lattice fields.
+//
+// Storage is aligned on cache lines, and arrays of a huge page or more on
+// huge pages, which the kernel is asked to back with transparent huge
+// pages. Elements are default initialized : the pages of a new array are
+// not touched until its cells are first written, so they land on the NUMA
+// node of the thread that writes them first. Bytes are counted as fields
+// in the memory accounting.
+template<typename T>
+class FieldAllocator
+{
+public:
+    typedef T value_type;
+
+    static const size_t CACHE_LINE = 64;
+    static const size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+    FieldAllocator() {}
+    template<typename U>
+    FieldAllocator(const FieldAllocator<U>&) {}
+
+    T* allocate(size_t count);
+    void deallocate(T* pointer, size_t count);
+
+    template<typename U>
+    void construct(U* pointer);
+    template<typename U, typename... Args>
+    void construct(U* pointer, Args&&... args);
+
+    template<typename U>
+    struct rebind {typedef FieldAllocator<U> other;};
+};
+
+template<typename T, typename U>
+bool operator==(const FieldAllocator<T>&, const FieldAllocator<U>&) {return true;}
+template<typename T, typename U>
+bool operator!=(const FieldAllocator<T>&, const FieldAllocator<U>&) {return false;}
+
+typedef std::vector<float, FieldAllocator<float>> FieldArray;
+
+
+
+// IMPLEMENTATION //
+template<typename T>
+T* FieldAllocator<T>::allocate(size_t count)
+{
+    size_t bytes = count * sizeof(T);
+    size_t alignment = bytes >= HUGE_PAGE ? HUGE_PAGE : CACHE_LINE;
+
+    void* pointer = nullptr;
+    if(posix_memalign(&pointer, alignment, bytes) != 0)
+        throw std::bad_alloc();
+
+    if(alignment == HUGE_PAGE)
+        madvise(pointer, bytes - bytes % HUGE_PAGE, MADV_HUGEPAGE);
+
+    getMemoryAccounting().allocate(MemoryAccounting::ESubsystem::FIELDS, bytes);
+    return static_cast<T*>(pointer);
+}
+
+template<typename T>
+void FieldAllocator<T>::deallocate(T* pointer, size_t count)
+{
+    getMemoryAccounting().release(MemoryAccounting::ESubsystem::FIELDS,
+                                  count * sizeof(T));
+    free(pointer);
+}
+
+template<typename T>
+template<typename U>
+void FieldAllocator<T>::construct(U* pointer)
+{
+    ::new(static_cast<void*>(pointer)) U;
+}
+
+template<typename T>
+template<typename U, typename... Args>
+void FieldAllocator<T>::construct(U* pointer, Args&&... args)
+{
+    ::new(static_cast<void*>(pointer)) U(std::forward<Args>(args)...);
+}
+
+#endif // FIELDALLOCATOR_H
@@ -1,24 +1,128 @@
 SET(WATER_SURFACE_HEADERS
+    ${WATER_SURFACE_SRC_DIR}/AdaptiveWaterGrid.h
+    ${WATER_SURFACE_SRC_DIR}/BasinWaterRun.h
     ${WATER_SURFACE_SRC_DIR}/CpuWaterSim.h
+    ${WATER_SURFACE_SRC_DIR}/DistributedWaterRun.h
+    ${WATER_SURFACE_SRC_DIR}/DisturbanceQueue.h
+    ${WATER_SURFACE_SRC_DIR}/EnsembleWaterRun.h
+    ${WATER_SURFACE_SRC_DIR}/FieldAllocator.h
+    ${WATER_SURFACE_SRC_DIR}/FixedPointWaterRun.h
+    ${WATER_SURFACE_SRC_DIR}/FixedPointWaterSolver.h
+    ${WATER_SURFACE_SRC_DIR}/FrameSequenceWriter.h
+    ${WATER_SURFACE_SRC_DIR}/FrameTimeStats.h
+    ${WATER_SURFACE_SRC_DIR}/HaloTransport.h
+    ${WATER_SURFACE_SRC_DIR}/HeadlessWaterRun.h
+    ${WATER_SURFACE_SRC_DIR}/ImplicitWaterRun.h
+    ${WATER_SURFACE_SRC_DIR}/ImplicitWaterSolver.h
+    ${WATER_SURFACE_SRC_DIR}/MemoryAccounting.h
+    ${WATER_SURFACE_SRC_DIR}/NumaTopology.h
+    ${WATER_SURFACE_SRC_DIR}/OffscreenContext.h
+    ${WATER_SURFACE_SRC_DIR}/OffscreenWaterRun.h
+    ${WATER_SURFACE_SRC_DIR}/ProbeWaterRun.h
+    ${WATER_SURFACE_SRC_DIR}/ReferenceWaterRun.h
+    ${WATER_SURFACE_SRC_DIR}/ReferenceWaterSolver.h
+    ${WATER_SURFACE_SRC_DIR}/ReplayWaterRun.h
+    ${WATER_SURFACE_SRC_DIR}/SeparableWaterRun.h
+    ${WATER_SURFACE_SRC_DIR}/SessionRecord.h
+    ${WATER_SURFACE_SRC_DIR}/SharedHeightField.h
+    ${WATER_SURFACE_SRC_DIR}/SharedHeightPublisher.h
+    ${WATER_SURFACE_SRC_DIR}/ShmHaloTransport.h
+    ${WATER_SURFACE_SRC_DIR}/SparseWaterGrid.h
+    ${WATER_SURFACE_SRC_DIR}/SparseWaterRun.h
+    ${WATER_SURFACE_SRC_DIR}/TemporalWaterGrid.h
+    ${WATER_SURFACE_SRC_DIR}/TemporalWaterRun.h
+    ${WATER_SURFACE_SRC_DIR}/TerrainFile.h
+    ${WATER_SURFACE_SRC_DIR}/TiledTerrain.h
+    ${WATER_SURFACE_SRC_DIR}/WaterBasin.h
+    ${WATER_SURFACE_SRC_DIR}/WaterBoundaries.h
     ${WATER_SURFACE_SRC_DIR}/WaterCharacter.h
-    ${WATER_SURFACE_SRC_DIR}/WaterPlay.h)
+    ${WATER_SURFACE_SRC_DIR}/WaterDisturber.h
+    ${WATER_SURFACE_SRC_DIR}/WaterEnsemble.h
+    ${WATER_SURFACE_SRC_DIR}/WaterOptions.h
+    ${WATER_SURFACE_SRC_DIR}/WaterPlay.h
+    ${WATER_SURFACE_SRC_DIR}/WaterProbe.h
+    ${WATER_SURFACE_SRC_DIR}/WaterRenderer.h
+    ${WATER_SURFACE_SRC_DIR}/WaterScenario.h
+    ${WATER_SURFACE_SRC_DIR}/WaterScheduler.h
+    ${WATER_SURFACE_SRC_DIR}/WaterSimulation.h
+    ${WATER_SURFACE_SRC_DIR}/WaterSolver.h
+    ${WATER_SURFACE_SRC_DIR}/WaterStepper.h
+    ${WATER_SURFACE_SRC_DIR}/WaterStepSlicer.h
+    ${WATER_SURFACE_SRC_DIR}/WaterStepTuner.h
+    ${WATER_SURFACE_SRC_DIR}/WaterTimestep.h
+    ${WATER_SURFACE_SRC_DIR}/WorkerPool.h)
     
 SET(WATER_SURFACE_SOURCES
+    ${WATER_SURFACE_SRC_DIR}/AdaptiveWaterGrid.cpp
+    ${WATER_SURFACE_SRC_DIR}/BasinWaterRun.cpp
     ${WATER_SURFACE_SRC_DIR}/CpuWaterSim.cpp
+    ${WATER_SURFACE_SRC_DIR}/DistributedWaterRun.cpp
+    ${WATER_SURFACE_SRC_DIR}/DisturbanceQueue.cpp
+    ${WATER_SURFACE_SRC_DIR}/EnsembleWaterRun.cpp
+    ${WATER_SURFACE_SRC_DIR}/FixedPointWaterRun.cpp
+    ${WATER_SURFACE_SRC_DIR}/FixedPointWaterSolver.cpp
+    ${WATER_SURFACE_SRC_DIR}/FrameSequenceWriter.cpp
+    ${WATER_SURFACE_SRC_DIR}/FrameTimeStats.cpp
+    ${WATER_SURFACE_SRC_DIR}/HeadlessWaterRun.cpp
+    ${WATER_SURFACE_SRC_DIR}/ImplicitWaterRun.cpp
+    ${WATER_SURFACE_SRC_DIR}/ImplicitWaterSolver.cpp
+    ${WATER_SURFACE_SRC_DIR}/MemoryAccounting.cpp
+    ${WATER_SURFACE_SRC_DIR}/NumaTopology.cpp
+    ${WATER_SURFACE_SRC_DIR}/OffscreenContext.cpp
+    ${WATER_SURFACE_SRC_DIR}/OffscreenWaterRun.cpp
+    ${WATER_SURFACE_SRC_DIR}/ProbeWaterRun.cpp
+    ${WATER_SURFACE_SRC_DIR}/ReferenceWaterRun.cpp
+    ${WATER_SURFACE_SRC_DIR}/ReferenceWaterSolver.cpp
+    ${WATER_SURFACE_SRC_DIR}/ReplayWaterRun.cpp
+    ${WATER_SURFACE_SRC_DIR}/SeparableWaterRun.cpp
+    ${WATER_SURFACE_SRC_DIR}/SessionRecord.cpp
+    ${WATER_SURFACE_SRC_DIR}/SharedHeightPublisher.cpp
+    ${WATER_SURFACE_SRC_DIR}/ShmHaloTransport.cpp
+    ${WATER_SURFACE_SRC_DIR}/SparseWaterGrid.cpp
+    ${WATER_SURFACE_SRC_DIR}/SparseWaterRun.cpp
+    ${WATER_SURFACE_SRC_DIR}/TemporalWaterGrid.cpp
+    ${WATER_SURFACE_SRC_DIR}/TemporalWaterRun.cpp
+    ${WATER_SURFACE_SRC_DIR}/TiledTerrain.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterBasin.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterBoundaries.cpp
     ${WATER_SURFACE_SRC_DIR}/WaterCharacter.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterDisturber.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterEnsemble.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterOptions.cpp
     ${WATER_SURFACE_SRC_DIR}/WaterPlay.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterProbe.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterRenderer.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterScenario.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterScheduler.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterSimulation.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterSolver.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterStepper.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterStepSlicer.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterStepTuner.cpp
+    ${WATER_SURFACE_SRC_DIR}/WaterTimestep.cpp
+    ${WATER_SURFACE_SRC_DIR}/WorkerPool.cpp
     ${WATER_SURFACE_SRC_DIR}/main.cpp)
 
+SET(WATER_SURFACE_READER_FILES
+    ${WATER_SURFACE_SRC_DIR}/SharedHeightField.h
+    ${WATER_SURFACE_SRC_DIR}/SharedHeightReader.h
+    ${WATER_SURFACE_SRC_DIR}/SharedHeightReader.cpp)
+
+SET(HEIGHT_MONITOR_FILES
+    ${WATER_SURFACE_SRC_DIR}/HeightMonitor.cpp)
+
+SET(TERRAIN_CONVERTER_FILES
+    ${WATER_SURFACE_SRC_DIR}/TerrainFile.h
+    ${WATER_SURFACE_SRC_DIR}/TerrainConverter.cpp)
+
 SET(WATER_SURFACE_CONFIG_FILES
     ${WATER_SURFACE_SRC_DIR}/CMakeLists.txt
     ${WATER_SURFACE_SRC_DIR}/FileLists.cmake
     ${WATER_SURFACE_SRC_DIR}/LibLists.cmake)
 
 SET(WATER_SURFACE_SHADER_FILES
-    ${WATER_SURFACE_SRC_DIR}/resources/shaders/waterVelocity.vert
-    ${WATER_SURFACE_SRC_DIR}/resources/shaders/waterVelocity.frag
-    ${WATER_SURFACE_SRC_DIR}/resources/shaders/waterHeight.vert
-    ${WATER_SURFACE_SRC_DIR}/resources/shaders/waterHeight.frag
+    ${WATER_SURFACE_SRC_DIR}/resources/shaders/waterUpdate.vert
+    ${WATER_SURFACE_SRC_DIR}/resources/shaders/waterUpdate.frag
     ${WATER_SURFACE_SRC_DIR}/resources/shaders/waterRender.vert
     ${WATER_SURFACE_SRC_DIR}/resources/shaders/waterRender.frag)
 
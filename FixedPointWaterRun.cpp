@@ -0,0 +1,103 @@
+#include "FixedPointWaterRun.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "FixedPointWaterSolver.h"
+#include "WaterSolver.h"
+#include "WorkerPool.h"
+
+using namespace std;
+
+
+FixedPointWaterRun::FixedPointWaterRun(const WaterOptions& options) :
+    HeadlessWaterRun(options)
+{
+}
+
+int FixedPointWaterRun::execute()
+{
+    cout << "Fixed point run: " << _options.width << "x" << _options.height
+         << " lattice, " << _options.stepCount << " steps" << endl;
+
+    WorkerPool serialPool(0);
+    WorkerPool& pool = getWorkerPool();
+
+    FixedPointWaterSolver serial(_options.width, _options.height,
+                                 _NEIGHBORS_RADIUS, _STRETCHNESS, _LOSSYNESS);
+    FixedPointWaterSolver parallel(_options.width, _options.height,
+                                   _NEIGHBORS_RADIUS, _STRETCHNESS, _LOSSYNESS);
+
+    bool isConsistent = true;
+    FixedPointWaterSolver* solvers[2] = {&serial, &parallel};
+    WorkerPool* pools[2] = {&serialPool, &pool};
+    for(int r=0; r < 2; ++r)
+    {
+        FixedPointWaterSolver& solver = *solvers[r];
+        solver.setupScenario(_options.initialScenario());
+        int64_t initialVolume = solver.volume();
+
+        double seconds = run(solver, *pools[r]);
+        int64_t drift = solver.volume() - initialVolume;
+        isConsistent = isConsistent && drift == 0;
+
+        cout << pools[r]->threadCount() + 1 << " thread(s): "
+             << _options.stepCount / seconds << " steps/s, volume change "
+             << drift << " units, checksum " << hex << solver.checksum()
+             << dec << endl;
+    }
+
+    isConsistent = isConsistent && serial.checksum() == parallel.checksum();
+    cout << (isConsistent ? "Volume exact and surfaces identical" :
+                            "Volume drifted or surfaces differ") << endl;
+
+    if(_options.verify)
+        verify(parallel);
+
+    return isConsistent ? 0 : 1;
+}
+
+double FixedPointWaterRun::run(FixedPointWaterSolver& solver, WorkerPool& pool)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(int s=0; s < _options.stepCount; ++s)
+        solver.step(pool);
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void FixedPointWaterRun::verify(const FixedPointWaterSolver& fixed)
+{
+    WaterSolver solver(_options.width, _options.height, _NEIGHBORS_RADIUS,
+                       _STRETCHNESS, _LOSSYNESS);
+    solver.setupScenario(_options.initialScenario());
+
+    double initialVolume = 0.0;
+    for(int j=0; j < _options.height; ++j)
+        for(int i=0; i < _options.width; ++i)
+            initialVolume += solver.waterHeight(i, j) - solver.groundHeight(i, j);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(int s=0; s < _options.stepCount; ++s)
+        solver.step();
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+
+    double volume = 0.0;
+    double squaredDifference = 0.0;
+    for(int j=0; j < _options.height; ++j)
+    {
+        for(int i=0; i < _options.width; ++i)
+        {
+            volume += solver.waterHeight(i, j) - solver.groundHeight(i, j);
+            double difference = solver.waterHeight(i, j) - fixed.waterHeight(i, j);
+            squaredDifference += difference * difference;
+        }
+    }
+
+    double cellCount = _options.width * static_cast<double>(_options.height);
+    cout << "Float lattice: " << _options.stepCount / seconds << " steps/s, "
+         << "volume drift " << 100.0 * (volume - initialVolume) / initialVolume
+         << "%, rms distance to fixed point "
+         << sqrt(squaredDifference / cellCount) << endl;
+}
@@ -0,0 +1,26 @@
+#ifndef FIXEDPOINTWATERRUN_H
+#define FIXEDPOINTWATERRUN_H
+
+#include "HeadlessWaterRun.h"
+
+class FixedPointWaterSolver;
+class WorkerPool;
+
+
+// Headless run of the fixed point lattice. Steps once on the calling
+// thread alone and once on the worker pool, and fails unless both keep
+// the volume exactly and end on the same surface. Verification runs the
+// float lattice over the same steps for its volume drift and distance.
+class FixedPointWaterRun : public HeadlessWaterRun
+{
+public:
+    FixedPointWaterRun(const WaterOptions& options);
+
+    virtual int execute();
+
+protected:
+    double run(FixedPointWaterSolver& solver, WorkerPool& pool);
+    void verify(const FixedPointWaterSolver& fixed);
+};
+
+#endif // FIXEDPOINTWATERRUN_H
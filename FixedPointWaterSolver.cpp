@@ -0,0 +1,209 @@
+#include "FixedPointWaterSolver.h"
+
+#include <algorithm>
+
+#include "WaterScenario.h"
+#include "WaterSolver.h"
+#include "WorkerPool.h"
+
+using namespace std;
+
+
+FixedPointWaterSolver::FixedPointWaterSolver(int width, int height,
+                                             int neighborsRadius,
+                                             float stretchness, float lossyness) :
+    _WIDTH(width),
+    _HEIGHT(height),
+    _LOSSYNESS(llround(double(lossyness) * _ONE)),
+    _links(),
+    _groundHeights(),
+    _waterHeights(),
+    _outflowScales(),
+    _flows()
+{
+    // Same weights as the interior of the float lattice
+    vector<StencilTap> stencil;
+    float normalization = WaterSolver::buildStencil(neighborsRadius, width, stencil);
+    for(size_t t=0; t < stencil.size(); ++t)
+    {
+        const StencilTap& tap = stencil[t];
+        if(tap.dj < 0 || (tap.dj == 0 && tap.di < 0))
+            continue;
+
+        Link link;
+        link.di = tap.di;
+        link.dj = tap.dj;
+        link.offset = tap.offset;
+        link.conductance = llround(double(stretchness) * tap.baseContribution *
+                                   normalization * _ONE);
+        _links.push_back(link);
+    }
+
+    _groundHeights.resize(width * height);
+    _waterHeights.resize(width * height);
+    _outflowScales.resize(width * height);
+    _flows.resize(_links.size(), vector<int32_t>(width * height, 0));
+}
+
+void FixedPointWaterSolver::setupScenario(const WaterScenario& scenario)
+{
+    for(int j=0; j < _HEIGHT; ++j)
+    {
+        for(int i=0; i < _WIDTH; ++i)
+        {
+            float x = i / static_cast<float>(_WIDTH);
+            float y = j / static_cast<float>(_HEIGHT);
+            int c = index(i, j);
+
+            _groundHeights[c] = toUnits(scenario.groundHeight(x, y));
+            _waterHeights[c] = max(toUnits(scenario.waterHeight(x, y)),
+                                   _groundHeights[c]);
+        }
+    }
+
+    // Flows start at rest
+    for(size_t l=0; l < _flows.size(); ++l)
+        fill(_flows[l].begin(), _flows[l].end(), 0);
+}
+
+void FixedPointWaterSolver::step(WorkerPool& pool)
+{
+    pool.parallelFor(0, _HEIGHT, [this](int j0, int j1) {driveRows(j0, j1);});
+    pool.parallelFor(0, _HEIGHT, [this](int j0, int j1) {limitRows(j0, j1);});
+    pool.parallelFor(0, _HEIGHT, [this](int j0, int j1) {scaleRows(j0, j1);});
+    pool.parallelFor(0, _HEIGHT, [this](int j0, int j1) {moveRows(j0, j1);});
+}
+
+void FixedPointWaterSolver::driveRows(int j0, int j1)
+{
+    const int32_t* heights = _waterHeights.data();
+    const int32_t* ground = _groundHeights.data();
+
+    for(size_t l=0; l < _links.size(); ++l)
+    {
+        const Link& link = _links[l];
+        int32_t* flows = _flows[l].data();
+
+        for(int j=j0; j < j1; ++j)
+        {
+            for(int i=0; i < _WIDTH; ++i)
+            {
+                if(!hasLink(i, j, link))
+                    continue;
+
+                // Only the water above the ground pushes
+                int c = index(i, j);
+                int n = c + link.offset;
+                int64_t over = max(heights[c] - ground[c], 0);
+                int64_t overN = max(heights[n] - ground[n], 0);
+                int64_t dz = min(max(int64_t(heights[n]) - heights[c], -over), overN);
+
+                int64_t flow = flows[c];
+                flow += link.conductance * dz / _ONE;
+                flow -= _LOSSYNESS * flow / _ONE;
+                flows[c] = static_cast<int32_t>(flow);
+            }
+        }
+    }
+}
+
+void FixedPointWaterSolver::limitRows(int j0, int j1)
+{
+    for(int j=j0; j < j1; ++j)
+    {
+        for(int i=0; i < _WIDTH; ++i)
+        {
+            int c = index(i, j);
+            int64_t outflow = 0;
+            for(size_t l=0; l < _links.size(); ++l)
+            {
+                const Link& link = _links[l];
+                if(hasLink(i, j, link))
+                    outflow += max(-_flows[l][c], 0);
+
+                // Link held by the cell on the other side
+                int mi = i - link.di;
+                int mj = j - link.dj;
+                if(0 <= mi && mi < _WIDTH && mj >= 0)
+                    outflow += max(_flows[l][c - link.offset], 0);
+            }
+
+            int64_t available = max(_waterHeights[c] - _groundHeights[c], 0);
+            _outflowScales[c] = outflow > available ?
+                                available * _ONE / outflow : _ONE;
+        }
+    }
+}
+
+void FixedPointWaterSolver::scaleRows(int j0, int j1)
+{
+    for(size_t l=0; l < _links.size(); ++l)
+    {
+        const Link& link = _links[l];
+        int32_t* flows = _flows[l].data();
+
+        for(int j=j0; j < j1; ++j)
+        {
+            for(int i=0; i < _WIDTH; ++i)
+            {
+                if(!hasLink(i, j, link))
+                    continue;
+
+                // Rounds toward zero, a source never gives more than it holds
+                int c = index(i, j);
+                int source = flows[c] > 0 ? c + link.offset : c;
+                flows[c] = static_cast<int32_t>(
+                    flows[c] * _outflowScales[source] / _ONE);
+            }
+        }
+    }
+}
+
+void FixedPointWaterSolver::moveRows(int j0, int j1)
+{
+    for(int j=j0; j < j1; ++j)
+    {
+        for(int i=0; i < _WIDTH; ++i)
+        {
+            int c = index(i, j);
+            int32_t moved = 0;
+            for(size_t l=0; l < _links.size(); ++l)
+            {
+                const Link& link = _links[l];
+                if(hasLink(i, j, link))
+                    moved += _flows[l][c];
+
+                int mi = i - link.di;
+                int mj = j - link.dj;
+                if(0 <= mi && mi < _WIDTH && mj >= 0)
+                    moved -= _flows[l][c - link.offset];
+            }
+
+            _waterHeights[c] += moved;
+        }
+    }
+}
+
+int64_t FixedPointWaterSolver::volume() const
+{
+    int64_t total = 0;
+    for(size_t c=0; c < _waterHeights.size(); ++c)
+        total += _waterHeights[c] - _groundHeights[c];
+    return total;
+}
+
+unsigned int FixedPointWaterSolver::checksum() const
+{
+    // FNV-1a over the heights
+    const unsigned char* bytes =
+        reinterpret_cast<const unsigned char*>(_waterHeights.data());
+    size_t size = _waterHeights.size() * sizeof(int32_t);
+
+    unsigned int hash = 2166136261u;
+    for(size_t b=0; b < size; ++b)
+    {
+        hash ^= bytes[b];
+        hash *= 16777619u;
+    }
+    return hash;
+}
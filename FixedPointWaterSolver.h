@@ -0,0 +1,124 @@
+#ifndef FIXEDPOINTWATERSOLVER_H
+#define FIXEDPOINTWATERSOLVER_H
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+
+class WaterScenario;
+class WorkerPool;
+
+
+// Lattice solver in fixed point, which conserves the volume exactly.
+//
+// Heights are integers in units of 2^-24. Water moves along the links of
+// the stencil rather than being gathered by each cell : a link holds the
+// flow between its two cells, driven by their height difference and
+// damped by the lossyness, and is added to one cell and taken from the
+// other. Outflows are scaled down where they would take more water than
+// a cell holds. Every pass writes only its own cells or links from the
+// results of the previous pass, and integer sums do not depend on their
+// order, so the surface is the same bit for bit whatever the thread count.
+class FixedPointWaterSolver
+{
+public:
+    FixedPointWaterSolver(int width, int height, int neighborsRadius,
+                          float stretchness, float lossyness);
+
+    void setupScenario(const WaterScenario& scenario);
+    void step(WorkerPool& pool);
+
+    int width() const;
+    int height() const;
+
+    float waterHeight(int i, int j) const;
+    float groundHeight(int i, int j) const;
+
+    // Sum of the heights above the ground, in units
+    int64_t volume() const;
+    unsigned int checksum() const;
+
+    static int32_t toUnits(float value);
+    static float fromUnits(int64_t units);
+
+protected:
+    // Half of the stencil, each link is held by the cell it starts from
+    struct Link
+    {
+        int di;
+        int dj;
+        int offset;
+        int64_t conductance;
+    };
+
+    int index(int i, int j) const;
+    bool hasLink(int i, int j, const Link& link) const;
+
+    void driveRows(int j0, int j1);
+    void limitRows(int j0, int j1);
+    void scaleRows(int j0, int j1);
+    void moveRows(int j0, int j1);
+
+private:
+    const int _WIDTH;
+    const int _HEIGHT;
+    static const int _FRACTION_BITS = 24;
+    static const int64_t _ONE = int64_t(1) << _FRACTION_BITS;
+    const int64_t _LOSSYNESS;
+
+    std::vector<Link> _links;
+
+    std::vector<int32_t> _groundHeights;
+    std::vector<int32_t> _waterHeights;
+    std::vector<int64_t> _outflowScales;
+
+    // Flow into the cell holding the link, one array per link
+    std::vector<std::vector<int32_t>> _flows;
+};
+
+
+
+// IMPLEMENTATION //
+inline int FixedPointWaterSolver::width() const
+{
+    return _WIDTH;
+}
+
+inline int FixedPointWaterSolver::height() const
+{
+    return _HEIGHT;
+}
+
+inline int FixedPointWaterSolver::index(int i, int j) const
+{
+    return j * _WIDTH + i;
+}
+
+inline bool FixedPointWaterSolver::hasLink(int i, int j, const Link& link) const
+{
+    int ni = i + link.di;
+    int nj = j + link.dj;
+    return 0 <= ni && ni < _WIDTH && nj < _HEIGHT;
+}
+
+inline float FixedPointWaterSolver::waterHeight(int i, int j) const
+{
+    return fromUnits(_waterHeights[index(i, j)]);
+}
+
+inline float FixedPointWaterSolver::groundHeight(int i, int j) const
+{
+    return fromUnits(_groundHeights[index(i, j)]);
+}
+
+inline int32_t FixedPointWaterSolver::toUnits(float value)
+{
+    return static_cast<int32_t>(llround(double(value) * _ONE));
+}
+
+inline float FixedPointWaterSolver::fromUnits(int64_t units)
+{
+    return static_cast<float>(double(units) / _ONE);
+}
+
+#endif // FIXEDPOINTWATERSOLVER_H
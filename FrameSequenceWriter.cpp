@@ -0,0 +1,165 @@
+#include "FrameSequenceWriter.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+
+#include <QDir>
+#include <QImage>
+
+#include <GL3/gl3w.h>
+
+#include "MemoryAccounting.h"
+#include "WorkerPool.h"
+
+using namespace std;
+
+
+FrameSequenceWriter::FrameSequenceWriter(int width, int height,
+                                         const std::string& directory) :
+    _WIDTH(width),
+    _HEIGHT(height),
+    _DIRECTORY(directory),
+    _MAX_PENDING_WRITES(max(2, 2 * getWorkerPool().threadCount())),
+    _fbo(0),
+    _colorBuffer(0),
+    _depthBuffer(0),
+    _pbos(),
+    _capturedCount(0),
+    _retrievedCount(0),
+    _writes()
+{
+    if(!QDir().mkpath(QString::fromStdString(_DIRECTORY)))
+        throw runtime_error("Could not create the directory " + _DIRECTORY);
+
+    glGenRenderbuffers(1, &_colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, _WIDTH, _HEIGHT);
+
+    glGenRenderbuffers(1, &_depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, _depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, _WIDTH, _HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_RENDERBUFFER, _depthBuffer);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if(status != GL_FRAMEBUFFER_COMPLETE)
+        throw runtime_error("Offscreen framebuffer is incomplete");
+
+    glGenBuffers(_PBO_COUNT, _pbos);
+    for(int p=0; p < _PBO_COUNT; ++p)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, _pbos[p]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, _WIDTH * _HEIGHT * 4, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    getMemoryAccounting().allocate(MemoryAccounting::ESubsystem::GL_OBJECTS, glBytes());
+}
+
+FrameSequenceWriter::~FrameSequenceWriter()
+{
+    // Pending writes hold their own pixels, they only need to be joined
+    for(size_t w=0; w < _writes.size(); ++w)
+        _writes[w].wait();
+
+    glDeleteBuffers(_PBO_COUNT, _pbos);
+    glDeleteFramebuffers(1, &_fbo);
+    glDeleteRenderbuffers(1, &_colorBuffer);
+    glDeleteRenderbuffers(1, &_depthBuffer);
+    getMemoryAccounting().release(MemoryAccounting::ESubsystem::GL_OBJECTS, glBytes());
+}
+
+size_t FrameSequenceWriter::glBytes() const
+{
+    // Color and depth buffers, depth padded to 32 bits, and the pixel buffers
+    return size_t(_WIDTH) * _HEIGHT * 4 * (2 + _PBO_COUNT);
+}
+
+void FrameSequenceWriter::bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+    glViewport(0, 0, _WIDTH, _HEIGHT);
+}
+
+void FrameSequenceWriter::capture()
+{
+    // The buffer about to be reused still holds the oldest frame
+    if(_capturedCount - _retrievedCount == _PBO_COUNT)
+        retrieveOldest();
+
+    // 8_8_8_8_REV packs 0xAARRGGBB words, QImage's layout on any endianness
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, _pbos[_capturedCount % _PBO_COUNT]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, _WIDTH, _HEIGHT, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    ++_capturedCount;
+}
+
+void FrameSequenceWriter::finish()
+{
+    while(_retrievedCount < _capturedCount)
+        retrieveOldest();
+
+    while(!_writes.empty())
+    {
+        _writes.front().get();
+        _writes.pop_front();
+    }
+}
+
+void FrameSequenceWriter::retrieveOldest()
+{
+    const int frame = _retrievedCount;
+    const int byteCount = _WIDTH * _HEIGHT * 4;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, _pbos[frame % _PBO_COUNT]);
+    const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, byteCount, GL_MAP_READ_BIT);
+    if(mapped == nullptr)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        throw runtime_error("Could not map the pixels of frame " + to_string(frame));
+    }
+
+    shared_ptr<vector<unsigned char>> pixels(new vector<unsigned char>(byteCount));
+    memcpy(pixels->data(), mapped, byteCount);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    ++_retrievedCount;
+
+    // Bounds the memory held by frames waiting on the encoder
+    if(static_cast<int>(_writes.size()) >= _MAX_PENDING_WRITES)
+    {
+        _writes.front().get();
+        _writes.pop_front();
+    }
+
+    int width = _WIDTH;
+    int height = _HEIGHT;
+    string name = fileName(frame);
+    _writes.push_back(getWorkerPool().submit([pixels, width, height, name]()
+    {
+        // GL rows go bottom up
+        QImage image(pixels->data(), width, height, width * 4, QImage::Format_RGB32);
+        if(!image.mirrored(false, true).save(QString::fromStdString(name), "PNG"))
+            throw runtime_error("Could not write " + name);
+    }));
+}
+
+std::string FrameSequenceWriter::fileName(int frame) const
+{
+    char number[16];
+    snprintf(number, sizeof(number), "%05d", frame);
+    return _DIRECTORY + "/frame_" + number + ".png";
+}
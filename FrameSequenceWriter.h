@@ -0,0 +1,78 @@
+#ifndef FRAMESEQUENCEWRITER_H
+#define FRAMESEQUENCEWRITER_H
+
+#include <deque>
+#include <future>
+#include <string>
+
+
+// Offscreen draw target saved as a numbered image sequence.
+//
+// Each captured frame is read into one of a ring of pixel buffers, which
+// returns at once. The buffer is only mapped when the ring wraps around,
+// a few frames later, so the GL thread never waits on the readback. Pixels
+// are then encoded and written by the worker pool.
+class FrameSequenceWriter
+{
+public:
+    FrameSequenceWriter(int width, int height, const std::string& directory);
+    ~FrameSequenceWriter();
+
+    int width() const;
+    int height() const;
+    int frameCount() const;
+
+    // Binds the draw target and its viewport
+    void bind();
+
+    // Queues the readback of the frame drawn since bind()
+    void capture();
+
+    // Waits for every captured frame to be written
+    void finish();
+
+protected:
+    void retrieveOldest();
+    std::string fileName(int frame) const;
+    size_t glBytes() const;
+
+private:
+    FrameSequenceWriter(const FrameSequenceWriter&) = delete;
+    FrameSequenceWriter& operator=(const FrameSequenceWriter&) = delete;
+
+    static const int _PBO_COUNT = 3;
+
+    const int _WIDTH;
+    const int _HEIGHT;
+    const std::string _DIRECTORY;
+    const int _MAX_PENDING_WRITES;
+
+    unsigned int _fbo;
+    unsigned int _colorBuffer;
+    unsigned int _depthBuffer;
+    unsigned int _pbos[_PBO_COUNT];
+
+    int _capturedCount;
+    int _retrievedCount;
+    std::deque<std::future<void>> _writes;
+};
+
+
+
+// IMPLEMENTATION //
+inline int FrameSequenceWriter::width() const
+{
+    return _WIDTH;
+}
+
+inline int FrameSequenceWriter::height() const
+{
+    return _HEIGHT;
+}
+
+inline int FrameSequenceWriter::frameCount() const
+{
+    return _capturedCount;
+}
+
+#endif // FRAMESEQUENCEWRITER_H
@@ -0,0 +1,58 @@
+#include "FrameTimeStats.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+
+FrameTimeStats::FrameTimeStats(const std::string& name) :
+    _name(name),
+    _samples()
+{
+}
+
+void FrameTimeStats::add(double seconds)
+{
+    _samples.push_back(seconds);
+}
+
+void FrameTimeStats::clear()
+{
+    _samples.clear();
+}
+
+double FrameTimeStats::percentile(double fraction) const
+{
+    if(_samples.empty())
+        return 0.0;
+
+    vector<double> sorted = _samples;
+    size_t rank = min(static_cast<size_t>(fraction * sorted.size()),
+                      sorted.size() - 1);
+    nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+double FrameTimeStats::mean() const
+{
+    if(_samples.empty())
+        return 0.0;
+
+    double total = 0.0;
+    for(size_t s=0; s < _samples.size(); ++s)
+        total += _samples[s];
+    return total / _samples.size();
+}
+
+void FrameTimeStats::report(std::ostream& out) const
+{
+    const double MS = 1000.0;
+    out << _name << " (" << count() << " samples, ms): "
+        << "mean " << mean() * MS
+        << ", min " << percentile(0.0) * MS
+        << ", p50 " << percentile(0.5) * MS
+        << ", p90 " << percentile(0.9) * MS
+        << ", p99 " << percentile(0.99) * MS
+        << ", max " << percentile(1.0) * MS << endl;
+}
@@ -0,0 +1,37 @@
+#ifndef FRAMETIMESTATS_H
+#define FRAMETIMESTATS_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+
+// Distribution of frame or step durations, reported in milliseconds
+class FrameTimeStats
+{
+public:
+    FrameTimeStats(const std::string& name);
+
+    void add(double seconds);
+    void clear();
+    int count() const;
+
+    double percentile(double fraction) const;
+    double mean() const;
+
+    void report(std::ostream& out) const;
+
+private:
+    std::string _name;
+    std::vector<double> _samples;
+};
+
+
+
+// IMPLEMENTATION //
+inline int FrameTimeStats::count() const
+{
+    return static_cast<int>(_samples.size());
+}
+
+#endif // FRAMETIMESTATS_H
@@ -0,0 +1,23 @@
+#ifndef HALOTRANSPORT_H
+#define HALOTRANSPORT_H
+
+#include <vector>
+
+
+// Moves halo strips between the ranks of a distributed run. A send never
+// waits for the receiver of the same sequence, so a rank can post its
+// borders and keep computing while they travel.
+class HaloTransport
+{
+public:
+    virtual ~HaloTransport() {}
+
+    virtual int rank() const = 0;
+    virtual int rankCount() const = 0;
+
+    virtual void send(int peer, int sequence, const std::vector<float>& data) = 0;
+    virtual void receive(int peer, int sequence, std::vector<float>& data) = 0;
+    virtual void barrier() = 0;
+};
+
+#endif // HALOTRANSPORT_H
@@ -0,0 +1,61 @@
+#include "HeadlessWaterRun.h"
+
+#include "BasinWaterRun.h"
+#include "DistributedWaterRun.h"
+#include "EnsembleWaterRun.h"
+#include "FixedPointWaterRun.h"
+#include "ImplicitWaterRun.h"
+#include "OffscreenWaterRun.h"
+#include "ProbeWaterRun.h"
+#include "ReferenceWaterRun.h"
+#include "ReplayWaterRun.h"
+#include "SeparableWaterRun.h"
+#include "SparseWaterRun.h"
+#include "TemporalWaterRun.h"
+
+using namespace std;
+
+
+HeadlessWaterRun::HeadlessWaterRun(const WaterOptions& options) :
+    _options(options),
+    _NEIGHBORS_RADIUS(WaterOptions::NEIGHBORS_RADIUS),
+    _STRETCHNESS(WaterOptions::STRETCHNESS),
+    _LOSSYNESS(WaterOptions::LOSSYNESS)
+{
+}
+
+HeadlessWaterRun::~HeadlessWaterRun()
+{
+}
+
+std::unique_ptr<HeadlessWaterRun> HeadlessWaterRun::create(const WaterOptions& options)
+{
+    // WaterOptions::parse lets one mode through at most
+    HeadlessWaterRun* run = nullptr;
+    if(options.reference)
+        run = new ReferenceWaterRun(options);
+    else if(options.processCount > 0)
+        run = new DistributedWaterRun(options);
+    else if(options.implicitScale > 0.0f)
+        run = new ImplicitWaterRun(options);
+    else if(options.fixedPoint)
+        run = new FixedPointWaterRun(options);
+    else if(options.separableRadius > 0)
+        run = new SeparableWaterRun(options);
+    else if(options.tileSize > 0)
+        run = new SparseWaterRun(options);
+    else if(options.blockSteps > 0)
+        run = new TemporalWaterRun(options);
+    else if(options.probeCount > 0)
+        run = new ProbeWaterRun(options);
+    else if(!options.basinsFile.empty() && options.headless)
+        run = new BasinWaterRun(options);
+    else if(!options.ensembleFile.empty())
+        run = new EnsembleWaterRun(options);
+    else if(!options.offscreenDirectory.empty())
+        run = new OffscreenWaterRun(options);
+    else if(!options.replayFile.empty() && options.headless)
+        run = new ReplayWaterRun(options);
+
+    return unique_ptr<HeadlessWaterRun>(run);
+}
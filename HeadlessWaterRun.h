@@ -0,0 +1,31 @@
+#ifndef HEADLESSWATERRUN_H
+#define HEADLESSWATERRUN_H
+
+#include <memory>
+
+#include "WaterOptions.h"
+
+
+// Base of the runs without a window. Holds the options of the run and the
+// physics of the lattice, the same as the windowed simulation's.
+class HeadlessWaterRun
+{
+public:
+    virtual ~HeadlessWaterRun();
+
+    // Exit status of the process
+    virtual int execute() = 0;
+
+    // Run the options ask for, none for the windowed play
+    static std::unique_ptr<HeadlessWaterRun> create(const WaterOptions& options);
+
+protected:
+    HeadlessWaterRun(const WaterOptions& options);
+
+    const WaterOptions _options;
+    const int _NEIGHBORS_RADIUS;
+    const float _STRETCHNESS;
+    const float _LOSSYNESS;
+};
+
+#endif // HEADLESSWATERRUN_H
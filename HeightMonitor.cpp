@@ -0,0 +1,89 @@
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <exception>
+using namespace std;
+
+#include "SharedHeightReader.h"
+
+
+// Demo consumer of the published height field. Watches the surface in place
+// and raises a flood alert when water gets deeper than a threshold.
+int main(int argc, char** argv) try
+{
+    string name = argc > 1 ? argv[1] : "/WaterSurface";
+    float threshold = argc > 2 ? static_cast<float>(atof(argv[2])) : 0.3f;
+
+    SharedHeightReader reader(name);
+    const int cellCount = reader.width() * reader.height();
+
+    // Copied again after each edit, odd until the first copy
+    vector<float> ground(cellCount);
+    uint64_t groundRevision = 1;
+
+    cout << "Monitoring " << name << ": " << reader.width() << "x"
+         << reader.height() << " lattice, alert above " << threshold
+         << " of depth" << endl;
+
+    uint64_t lastFrame = 0;
+    int retries = 0;
+    while(reader.isWriterAlive())
+    {
+        if(reader.groundRevision() != groundRevision &&
+           !reader.copyGround(ground.data(), groundRevision))
+        {
+            this_thread::sleep_for(chrono::milliseconds(1));
+            continue;
+        }
+
+        SharedHeightReader::Snapshot snapshot;
+        if(!reader.acquire(snapshot) || snapshot.frame == lastFrame)
+        {
+            this_thread::sleep_for(chrono::milliseconds(1));
+            continue;
+        }
+
+        float maxDepth = 0.0f;
+        double volume = 0.0;
+        int floodedCells = 0;
+        for(int c=0; c < cellCount; ++c)
+        {
+            float depth = snapshot.waterHeights[c] - ground[c];
+            volume += depth;
+            maxDepth = max(maxDepth, depth);
+            floodedCells += depth > threshold ? 1 : 0;
+        }
+
+        // The writer went through both slots while we were reading
+        if(!reader.validate(snapshot))
+        {
+            ++retries;
+            continue;
+        }
+
+        if(snapshot.frame / 100 != lastFrame / 100)
+        {
+            cout << "Frame " << snapshot.frame
+                 << ": volume " << volume
+                 << ", max depth " << maxDepth
+                 << ", retries " << retries;
+            if(floodedCells != 0)
+                cout << "  FLOOD ALERT on " << floodedCells << " cells";
+            cout << endl;
+        }
+
+        lastFrame = snapshot.frame;
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+
+    cout << "Writer is gone, last frame " << lastFrame << endl;
+    return 0;
+}
+catch(exception& e)
+{
+    cerr << "Exception caught : " << e.what() << endl;
+    return 1;
+}
@@ -0,0 +1,107 @@
+#include "ImplicitWaterRun.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "ImplicitWaterSolver.h"
+#include "WaterSolver.h"
+
+using namespace std;
+
+
+ImplicitWaterRun::ImplicitWaterRun(const WaterOptions& options) :
+    HeadlessWaterRun(options)
+{
+}
+
+int ImplicitWaterRun::execute()
+{
+    WaterSolver solver(_options.width, _options.height, _NEIGHBORS_RADIUS,
+                       _STRETCHNESS, _LOSSYNESS);
+    solver.setupScenario(_options.initialScenario());
+    double initialVolume = waterVolume(solver);
+
+    ImplicitWaterSolver implicit(solver);
+    implicit.setup();
+
+    cout << "Implicit run: " << _options.width << "x" << _options.height
+         << " lattice, " << _options.stepCount << " nominal steps in steps of "
+         << _options.implicitScale << ", " << implicit.levelCount()
+         << " multigrid levels" << endl;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    int stepCount = 0;
+    int cycleCount = 0;
+    float worstResidual = 0.0f;
+    float remaining = static_cast<float>(_options.stepCount);
+    while(remaining > 0.0f)
+    {
+        float scale = min(_options.implicitScale, remaining);
+        implicit.step(scale);
+        remaining -= scale;
+
+        ++stepCount;
+        cycleCount += implicit.cycleCount();
+        worstResidual = max(worstResidual, implicit.residual());
+    }
+
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+    double drift = (waterVolume(solver) - initialVolume) / initialVolume;
+    cout << "Implicit run: " << seconds << " s, " << stepCount << " steps, "
+         << cycleCount / static_cast<double>(stepCount) << " V-cycles per step, "
+         << "worst relative residual " << worstResidual << ", "
+         << "volume drift " << drift * 100.0 << "%" << endl;
+
+    if(_options.verify)
+        verify(solver, seconds);
+
+    return 0;
+}
+
+void ImplicitWaterRun::verify(const WaterSolver& implicit, double implicitSeconds)
+{
+    WaterSolver solver(_options.width, _options.height, _NEIGHBORS_RADIUS,
+                       _STRETCHNESS, _LOSSYNESS);
+    solver.setupScenario(_options.initialScenario());
+    double initialVolume = waterVolume(solver);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(int s=0; s < _options.stepCount; ++s)
+        solver.step();
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+
+    // Backward steps damp the short waves, the gap is the price of the
+    // long steps rather than an error of the solve
+    double sumSquares = 0.0;
+    float maxDifference = 0.0f;
+    const FieldArray& heights = solver.waterHeights();
+    for(size_t c=0; c < heights.size(); ++c)
+    {
+        float difference = fabs(heights[c] - implicit.waterHeights()[c]);
+        sumSquares += difference * static_cast<double>(difference);
+        maxDifference = max(maxDifference, difference);
+    }
+
+    double drift = (waterVolume(solver) - initialVolume) / initialVolume;
+    cout << "Explicit path: " << seconds << " s, "
+         << _options.stepCount << " steps, "
+         << "volume drift " << drift * 100.0 << "%" << endl;
+    cout << "Implicit speedup: " << seconds / implicitSeconds << "x, "
+         << "RMS difference " << sqrt(sumSquares / heights.size()) << ", "
+         << "max difference " << maxDifference << endl;
+}
+
+double ImplicitWaterRun::waterVolume(const WaterSolver& solver) const
+{
+    double volume = 0.0;
+    const FieldArray& heights = solver.waterHeights();
+    const FieldArray& ground = solver.groundHeights();
+    for(size_t c=0; c < heights.size(); ++c)
+        volume += max(heights[c] - ground[c], 0.0f);
+    return volume;
+}
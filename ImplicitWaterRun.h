@@ -0,0 +1,25 @@
+#ifndef IMPLICITWATERRUN_H
+#define IMPLICITWATERRUN_H
+
+#include "HeadlessWaterRun.h"
+
+class WaterSolver;
+
+
+// Headless run of the multigrid implicit backend. Covers the nominal steps
+// of the run with steps of the requested length and reports the time to
+// solution. Verification runs the explicit exchange over the same time and
+// compares the two surfaces.
+class ImplicitWaterRun : public HeadlessWaterRun
+{
+public:
+    ImplicitWaterRun(const WaterOptions& options);
+
+    virtual int execute();
+
+protected:
+    void verify(const WaterSolver& implicit, double implicitSeconds);
+    double waterVolume(const WaterSolver& solver) const;
+};
+
+#endif // IMPLICITWATERRUN_H
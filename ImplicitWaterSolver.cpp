@@ -0,0 +1,313 @@
+#include "ImplicitWaterSolver.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+#include "WaterSolver.h"
+
+using namespace std;
+
+
+namespace
+{
+    // Five points equivalent of the exchange : same second moment
+    float faceConductance(const WaterSolver& solver)
+    {
+        const StencilArray& stencil = solver.stencil();
+
+        float moment = 0.0f;
+        float totalContribution = 0.0f;
+        for(size_t t=0; t < stencil.size(); ++t)
+        {
+            moment += stencil[t].baseContribution * stencil[t].di * stencil[t].di;
+            totalContribution += stencil[t].baseContribution;
+        }
+
+        return solver.stretchness() * moment / (2.0f * totalContribution);
+    }
+
+    // Increments fade exponentially away from the waves. Denormal values
+    // would slow the sweeps down by an order of magnitude.
+    class FlushDenormals
+    {
+    public:
+#if defined(__SSE__) || defined(_M_X64)
+        FlushDenormals() : _saved(_mm_getcsr()) { _mm_setcsr(_saved | 0x8040); }
+        ~FlushDenormals() { _mm_setcsr(_saved); }
+    private:
+        unsigned int _saved;
+#endif
+    };
+}
+
+
+ImplicitWaterSolver::ImplicitWaterSolver(WaterSolver& solver) :
+    _solver(solver),
+    _FACE_CONDUCTANCE(faceConductance(solver)),
+    _PRE_SMOOTHING(2),
+    _POST_SMOOTHING(2),
+    _COARSEST_SWEEPS(32),
+    _MAX_CYCLES(20),
+    _TOLERANCE(1e-4f),
+    _levels(),
+    _cycleCount(0),
+    _residual(0.0f)
+{
+}
+
+void ImplicitWaterSolver::setup()
+{
+    assert( _solver.storageWidth() == _solver.width() );
+    assert( _solver.storageHeight() == _solver.height() );
+
+    // Halve the lattice until the coarsest level is a few cells wide
+    _levels.clear();
+    int width = _solver.width();
+    int height = _solver.height();
+    while(true)
+    {
+        Level level;
+        level.width = width;
+        level.height = height;
+        level.conductX.assign(width * height, 0.0f);
+        level.conductY.assign(width * height, 0.0f);
+        level.values.assign(width * height, 0.0f);
+        level.rhs.assign(width * height, 0.0f);
+        level.residuals.assign(width * height, 0.0f);
+        _levels.push_back(level);
+
+        if(min(width, height) <= 4)
+            break;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+}
+
+void ImplicitWaterSolver::step(float scale)
+{
+    assert( scale > 0.0f );
+    assert( !_levels.empty() );
+    FlushDenormals flush;
+
+    float damping = 1.0f + _solver.lossyness() * scale;
+    float a = scale * scale / damping;
+    float b = scale / damping;
+
+    FieldArray& heights = _solver.waterHeights();
+    const FieldArray& ground = _solver.groundHeights();
+    FieldArray& velocities = _solver.velocities();
+
+    assemble(a);
+
+    // Solving for the increment keeps the residuals clear of the rounding
+    // of the heights. Free flight of the surface is the first guess.
+    Level& fine = _levels[0];
+    for(int j=0; j < fine.height; ++j)
+    {
+        for(int i=0; i < fine.width; ++i)
+        {
+            int c = j * fine.width + i;
+            fine.rhs[c] = b * velocities[c] + netFlux(fine, heights.data(), i, j);
+            fine.values[c] = b * velocities[c];
+        }
+    }
+
+    float initial = computeResiduals(fine);
+    float current = initial;
+    _cycleCount = 0;
+    while(current > _TOLERANCE * initial && _cycleCount < _MAX_CYCLES)
+    {
+        vCycle(0);
+        current = computeResiduals(fine);
+        ++_cycleCount;
+    }
+    _residual = initial > 0.0f ? current / initial : 0.0f;
+
+    // Linearized faces may pull a shore cell under its ground
+    for(size_t c=0; c < heights.size(); ++c)
+    {
+        float next = max(heights[c] + fine.values[c], ground[c]);
+        velocities[c] = (next - heights[c]) / scale;
+        heights[c] = next;
+    }
+}
+
+void ImplicitWaterSolver::assemble(float a)
+{
+    const FieldArray& heights = _solver.waterHeights();
+    const FieldArray& ground = _solver.groundHeights();
+    float conductance = a * _FACE_CONDUCTANCE;
+
+    Level& fine = _levels[0];
+    int w = fine.width;
+    for(int j=0; j < fine.height; ++j)
+    {
+        for(int i=0; i < w; ++i)
+        {
+            int c = j * w + i;
+            fine.conductX[c] = 0.0f;
+            fine.conductY[c] = 0.0f;
+
+            if(i + 1 < w && max(heights[c], heights[c + 1]) >
+                            max(ground[c], ground[c + 1]))
+                fine.conductX[c] = conductance;
+
+            if(j + 1 < fine.height && max(heights[c], heights[c + w]) >
+                                      max(ground[c], ground[c + w]))
+                fine.conductY[c] = conductance;
+        }
+    }
+
+    for(size_t l=1; l < _levels.size(); ++l)
+        coarsenOperator(_levels[l - 1], _levels[l]);
+}
+
+void ImplicitWaterSolver::coarsenOperator(const Level& fine, Level& coarse)
+{
+    // Two fine faces cross a coarse face twice as long : their mean over
+    // the square of the spacing ratio
+    for(int J=0; J < coarse.height; ++J)
+    {
+        for(int I=0; I < coarse.width; ++I)
+        {
+            int C = J * coarse.width + I;
+            float sumX = 0.0f;
+            float sumY = 0.0f;
+            for(int d=0; d < 2; ++d)
+            {
+                int j = 2*J + d;
+                int i = 2*I + 1;
+                if(j < fine.height && i < fine.width)
+                    sumX += fine.conductX[j * fine.width + i];
+
+                j = 2*J + 1;
+                i = 2*I + d;
+                if(j < fine.height && i < fine.width)
+                    sumY += fine.conductY[j * fine.width + i];
+            }
+
+            coarse.conductX[C] = sumX / 8.0f;
+            coarse.conductY[C] = sumY / 8.0f;
+        }
+    }
+}
+
+void ImplicitWaterSolver::vCycle(int l)
+{
+    Level& level = _levels[l];
+    if(l + 1 == static_cast<int>(_levels.size()))
+    {
+        smooth(level, _COARSEST_SWEEPS);
+        return;
+    }
+
+    smooth(level, _PRE_SMOOTHING);
+    computeResiduals(level);
+
+    Level& coarse = _levels[l + 1];
+    restrictResiduals(level, coarse);
+    fill(coarse.values.begin(), coarse.values.end(), 0.0f);
+    vCycle(l + 1);
+
+    prolongate(coarse, level);
+    smooth(level, _POST_SMOOTHING);
+}
+
+void ImplicitWaterSolver::smooth(Level& level, int sweeps)
+{
+    // Red-black Gauss-Seidel
+    const int w = level.width;
+    const int h = level.height;
+    const float* cx = level.conductX.data();
+    const float* cy = level.conductY.data();
+    const float* rhs = level.rhs.data();
+    float* x = level.values.data();
+
+    for(int s=0; s < 2 * sweeps; ++s)
+    {
+        int color = s % 2;
+        for(int j=0; j < h; ++j)
+        {
+            for(int i=(j + color) % 2; i < w; i += 2)
+            {
+                int c = j * w + i;
+                float diagonal = 1.0f;
+                float sum = rhs[c];
+                if(i > 0)     { sum += cx[c - 1] * x[c - 1]; diagonal += cx[c - 1]; }
+                if(i + 1 < w) { sum += cx[c]     * x[c + 1]; diagonal += cx[c]; }
+                if(j > 0)     { sum += cy[c - w] * x[c - w]; diagonal += cy[c - w]; }
+                if(j + 1 < h) { sum += cy[c]     * x[c + w]; diagonal += cy[c]; }
+                x[c] = sum / diagonal;
+            }
+        }
+    }
+}
+
+float ImplicitWaterSolver::computeResiduals(Level& level)
+{
+    const float* x = level.values.data();
+
+    double norm = 0.0;
+    for(int j=0; j < level.height; ++j)
+    {
+        for(int i=0; i < level.width; ++i)
+        {
+            int c = j * level.width + i;
+            float r = level.rhs[c] - (x[c] - netFlux(level, x, i, j));
+            level.residuals[c] = r;
+            norm += r * static_cast<double>(r);
+        }
+    }
+
+    return static_cast<float>(sqrt(norm));
+}
+
+void ImplicitWaterSolver::restrictResiduals(const Level& fine, Level& coarse)
+{
+    for(int J=0; J < coarse.height; ++J)
+    {
+        for(int I=0; I < coarse.width; ++I)
+        {
+            float sum = 0.0f;
+            int count = 0;
+            for(int j=2*J; j < min(2*J + 2, fine.height); ++j)
+            {
+                for(int i=2*I; i < min(2*I + 2, fine.width); ++i)
+                {
+                    sum += fine.residuals[j * fine.width + i];
+                    ++count;
+                }
+            }
+
+            coarse.rhs[J * coarse.width + I] = sum / count;
+        }
+    }
+}
+
+void ImplicitWaterSolver::prolongate(const Level& coarse, Level& fine)
+{
+    // Bilinear between coarse cell centers, clamped at the borders
+    const int W = coarse.width;
+    const int H = coarse.height;
+    for(int j=0; j < fine.height; ++j)
+    {
+        int J = j / 2;
+        int Jn = min(max(j % 2 == 0 ? J - 1 : J + 1, 0), H - 1);
+        for(int i=0; i < fine.width; ++i)
+        {
+            int I = i / 2;
+            int In = min(max(i % 2 == 0 ? I - 1 : I + 1, 0), W - 1);
+
+            float correction =
+                0.5625f * coarse.values[J  * W + I]  +
+                0.1875f * coarse.values[J  * W + In] +
+                0.1875f * coarse.values[Jn * W + I]  +
+                0.0625f * coarse.values[Jn * W + In];
+            fine.values[j * fine.width + i] += correction;
+        }
+    }
+}
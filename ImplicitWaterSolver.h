@@ -0,0 +1,103 @@
+#ifndef IMPLICITWATERSOLVER_H
+#define IMPLICITWATERSOLVER_H
+
+#include <vector>
+
+class WaterSolver;
+
+
+// Semi-implicit backend of the lattice, for smooth flows over large basins.
+//
+// A step of length tau solves the damped wave equation of the exchange
+// backward in time : (I - a L) h' = h + b v. L is a five points Laplacian
+// whose faces open when the water of one side stands above the ground of
+// the other, so wet and dry cells follow the ground. The system is solved
+// with geometric multigrid V-cycles, which lets tau go far beyond the one
+// cell per step reach of the explicit exchange.
+//
+// Works in place on the buffers of a whole lattice solver. Velocities keep
+// their meaning : water moved per nominal step.
+class ImplicitWaterSolver
+{
+public:
+    ImplicitWaterSolver(WaterSolver& solver);
+
+    void setup();
+    void step(float scale);
+
+    // V-cycles and relative residual of the last step
+    int cycleCount() const;
+    float residual() const;
+    int levelCount() const;
+
+protected:
+    // Face conductances are stored on the cell at their left or bottom
+    struct Level
+    {
+        int width;
+        int height;
+        std::vector<float> conductX;
+        std::vector<float> conductY;
+        std::vector<float> values;
+        std::vector<float> rhs;
+        std::vector<float> residuals;
+    };
+
+    void assemble(float a);
+    void coarsenOperator(const Level& fine, Level& coarse);
+    void vCycle(int l);
+    void smooth(Level& level, int sweeps);
+    float computeResiduals(Level& level);
+    float netFlux(const Level& level, const float* x, int i, int j) const;
+    void restrictResiduals(const Level& fine, Level& coarse);
+    void prolongate(const Level& coarse, Level& fine);
+
+private:
+    WaterSolver& _solver;
+    const float _FACE_CONDUCTANCE;
+    const int _PRE_SMOOTHING;
+    const int _POST_SMOOTHING;
+    const int _COARSEST_SWEEPS;
+    const int _MAX_CYCLES;
+    const float _TOLERANCE;
+
+    std::vector<Level> _levels;
+    int _cycleCount;
+    float _residual;
+};
+
+
+
+// IMPLEMENTATION //
+inline int ImplicitWaterSolver::cycleCount() const
+{
+    return _cycleCount;
+}
+
+inline float ImplicitWaterSolver::residual() const
+{
+    return _residual;
+}
+
+inline int ImplicitWaterSolver::levelCount() const
+{
+    return static_cast<int>(_levels.size());
+}
+
+inline float ImplicitWaterSolver::netFlux(const Level& level, const float* x,
+                                          int i, int j) const
+{
+    const int w = level.width;
+    const int c = j * w + i;
+    const float* cx = level.conductX.data();
+    const float* cy = level.conductY.data();
+
+    float flux = 0.0f;
+    if(i > 0)                flux += cx[c - 1] * (x[c - 1] - x[c]);
+    if(i + 1 < w)            flux += cx[c]     * (x[c + 1] - x[c]);
+    if(j > 0)                flux += cy[c - w] * (x[c - w] - x[c]);
+    if(j + 1 < level.height) flux += cy[c]     * (x[c + w] - x[c]);
+    return flux;
+}
+
+#endif // IMPLICITWATERSOLVER_H
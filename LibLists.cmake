@@ -3,13 +3,31 @@ FIND_PACKAGE(Qt4 REQUIRED)
 SET(QT_USE_QTOPENGL TRUE)
 INCLUDE(${QT_USE_FILE})
 
+# Threads
+FIND_PACKAGE(Threads REQUIRED)
+
 SET(WATER_SURFACE_LIBRARIES
     ${QT_LIBRARIES}
+    ${CMAKE_THREAD_LIBS_INIT}
     CellarWorkbench
     MediaWorkbench
     PropRoom2D
     Scaena
 )
+
+IF(UNIX)
+    SET(WATER_SURFACE_LIBRARIES ${WATER_SURFACE_LIBRARIES} rt)
+ENDIF()
+
+# EGL, for offscreen runs without a display server
+FIND_PATH(EGL_INCLUDE_DIR EGL/egl.h)
+FIND_LIBRARY(EGL_LIBRARY EGL)
+IF(EGL_INCLUDE_DIR AND EGL_LIBRARY)
+    ADD_DEFINITIONS(-DWATER_SURFACE_EGL)
+    SET(WATER_SURFACE_LIBRARIES ${WATER_SURFACE_LIBRARIES} ${EGL_LIBRARY})
+ELSE()
+    MESSAGE(STATUS "EGL not found, offscreen rendering is disabled")
+ENDIF()
     
 SET(WATER_SURFACE_INCLUDE_DIRS
     ${WATER_SURFACE_SRC_DIR}
@@ -17,3 +35,7 @@ SET(WATER_SURFACE_INCLUDE_DIRS
     ${WATER_SURFACE_INSTALL_PREFIX}/include/MediaWorkbench
     ${WATER_SURFACE_INSTALL_PREFIX}/include/PropRoom2D
     ${WATER_SURFACE_INSTALL_PREFIX}/include/Scaena)
+
+IF(EGL_INCLUDE_DIR)
+    SET(WATER_SURFACE_INCLUDE_DIRS ${WATER_SURFACE_INCLUDE_DIRS} ${EGL_INCLUDE_DIR})
+ENDIF()
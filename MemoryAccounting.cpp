@@ -0,0 +1,97 @@
+#include "MemoryAccounting.h"
+
+#include <sstream>
+
+using namespace std;
+
+
+MemoryAccounting::MemoryAccounting() :
+    _currentTotal(0),
+    _peakTotal(0)
+{
+    for(int s=0; s < SUBSYSTEM_COUNT; ++s)
+    {
+        _current[s].store(0);
+        _peak[s].store(0);
+    }
+}
+
+void MemoryAccounting::allocate(ESubsystem subsystem, size_t bytes)
+{
+    int s = static_cast<int>(subsystem);
+    raise(_peak[s], _current[s].fetch_add(bytes, memory_order_relaxed) + bytes);
+    raise(_peakTotal, _currentTotal.fetch_add(bytes, memory_order_relaxed) + bytes);
+}
+
+void MemoryAccounting::release(ESubsystem subsystem, size_t bytes)
+{
+    _current[static_cast<int>(subsystem)].fetch_sub(bytes, memory_order_relaxed);
+    _currentTotal.fetch_sub(bytes, memory_order_relaxed);
+}
+
+void MemoryAccounting::raise(std::atomic<size_t>& peak, size_t bytes)
+{
+    size_t highest = peak.load(memory_order_relaxed);
+    while(bytes > highest &&
+          !peak.compare_exchange_weak(highest, bytes, memory_order_relaxed))
+        continue;
+}
+
+const char* MemoryAccounting::name(ESubsystem subsystem)
+{
+    switch(subsystem)
+    {
+    case ESubsystem::FIELDS :     return "fields";
+    case ESubsystem::SOLVER :     return "solver";
+    case ESubsystem::SNAPSHOTS :  return "snapshots";
+    case ESubsystem::RENDERER :   return "renderer";
+    case ESubsystem::GL_OBJECTS : return "gl";
+    case ESubsystem::TERRAIN :    return "terrain";
+    }
+
+    return "";
+}
+
+std::string MemoryAccounting::summary(double cellCount) const
+{
+    const double MIB = 1048576.0;
+    ostringstream out;
+    out.precision(3);
+    out << "Memory: " << currentTotal() / MIB << " MiB, peak "
+        << peakTotal() / MIB << " MiB, "
+        << (cellCount > 0.0 ? currentTotal() / cellCount : 0.0) << " B/cell";
+    return out.str();
+}
+
+void MemoryAccounting::report(std::ostream& out, double cellCount) const
+{
+    // Subsystems peak at different times, their peaks may sum over the total
+    double perCell = cellCount > 0.0 ? 1.0 / cellCount : 0.0;
+    out << "{" << endl
+        << "  \"cells\": " << cellCount << "," << endl
+        << "  \"total\": {\"current\": " << currentTotal()
+        << ", \"peak\": " << peakTotal()
+        << ", \"currentPerCell\": " << currentTotal() * perCell
+        << ", \"peakPerCell\": " << peakTotal() * perCell << "}," << endl
+        << "  \"subsystems\": {" << endl;
+
+    for(int s=0; s < SUBSYSTEM_COUNT; ++s)
+    {
+        ESubsystem subsystem = static_cast<ESubsystem>(s);
+        out << "    \"" << name(subsystem) << "\": {"
+            << "\"current\": " << currentBytes(subsystem)
+            << ", \"peak\": " << peakBytes(subsystem)
+            << ", \"currentPerCell\": " << currentBytes(subsystem) * perCell
+            << ", \"peakPerCell\": " << peakBytes(subsystem) * perCell << "}"
+            << (s + 1 < SUBSYSTEM_COUNT ? "," : "") << endl;
+    }
+
+    out << "  }" << endl
+        << "}" << endl;
+}
+
+MemoryAccounting& getMemoryAccounting()
+{
+    static MemoryAccounting accounting;
+    return accounting;
+}
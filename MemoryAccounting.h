@@ -0,0 +1,117 @@
+#ifndef MEMORYACCOUNTING_H
+#define MEMORYACCOUNTING_H
+
+#include <new>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstddef>
+
+
+// Bytes held by each subsystem of the process, now and at their highest.
+//
+// Containers count themselves through their allocator : FieldAllocator for
+// the lattice fields, TrackingAllocator for the other arrays that grow with
+// the lattice. GL objects and mapped terrain tiles are counted by their
+// owners when they are created and deleted. Counters are atomic, so any
+// thread may allocate.
+class MemoryAccounting
+{
+public:
+    enum class ESubsystem {FIELDS, SOLVER, SNAPSHOTS, RENDERER, GL_OBJECTS, TERRAIN};
+    static const int SUBSYSTEM_COUNT = 6;
+
+    MemoryAccounting();
+
+    void allocate(ESubsystem subsystem, size_t bytes);
+    void release(ESubsystem subsystem, size_t bytes);
+
+    size_t currentBytes(ESubsystem subsystem) const;
+    size_t peakBytes(ESubsystem subsystem) const;
+    size_t currentTotal() const;
+    size_t peakTotal() const;
+
+    static const char* name(ESubsystem subsystem);
+
+    // One line for the HUD
+    std::string summary(double cellCount) const;
+
+    // JSON object, with the bytes per cell of a lattice of cellCount cells
+    void report(std::ostream& out, double cellCount) const;
+
+private:
+    static void raise(std::atomic<size_t>& peak, size_t bytes);
+
+    std::atomic<size_t> _current[SUBSYSTEM_COUNT];
+    std::atomic<size_t> _peak[SUBSYSTEM_COUNT];
+    std::atomic<size_t> _currentTotal;
+    std::atomic<size_t> _peakTotal;
+};
+
+// Process wide accounting
+MemoryAccounting& getMemoryAccounting();
+
+
+// Standard allocator that counts its bytes for a subsystem
+template<typename T, MemoryAccounting::ESubsystem S>
+class TrackingAllocator
+{
+public:
+    typedef T value_type;
+
+    TrackingAllocator() {}
+    template<typename U>
+    TrackingAllocator(const TrackingAllocator<U, S>&) {}
+
+    T* allocate(size_t count);
+    void deallocate(T* pointer, size_t count);
+
+    template<typename U>
+    struct rebind {typedef TrackingAllocator<U, S> other;};
+};
+
+template<typename T, typename U, MemoryAccounting::ESubsystem S>
+bool operator==(const TrackingAllocator<T, S>&, const TrackingAllocator<U, S>&) {return true;}
+template<typename T, typename U, MemoryAccounting::ESubsystem S>
+bool operator!=(const TrackingAllocator<T, S>&, const TrackingAllocator<U, S>&) {return false;}
+
+
+
+// IMPLEMENTATION //
+inline size_t MemoryAccounting::currentBytes(ESubsystem subsystem) const
+{
+    return _current[static_cast<int>(subsystem)].load(std::memory_order_relaxed);
+}
+
+inline size_t MemoryAccounting::peakBytes(ESubsystem subsystem) const
+{
+    return _peak[static_cast<int>(subsystem)].load(std::memory_order_relaxed);
+}
+
+inline size_t MemoryAccounting::currentTotal() const
+{
+    return _currentTotal.load(std::memory_order_relaxed);
+}
+
+inline size_t MemoryAccounting::peakTotal() const
+{
+    return _peakTotal.load(std::memory_order_relaxed);
+}
+
+template<typename T, MemoryAccounting::ESubsystem S>
+T* TrackingAllocator<T, S>::allocate(size_t count)
+{
+    T* pointer = static_cast<T*>(::operator new(count * sizeof(T)));
+    getMemoryAccounting().allocate(S, count * sizeof(T));
+    return pointer;
+}
+
+template<typename T, MemoryAccounting::ESubsystem S>
+void TrackingAllocator<T, S>::deallocate(T* pointer, size_t count)
+{
+    getMemoryAccounting().release(S, count * sizeof(T));
+    ::operator delete(pointer);
+}
+
+#endif // MEMORYACCOUNTING_H
@@ -0,0 +1,117 @@
+#include "NumaTopology.h"
+
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+
+#include <dirent.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+
+std::vector<int> NumaTopology::allowedCpus()
+{
+    vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for(int c=0; c < CPU_SETSIZE; ++c)
+            if(CPU_ISSET(c, &set))
+                cpus.push_back(c);
+    }
+
+    stable_sort(cpus.begin(), cpus.end(), [](int a, int b) {
+        return nodeOfCpu(a) < nodeOfCpu(b);});
+    return cpus;
+}
+
+int NumaTopology::nodeOfCpu(int cpu)
+{
+    // The cpu directory holds a nodeN link on NUMA kernels
+    ostringstream path;
+    path << "/sys/devices/system/cpu/cpu" << cpu;
+    DIR* directory = opendir(path.str().c_str());
+    if(directory == nullptr)
+        return 0;
+
+    int node = 0;
+    while(dirent* entry = readdir(directory))
+    {
+        string name = entry->d_name;
+        if(name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+           name.find_first_not_of("0123456789", 4) == string::npos)
+        {
+            node = stoi(name.substr(4));
+            break;
+        }
+    }
+
+    closedir(directory);
+    return node;
+}
+
+int NumaTopology::currentCpu()
+{
+    return sched_getcpu();
+}
+
+std::vector<int> NumaTopology::pageNodes(const void* data, size_t bytes,
+                                         int sampleCount)
+{
+    const size_t PAGE = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t first = reinterpret_cast<uintptr_t>(data) / PAGE * PAGE;
+    size_t pageCount = (reinterpret_cast<uintptr_t>(data) + bytes - first + PAGE - 1) / PAGE;
+    size_t count = min(pageCount, static_cast<size_t>(sampleCount));
+
+    vector<void*> pages(count);
+    for(size_t p=0; p < count; ++p)
+        pages[p] = reinterpret_cast<void*>(first + p * pageCount / count * PAGE);
+
+    // Without target nodes, move_pages only reports where the pages are
+    vector<int> nodes(count, 0);
+    if(syscall(SYS_move_pages, 0, count, pages.data(), nullptr,
+               nodes.data(), 0) != 0)
+        fill(nodes.begin(), nodes.end(), 0);
+
+    for(size_t p=0; p < count; ++p)
+        nodes[p] = nodes[p] < 0 ? -1 : nodes[p];
+    return nodes;
+}
+
+size_t NumaTopology::hugePageBytes(const void* data, size_t bytes)
+{
+    uintptr_t begin = reinterpret_cast<uintptr_t>(data);
+    uintptr_t end = begin + bytes;
+
+    ifstream smaps("/proc/self/smaps");
+    string line;
+    bool isOverlapping = false;
+    size_t total = 0;
+    while(getline(smaps, line))
+    {
+        // Mapping headers start with their address range
+        uintptr_t from = 0, to = 0;
+        char dash = 0;
+        istringstream header(line);
+        if(header >> hex >> from >> dash >> to && dash == '-')
+        {
+            isOverlapping = from < end && begin < to;
+            continue;
+        }
+
+        if(isOverlapping && line.compare(0, 14, "AnonHugePages:") == 0)
+        {
+            size_t kiloBytes = 0;
+            istringstream(line.substr(14)) >> kiloBytes;
+            total += kiloBytes * 1024;
+        }
+    }
+
+    return total;
+}
@@ -0,0 +1,27 @@
+#ifndef NUMATOPOLOGY_H
+#define NUMATOPOLOGY_H
+
+#include <vector>
+#include <cstddef>
+
+
+// Where threads run and where memory lives, as the kernel reports it.
+// Hosts without NUMA report every CPU and page on node 0.
+class NumaTopology
+{
+public:
+    // CPUs the process may run on, grouped by node
+    static std::vector<int> allowedCpus();
+    static int nodeOfCpu(int cpu);
+    static int currentCpu();
+
+    // Node of each sampled page of a range, -1 where the page is not
+    // resident. At most sampleCount pages, evenly spaced.
+    static std::vector<int> pageNodes(const void* data, size_t bytes,
+                                      int sampleCount);
+
+    // Bytes backed by transparent huge pages in the mappings of a range
+    static size_t hugePageBytes(const void* data, size_t bytes);
+};
+
+#endif // NUMATOPOLOGY_H
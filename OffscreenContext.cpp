@@ -0,0 +1,122 @@
+#include "OffscreenContext.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <GL3/gl3w.h>
+
+#ifdef WATER_SURFACE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+using namespace std;
+
+
+#ifdef WATER_SURFACE_EGL
+OffscreenContext::OffscreenContext() :
+    _display(EGL_NO_DISPLAY),
+    _context(EGL_NO_CONTEXT),
+    _surface(EGL_NO_SURFACE)
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(getPlatformDisplay != nullptr)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if(display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if(display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+        fail("Could not open an EGL display");
+    _display = display;
+
+    if(!eglBindAPI(EGL_OPENGL_API))
+        fail("EGL display does not support desktop OpenGL");
+
+    const EGLint CONFIG_ATTRIBS[] = {
+        EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE,   8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE,  8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if(!eglChooseConfig(display, CONFIG_ATTRIBS, &config, 1, &configCount) ||
+       configCount == 0)
+        fail("No EGL config renders OpenGL to a pbuffer");
+
+    _context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+    if(_context == EGL_NO_CONTEXT)
+        fail("Could not create an EGL context");
+
+    // Frames are drawn in framebuffer objects, a surface is only made
+    // when the context can not be current without one
+    const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if(extensions == nullptr || strstr(extensions, "EGL_KHR_surfaceless_context") == nullptr)
+    {
+        const EGLint PBUFFER_ATTRIBS[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        _surface = eglCreatePbufferSurface(display, config, PBUFFER_ATTRIBS);
+        if(_surface == EGL_NO_SURFACE)
+            fail("Could not create an EGL pbuffer");
+    }
+
+    if(!eglMakeCurrent(display, _surface, _surface, _context))
+        fail("Could not make the EGL context current");
+
+    if(gl3wInit() != 0)
+        fail("Could not load the OpenGL functions");
+}
+
+OffscreenContext::~OffscreenContext()
+{
+    release();
+}
+
+void OffscreenContext::release()
+{
+    if(_display == EGL_NO_DISPLAY)
+        return;
+
+    eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if(_surface != EGL_NO_SURFACE)
+        eglDestroySurface(_display, _surface);
+    if(_context != EGL_NO_CONTEXT)
+        eglDestroyContext(_display, _context);
+    eglTerminate(_display);
+
+    _display = EGL_NO_DISPLAY;
+    _context = EGL_NO_CONTEXT;
+    _surface = EGL_NO_SURFACE;
+}
+#else
+OffscreenContext::OffscreenContext() :
+    _display(nullptr),
+    _context(nullptr),
+    _surface(nullptr)
+{
+    fail("Offscreen rendering needs a build with EGL");
+}
+
+OffscreenContext::~OffscreenContext()
+{
+}
+
+void OffscreenContext::release()
+{
+}
+#endif
+
+void OffscreenContext::fail(const std::string& message)
+{
+    release();
+    throw runtime_error(message);
+}
+
+std::string OffscreenContext::renderer() const
+{
+    const GLubyte* name = glGetString(GL_RENDERER);
+    return name != nullptr ? reinterpret_cast<const char*>(name) : "unknown";
+}
@@ -0,0 +1,33 @@
+#ifndef OFFSCREENCONTEXT_H
+#define OFFSCREENCONTEXT_H
+
+#include <string>
+
+
+// OpenGL context without a window nor a display server. Uses the EGL
+// surfaceless platform when available, which Mesa's llvmpipe provides on
+// CPU only machines, and falls back to a pbuffer of the default display.
+// The context is current on the constructing thread.
+class OffscreenContext
+{
+public:
+    OffscreenContext();
+    ~OffscreenContext();
+
+    std::string renderer() const;
+
+protected:
+    void release();
+    void fail(const std::string& message);
+
+private:
+    OffscreenContext(const OffscreenContext&) = delete;
+    OffscreenContext& operator=(const OffscreenContext&) = delete;
+
+    // EGL handles, kept opaque so EGL headers stay out of the project
+    void* _display;
+    void* _context;
+    void* _surface;
+};
+
+#endif // OFFSCREENCONTEXT_H
@@ -0,0 +1,120 @@
+#include "OffscreenWaterRun.h"
+
+#include <chrono>
+#include <memory>
+#include <iostream>
+
+#include <GL3/gl3w.h>
+
+#include <Camera/Camera.h>
+
+#include "FrameSequenceWriter.h"
+#include "FrameTimeStats.h"
+#include "OffscreenContext.h"
+#include "SessionRecord.h"
+#include "WaterRenderer.h"
+#include "WaterSimulation.h"
+
+using namespace std;
+using namespace cellar;
+using namespace media;
+
+
+OffscreenWaterRun::OffscreenWaterRun(const WaterOptions& options) :
+    HeadlessWaterRun(options)
+{
+}
+
+int OffscreenWaterRun::execute()
+{
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+    OffscreenContext context;
+
+    unique_ptr<SessionPlayer> player;
+    WaterOptions simulationOptions = _options;
+    if(!_options.replayFile.empty())
+    {
+        player.reset(new SessionPlayer(_options.replayFile));
+        simulationOptions = player->recordedOptions(_options);
+    }
+
+    WaterSimulation simulation(simulationOptions);
+    simulation.reset();
+
+    WaterRenderer renderer(simulation);
+    renderer.setup();
+    renderer.update();
+
+    FrameSequenceWriter writer(_options.frameWidth, _options.frameHeight,
+                               _options.offscreenDirectory);
+
+    // Same frustum as the window, widened to the frame aspect
+    float aspect = writer.width() / static_cast<float>(writer.height());
+    Camera camera;
+    camera.setLens(camera.lens().type(), -0.04f * aspect, 0.04f * aspect,
+                   -0.04f, 0.04f, 0.05f, 10.0f);
+    WaterRenderer::placeCamera(camera);
+    camera.registerObserver(renderer);
+    camera.refresh();
+
+    cout << "Offscreen run: " << writer.width() << "x" << writer.height()
+         << " frames of a " << simulationOptions.width << "x"
+         << simulationOptions.height << " lattice on " << context.renderer()
+         << ", writing to " << _options.offscreenDirectory << endl;
+
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    FrameTimeStats frameTimes("Frame times");
+    chrono::steady_clock::time_point renderStart = chrono::steady_clock::now();
+
+    SessionFrame frame;
+    for(int f=0; f < _options.frameCount; ++f)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        if(player)
+        {
+            if(!player->read(frame))
+                break;
+
+            for(size_t k=0; k < frame.keyPresses.size(); ++k)
+                simulation.keyPress(frame.keyPresses[k]);
+            simulation.replayStep(frame.disturbances);
+            camera.setTripod(Vec3f(frame.from[0], frame.from[1], frame.from[2]),
+                             Vec3f(frame.to[0], frame.to[1], frame.to[2]),
+                             Vec3f(0.0, 0.0, 1.0));
+        }
+        else
+        {
+            simulation.step();
+            WaterRenderer::orbitCamera(camera);
+        }
+
+        renderer.update();
+
+        writer.bind();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        renderer.draw();
+        writer.capture();
+
+        frameTimes.add(chrono::duration<double>(
+            chrono::steady_clock::now() - start).count());
+    }
+
+    writer.finish();
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    chrono::steady_clock::time_point endTime = chrono::steady_clock::now();
+    double renderSeconds = chrono::duration<double>(endTime - renderStart).count();
+
+    cout << "Offscreen run: " << writer.frameCount() << " frames in "
+         << renderSeconds << " s, "
+         << writer.frameCount() / renderSeconds << " frames per second, "
+         << chrono::duration<double>(endTime - startTime).count()
+         << " s with the setup" << endl;
+    frameTimes.report(cout);
+
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef OFFSCREENWATERRUN_H
+#define OFFSCREENWATERRUN_H
+
+#include "HeadlessWaterRun.h"
+
+
+// Renders a flythrough to an image sequence without a window. The camera
+// follows a recorded session when one is replayed, otherwise it turns
+// around the pool like the windowed run does.
+class OffscreenWaterRun : public HeadlessWaterRun
+{
+public:
+    OffscreenWaterRun(const WaterOptions& options);
+
+    virtual int execute();
+};
+
+#endif // OFFSCREENWATERRUN_H
@@ -0,0 +1,105 @@
+#include "ProbeWaterRun.h"
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <iostream>
+
+#include "WaterProbe.h"
+#include "WaterSimulation.h"
+
+using namespace std;
+
+
+ProbeWaterRun::ProbeWaterRun(const WaterOptions& options) :
+    HeadlessWaterRun(options),
+    _isStepping(false),
+    _probeCount(0),
+    _batchCount(0),
+    _snapshotCount(0),
+    _invalidCount(0),
+    _samplingSeconds(0.0)
+{
+}
+
+int ProbeWaterRun::execute()
+{
+    WaterSimulation simulation(_options);
+    simulation.reset();
+
+    cout << "Probe run: " << _options.probeCount << " probes per batch on a "
+         << _options.width << "x" << _options.height << " lattice, "
+         << _options.stepCount << " steps" << endl;
+
+    _isStepping = true;
+    simulation.attachSnapshotReader();
+    thread consumer(&ProbeWaterRun::consume, this, std::cref(simulation));
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(int s=0; s < _options.stepCount; ++s)
+        simulation.step();
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+
+    _isStepping = false;
+    consumer.join();
+    simulation.detachSnapshotReader();
+
+    cout << "Probe run: " << _options.stepCount / seconds << " steps/s, "
+         << _batchCount << " batches over " << _snapshotCount << " snapshots"
+         << endl;
+    cout << "Probe run: " << _probeCount / _samplingSeconds
+         << " probes/s while sampling, " << _probeCount / seconds
+         << " probes/s overall" << endl;
+
+    if(_invalidCount != 0)
+    {
+        cout << "Probe run: " << _invalidCount << " invalid samples" << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+void ProbeWaterRun::consume(const WaterSimulation& simulation)
+{
+    // Sensors spread over the whole basin, some past its border
+    vector<float> x(_options.probeCount);
+    vector<float> y(_options.probeCount);
+    unsigned int seed = 1;
+    for(int p=0; p < _options.probeCount; ++p)
+    {
+        seed = seed * 1103515245u + 12345u;
+        x[p] = (seed >> 8) / float(1 << 24) * 1.1f - 0.05f;
+        seed = seed * 1103515245u + 12345u;
+        y[p] = (seed >> 8) / float(1 << 24) * 1.1f - 0.05f;
+    }
+
+    ProbeSamples samples;
+    unsigned int lastStep = 0;
+    do
+    {
+        shared_ptr<const WaterSnapshot> snapshot = simulation.snapshot();
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        WaterProbe::sample(*snapshot, x.data(), y.data(), x.size(), samples);
+        _samplingSeconds += chrono::duration<double>(
+            chrono::steady_clock::now() - start).count();
+
+        for(int p=0; p < _options.probeCount; ++p)
+        {
+            float length = samples.normalX[p] * samples.normalX[p] +
+                           samples.normalY[p] * samples.normalY[p] +
+                           samples.normalZ[p] * samples.normalZ[p];
+            if(!(samples.depth[p] >= 0.0f) || fabs(length - 1.0f) > 1e-4f)
+                ++_invalidCount;
+        }
+
+        if(_batchCount == 0 || snapshot->stepCount != lastStep)
+            ++_snapshotCount;
+        lastStep = snapshot->stepCount;
+        _probeCount += _options.probeCount;
+        ++_batchCount;
+    }
+    while(_isStepping);
+}
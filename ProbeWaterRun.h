@@ -0,0 +1,33 @@
+#ifndef PROBEWATERRUN_H
+#define PROBEWATERRUN_H
+
+#include <atomic>
+
+#include "HeadlessWaterRun.h"
+
+class WaterSimulation;
+
+
+// Headless run where a consumer thread samples the surface at many probes
+// while the simulation steps. Reports the probe throughput and checks that
+// every batch saw a consistent snapshot.
+class ProbeWaterRun : public HeadlessWaterRun
+{
+public:
+    ProbeWaterRun(const WaterOptions& options);
+
+    virtual int execute();
+
+protected:
+    void consume(const WaterSimulation& simulation);
+
+private:
+    std::atomic<bool> _isStepping;
+    long long _probeCount;
+    int _batchCount;
+    int _snapshotCount;
+    int _invalidCount;
+    double _samplingSeconds;
+};
+
+#endif // PROBEWATERRUN_H
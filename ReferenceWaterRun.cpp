@@ -0,0 +1,333 @@
+#include "ReferenceWaterRun.h"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "ReferenceWaterSolver.h"
+#include "SparseWaterGrid.h"
+#include "TemporalWaterGrid.h"
+#include "WaterEnsemble.h"
+#include "WaterScheduler.h"
+#include "WaterSolver.h"
+#include "WaterStepper.h"
+#include "WorkerPool.h"
+
+using namespace std;
+
+
+namespace
+{
+    class SolverBackend : public ReferenceWaterRun::Backend
+    {
+    public:
+        SolverBackend(const WaterScenario& scenario, const WaterBoundaries& boundaries,
+                      int width, int height,
+                      int radius, float stretchness, float lossyness) :
+            _solver(width, height, radius, stretchness, lossyness)
+        {
+            _solver.setBoundaries(boundaries);
+            _solver.setupScenario(scenario);
+        }
+
+        virtual const char* name() const {return "explicit";}
+        virtual void advance() {_solver.step();}
+        virtual float waterHeight(int i, int j) const {return _solver.waterHeight(i, j);}
+
+    private:
+        WaterSolver _solver;
+    };
+
+    class StepperBackend : public ReferenceWaterRun::Backend
+    {
+    public:
+        StepperBackend(const WaterScenario& scenario, const WaterBoundaries& boundaries,
+                       int width, int height,
+                       int radius, float stretchness, float lossyness,
+                       const WaterStepConfig& config) :
+            _name(config.tileSize == 0 ? "row bands" : "tiles"),
+            _solver(width, height, radius, stretchness, lossyness),
+            _stepper(config)
+        {
+            _solver.setBoundaries(boundaries);
+            _stepper.setupScenario(_solver, scenario);
+        }
+
+        virtual const char* name() const {return _name;}
+        virtual void advance() {_stepper.step(_solver);}
+        virtual float waterHeight(int i, int j) const {return _solver.waterHeight(i, j);}
+
+    private:
+        const char* _name;
+        WaterSolver _solver;
+        WaterStepper _stepper;
+    };
+
+    class SchedulerBackend : public ReferenceWaterRun::Backend
+    {
+    public:
+        SchedulerBackend(const WaterScenario& scenario, const WaterBoundaries& boundaries,
+                         int width, int height,
+                         int radius, float stretchness, float lossyness) :
+            _solver(width, height, radius, stretchness, lossyness),
+            _scheduler(getWorkerPool())
+        {
+            _solver.setBoundaries(boundaries);
+            _solver.setupScenario(scenario);
+            _scheduler.add(_solver, "reference");
+        }
+
+        virtual const char* name() const {return "scheduler";}
+        virtual void advance() {_scheduler.tick();}
+        virtual float waterHeight(int i, int j) const {return _solver.waterHeight(i, j);}
+
+    private:
+        WaterSolver _solver;
+        WaterScheduler _scheduler;
+    };
+
+    class TemporalBackend : public ReferenceWaterRun::Backend
+    {
+    public:
+        TemporalBackend(const WaterScenario& scenario, int width, int height,
+                        int radius, float stretchness, float lossyness,
+                        int tileSize, int blockSteps) :
+            _grid(width, height, tileSize, blockSteps, radius, stretchness, lossyness)
+        {
+            _grid.setup(scenario);
+        }
+
+        virtual const char* name() const {return "temporal";}
+        virtual int stride() const {return _grid.blockSteps();}
+        virtual void advance() {_grid.step(_grid.blockSteps());}
+        virtual float waterHeight(int i, int j) const {return _grid.waterHeight(i, j);}
+
+    private:
+        TemporalWaterGrid _grid;
+    };
+
+    class SparseBackend : public ReferenceWaterRun::Backend
+    {
+    public:
+        SparseBackend(const WaterScenario& scenario, int width, int height,
+                      int radius, float stretchness, float lossyness, int tileSize) :
+            _grid(width, height, tileSize, radius, stretchness, lossyness)
+        {
+            _grid.setup(scenario);
+        }
+
+        virtual const char* name() const {return "sparse";}
+        virtual void advance() {_grid.step();}
+        virtual float waterHeight(int i, int j) const {return _grid.waterHeight(i, j);}
+
+    private:
+        SparseWaterGrid _grid;
+    };
+
+    class EnsembleBackend : public ReferenceWaterRun::Backend
+    {
+    public:
+        EnsembleBackend(const WaterScenario& scenario, int width, int height,
+                        int radius, float stretchness, float lossyness) :
+            _ensemble(width, height, radius, scenario)
+        {
+            EnsembleMember member;
+            member.stretchness = stretchness;
+            member.lossyness = lossyness;
+            member.water = scenario.water;
+            member.amplitudeScale = scenario.amplitudeScale;
+            _ensemble.addMember(member);
+            _ensemble.setup();
+        }
+
+        virtual const char* name() const {return "ensemble";}
+        virtual void advance() {_ensemble.step();}
+        virtual float waterHeight(int i, int j) const {return _ensemble.waterHeight(0, i, j);}
+
+    private:
+        WaterEnsemble _ensemble;
+    };
+}
+
+
+ReferenceWaterRun::Backend::~Backend()
+{
+}
+
+int ReferenceWaterRun::Backend::stride() const
+{
+    return 1;
+}
+
+
+ReferenceWaterRun::ReferenceWaterRun(const WaterOptions& options) :
+    HeadlessWaterRun(options),
+    _TILE_SIZE(32),
+    _BLOCK_STEPS(4)
+{
+}
+
+int ReferenceWaterRun::execute()
+{
+    // Odd sizes, one smaller than a tile, and the lattice of the options
+    vector<pair<int, int>> sizes;
+    sizes.push_back(make_pair(17, 23));
+    sizes.push_back(make_pair(64, 64));
+    sizes.push_back(make_pair(130, 90));
+    if(find(sizes.begin(), sizes.end(),
+            make_pair(_options.width, _options.height)) == sizes.end())
+        sizes.push_back(make_pair(_options.width, _options.height));
+
+    string resultsFile = _options.resultsFile.empty() ?
+        "reference.csv" : _options.resultsFile;
+    ofstream results(resultsFile.c_str());
+    if(!results)
+        throw runtime_error("Could not open " + resultsFile);
+    results << "backend,scenario,width,height,step,"
+               "maxDifference,rmsDifference,volumeDivergence" << endl;
+
+    WaterBoundaries boundaries = _options.initialBoundaries();
+    cout << "Reference run: " << _options.stepCount << " steps, tolerance "
+         << _options.referenceTolerance << ", " << _options.boundaries
+         << " edges" << endl;
+    if(!boundaries.isWalled())
+        cout << "Reference run: the temporal, sparse and ensemble backends "
+                "only have walls, left out" << endl;
+
+    int failures = 0;
+    vector<string> names = WaterScenario::names();
+    for(size_t n=0; n < names.size(); ++n)
+    {
+        WaterScenario scenario;
+        WaterScenario::byName(names[n], scenario);
+
+        for(size_t s=0; s < sizes.size(); ++s)
+        {
+            int width = sizes[s].first;
+            int height = sizes[s].second;
+            vector<unique_ptr<Backend>> backends =
+                createBackends(scenario, boundaries, width, height);
+            for(size_t b=0; b < backends.size(); ++b)
+            {
+                if(!compare(*backends[b], scenario, boundaries, names[n],
+                            width, height, results))
+                    ++failures;
+            }
+        }
+    }
+
+    cout << "Reference run: ";
+    if(failures == 0)
+        cout << "every backend follows the reference";
+    else
+        cout << failures << " backend runs diverge from the reference";
+    cout << ", steps written to " << resultsFile << endl;
+
+    return failures == 0 ? 0 : 1;
+}
+
+std::vector<std::unique_ptr<ReferenceWaterRun::Backend>>
+    ReferenceWaterRun::createBackends(const WaterScenario& scenario,
+                                      const WaterBoundaries& boundaries,
+                                      int width, int height) const
+{
+    const int R = _NEIGHBORS_RADIUS;
+    const float S = _STRETCHNESS;
+    const float L = _LOSSYNESS;
+    const WaterBoundaries& B = boundaries;
+
+    vector<unique_ptr<Backend>> backends;
+    backends.emplace_back(new SolverBackend(scenario, B, width, height, R, S, L));
+    backends.emplace_back(new StepperBackend(scenario, B, width, height, R, S, L,
+                                             WaterStepConfig(3, 0)));
+    backends.emplace_back(new StepperBackend(scenario, B, width, height, R, S, L,
+                                             WaterStepConfig(3, _TILE_SIZE / 2)));
+    backends.emplace_back(new SchedulerBackend(scenario, B, width, height, R, S, L));
+    if(!boundaries.isWalled())
+        return backends;
+
+    backends.emplace_back(new TemporalBackend(scenario, width, height, R, S, L,
+                                              _TILE_SIZE, _BLOCK_STEPS));
+    backends.emplace_back(new SparseBackend(scenario, width, height, R, S, L,
+                                            _TILE_SIZE));
+    backends.emplace_back(new EnsembleBackend(scenario, width, height, R, S, L));
+    return backends;
+}
+
+bool ReferenceWaterRun::compare(Backend& backend, const WaterScenario& scenario,
+                                const WaterBoundaries& boundaries,
+                                const std::string& scenarioName,
+                                int width, int height, std::ostream& results) const
+{
+    ReferenceWaterSolver reference(width, height, _NEIGHBORS_RADIUS,
+                                   _STRETCHNESS, _LOSSYNESS);
+    reference.setBoundaries(boundaries);
+    reference.setupScenario(scenario);
+
+    double initialVolume = 0.0;
+    for(int j=0; j < height; ++j)
+        for(int i=0; i < width; ++i)
+            initialVolume += max(reference.waterHeight(i, j) - reference.groundHeight(i, j), 0.0f);
+
+    float worstMax = 0.0f;
+    double worstRms = 0.0;
+    double worstVolume = 0.0;
+    int failedStep = -1;
+
+    for(int step=backend.stride(); step <= _options.stepCount; step += backend.stride())
+    {
+        backend.advance();
+        for(int k=0; k < backend.stride(); ++k)
+            reference.step();
+
+        float maxDifference = 0.0f;
+        double sumSquares = 0.0;
+        double referenceVolume = 0.0;
+        double backendVolume = 0.0;
+        for(int j=0; j < height; ++j)
+        {
+            for(int i=0; i < width; ++i)
+            {
+                float h = reference.waterHeight(i, j);
+                float hb = backend.waterHeight(i, j);
+                float g = reference.groundHeight(i, j);
+                float difference = fabs(hb - h);
+                maxDifference = max(maxDifference, difference);
+                sumSquares += difference * static_cast<double>(difference);
+                referenceVolume += max(h - g, 0.0f);
+                backendVolume += max(hb - g, 0.0f);
+            }
+        }
+
+        // Relative to the initial volume, or absolute below a volume of one
+        double rms = sqrt(sumSquares / (width * height));
+        double volume = fabs(backendVolume - referenceVolume) /
+                        max(initialVolume, 1.0);
+
+        results << backend.name() << ',' << scenarioName << ',' << width << ','
+                << height << ',' << step << ',' << maxDifference << ','
+                << rms << ',' << volume << '\n';
+
+        worstMax = max(worstMax, maxDifference);
+        worstRms = max(worstRms, rms);
+        worstVolume = max(worstVolume, volume);
+
+        if(maxDifference > _options.referenceTolerance ||
+           volume > _options.referenceTolerance)
+        {
+            failedStep = step;
+            break;
+        }
+    }
+
+    cout << "  " << backend.name() << ", " << scenarioName << ", " << width
+         << "x" << height << ": ";
+    if(failedStep >= 0)
+        cout << "diverges at step " << failedStep << ", ";
+    cout << "max " << worstMax << ", RMS " << worstRms << ", volume "
+         << worstVolume << endl;
+
+    return failedStep < 0;
+}
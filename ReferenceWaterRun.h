@@ -0,0 +1,60 @@
+#ifndef REFERENCEWATERRUN_H
+#define REFERENCEWATERRUN_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+
+#include "HeadlessWaterRun.h"
+
+class ReferenceWaterSolver;
+
+
+// Headless differential run of the optimized backends against the frozen
+// reference step. Every backend is advanced side by side with the
+// reference on every built-in scenario and a few lattice sizes, odd ones
+// and ones smaller than a tile included. The maximum and RMS differences
+// of the heights and the divergence of the volume are written for each
+// step, and a backend stops at the first step over the tolerance.
+//
+// Only backends that claim the physics of the reference are compared : the
+// separable, implicit and fixed point schemes move water differently. The
+// edges of the options apply to the reference and the backends, those with
+// only walls are left out unless every edge is a wall.
+class ReferenceWaterRun : public HeadlessWaterRun
+{
+public:
+    // Compared backends implement this
+    class Backend
+    {
+    public:
+        virtual ~Backend();
+
+        virtual const char* name() const = 0;
+
+        // Steps of each advance, compared with as many reference steps
+        virtual int stride() const;
+        virtual void advance() = 0;
+        virtual float waterHeight(int i, int j) const = 0;
+    };
+
+    ReferenceWaterRun(const WaterOptions& options);
+
+    virtual int execute();
+
+protected:
+    std::vector<std::unique_ptr<Backend>> createBackends(
+        const WaterScenario& scenario, const WaterBoundaries& boundaries,
+        int width, int height) const;
+    bool compare(Backend& backend, const WaterScenario& scenario,
+                 const WaterBoundaries& boundaries,
+                 const std::string& scenarioName, int width, int height,
+                 std::ostream& results) const;
+
+private:
+    const int _TILE_SIZE;
+    const int _BLOCK_STEPS;
+};
+
+#endif // REFERENCEWATERRUN_H
@@ -0,0 +1,242 @@
+#include "ReferenceWaterSolver.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <DataStructure/Vector.h>
+
+#include "WaterScenario.h"
+
+using namespace std;
+using namespace cellar;
+
+
+ReferenceWaterSolver::ReferenceWaterSolver(int width, int height, int neighborsRadius,
+                                           float stretchness, float lossyness) :
+    _WIDTH(width),
+    _HEIGHT(height),
+    _NEIGHBORS_RADIUS(neighborsRadius),
+    _STRETCHNESS(stretchness),
+    _LOSSYNESS(lossyness),
+    _taps(),
+    _interiorContribution(0.0f),
+    _contribution(),
+    _overNeighbor(),
+    _neighbors(),
+    _boundaries(),
+    _spongeRamp(width * height, 0.0f),
+    _restLevels(),
+    _time(0.0f),
+    _heights(),
+    _nextHeights(),
+    _ground(),
+    _velocities()
+{
+    float totalContribution = 0.0f;
+    for(int dj = -_NEIGHBORS_RADIUS; dj <= _NEIGHBORS_RADIUS; ++dj)
+    {
+        for(int di = -_NEIGHBORS_RADIUS; di <= _NEIGHBORS_RADIUS; ++di)
+        {
+            float length2 = static_cast<float>(di*di + dj*dj);
+            if(length2 == 0.0f || sqrt(length2) > _NEIGHBORS_RADIUS)
+                continue;
+
+            Tap tap;
+            tap.di = di;
+            tap.dj = dj;
+            tap.baseContribution = 1.0f / length2;
+            _taps.push_back(tap);
+            totalContribution += tap.baseContribution;
+        }
+    }
+    _interiorContribution = 1.0f / totalContribution;
+    _contribution.resize(_taps.size());
+    _overNeighbor.resize(_taps.size());
+    _neighbors.resize(_taps.size());
+}
+
+void ReferenceWaterSolver::setBoundaries(const WaterBoundaries& boundaries)
+{
+    _boundaries = boundaries;
+
+    // Quadratic ramp, zero where the layer begins and one at the edge
+    for(int j=0; j < _HEIGHT; ++j)
+    {
+        for(int i=0; i < _WIDTH; ++i)
+        {
+            int distances[WaterBoundaries::EDGE_COUNT] = {
+                i, _WIDTH - 1 - i, j, _HEIGHT - 1 - j};
+
+            float ramp = 0.0f;
+            for(int e=0; e < WaterBoundaries::EDGE_COUNT; ++e)
+            {
+                if(_boundaries.edges[e] != WaterBoundaries::EBoundary::SPONGE ||
+                   distances[e] >= _boundaries.spongeWidth)
+                    continue;
+
+                float depth = (_boundaries.spongeWidth - distances[e]) /
+                              float(_boundaries.spongeWidth);
+                ramp = max(ramp, depth * depth);
+            }
+
+            _spongeRamp[j * _WIDTH + i] = ramp;
+        }
+    }
+}
+
+void ReferenceWaterSolver::setupScenario(const WaterScenario& scenario)
+{
+    _heights.resize(_WIDTH * _HEIGHT);
+    _nextHeights.resize(_WIDTH * _HEIGHT);
+    _ground.resize(_WIDTH * _HEIGHT);
+    _velocities.resize(_WIDTH * _HEIGHT);
+
+    for(int j=0; j < _HEIGHT; ++j)
+    {
+        for(int i=0; i < _WIDTH; ++i)
+        {
+            float x = i / static_cast<float>(_WIDTH);
+            float y = j / static_cast<float>(_HEIGHT);
+            int c = j * _WIDTH + i;
+
+            _ground[c] = scenario.groundHeight(x, y);
+            _heights[c] = max(scenario.waterHeight(x, y), _ground[c]);
+            _velocities[c] = scenario.waterVelocity(x, y);
+        }
+    }
+
+    _restLevels = _heights;
+    _time = 0.0f;
+}
+
+void ReferenceWaterSolver::step()
+{
+    for(int j=0; j < _HEIGHT; ++j)
+        for(int i=0; i < _WIDTH; ++i)
+            exchange(i, j);
+
+    _heights.swap(_nextHeights);
+    _time += 1.0f;
+}
+
+void ReferenceWaterSolver::exchange(int i, int j)
+{
+    const int c = j * _WIDTH + i;
+    const int tapCount = static_cast<int>(_taps.size());
+    const bool interior =
+        _NEIGHBORS_RADIUS <= i && i < _WIDTH  - _NEIGHBORS_RADIUS &&
+        _NEIGHBORS_RADIUS <= j && j < _HEIGHT - _NEIGHBORS_RADIUS;
+
+    // Edges held at the initial level plus a wave
+    if(isInflow(i, j))
+    {
+        float wave = _boundaries.inflowAmplitude *
+                     sin(2.0f * PI * _time / _boundaries.inflowPeriod);
+        float level = max(_restLevels[c] + wave, _ground[c]);
+        _nextHeights[c] = level;
+        _velocities[c] = level - _heights[c];
+        return;
+    }
+
+    // Off bounds neighbors do not contribute, periodic ones wrap
+    float* contribution = _contribution.data();
+    int* neighbors = _neighbors.data();
+    float totalContribution = 0.0f;
+    for(int t=0; t < tapCount; ++t)
+    {
+        contribution[t] = 0.0f;
+        int ni = i + _taps[t].di;
+        int nj = j + _taps[t].dj;
+        if(_boundaries.isWrappedX())
+            ni = (ni + _WIDTH) % _WIDTH;
+        if(_boundaries.isWrappedY())
+            nj = (nj + _HEIGHT) % _HEIGHT;
+        neighbors[t] = nj * _WIDTH + ni;
+
+        if(interior)
+            contribution[t] = _taps[t].baseContribution * _interiorContribution;
+        else if(0 <= ni && ni < _WIDTH && 0 <= nj && nj < _HEIGHT)
+            contribution[t] = _taps[t].baseContribution;
+        totalContribution += contribution[t];
+    }
+    if(!interior)
+    {
+        for(int t=0; t < tapCount; ++t)
+            contribution[t] /= totalContribution;
+    }
+
+    float h = _heights[c];
+    float g = _ground[c];
+    float over = max(h - g, 0.0f);
+
+    // Water each neighbor may give, negative where no exchange is permitted
+    float* overNeighbor = _overNeighbor.data();
+    float dzMean = 0.0f;
+    float totContrib = 0.0f;
+    for(int t=0; t < tapCount; ++t)
+    {
+        overNeighbor[t] = -1.0f;
+        if(contribution[t] == 0.0f)
+            continue;
+
+        int n = neighbors[t];
+        float hn = _heights[n];
+        float gn = _ground[n];
+        float overN = max(hn - gn, 0.0f);
+
+        float dz = hn - h;
+        dzMean += min(max(dz, -over), overN) * contribution[t];
+
+        bool isExchangePermitted = (dz != 0.0f) &&
+                                  !(dz < 0.0f && h <= g) &&
+                                  !(dz > 0.0f && hn <= gn);
+        if(isExchangePermitted)
+        {
+            overNeighbor[t] = overN;
+            totContrib += contribution[t];
+        }
+    }
+
+    if(totContrib == 0.0f)
+    {
+        _nextHeights[c] = h;
+        _velocities[c] = 0.0f;
+        return;
+    }
+
+    // Sponges damp the velocities more toward the edge
+    float velocity = _velocities[c];
+    float lossyness = _LOSSYNESS + _spongeRamp[c] * _boundaries.spongeDamping;
+    float acc = (dzMean * _STRETCHNESS) - (velocity * lossyness);
+    float maxWaterMoved = max(velocity + acc, -over);
+
+    float waterMoved = 0.0f;
+    for(int t=0; t < tapCount; ++t)
+    {
+        if(overNeighbor[t] < 0.0f)
+            continue;
+
+        waterMoved += min(maxWaterMoved * contribution[t] / totContrib,
+                          overNeighbor[t]);
+    }
+
+    _nextHeights[c] = max(h + waterMoved, g);
+    _velocities[c] = waterMoved;
+
+    // And let go of the water the waves bring in
+    if(_spongeRamp[c] > 0.0f)
+    {
+        float relax = min(_spongeRamp[c] * _boundaries.spongeRelaxation, 1.0f);
+        _nextHeights[c] = max(_nextHeights[c] - (_nextHeights[c] - _restLevels[c]) * relax, g);
+    }
+}
+
+bool ReferenceWaterSolver::isInflow(int i, int j) const
+{
+    typedef WaterBoundaries::EBoundary EBoundary;
+    const EBoundary* edges = _boundaries.edges;
+    return (i == 0           && edges[WaterBoundaries::LEFT]   == EBoundary::INFLOW) ||
+           (i == _WIDTH - 1  && edges[WaterBoundaries::RIGHT]  == EBoundary::INFLOW) ||
+           (j == 0           && edges[WaterBoundaries::BOTTOM] == EBoundary::INFLOW) ||
+           (j == _HEIGHT - 1 && edges[WaterBoundaries::TOP]    == EBoundary::INFLOW);
+}
@@ -0,0 +1,93 @@
+#ifndef REFERENCEWATERSOLVER_H
+#define REFERENCEWATERSOLVER_H
+
+#include <vector>
+
+#include "WaterBoundaries.h"
+
+class WaterScenario;
+
+
+// Frozen copy of the scalar lattice step, the physics every optimized
+// backend must reproduce. Nominal steps, inverse square weights, one cell
+// at a time in the plainest loops. Edges are walls unless set otherwise.
+//
+// Do not optimize nor refactor : the point of this class is to stay the
+// same while WaterSolver and the other backends change. Only fix it along
+// with a deliberate change of the physics.
+class ReferenceWaterSolver
+{
+public:
+    ReferenceWaterSolver(int width, int height, int neighborsRadius,
+                         float stretchness, float lossyness);
+
+    // Sponges and inflows go back to the levels of the scenario
+    void setBoundaries(const WaterBoundaries& boundaries);
+    void setupScenario(const WaterScenario& scenario);
+    void step();
+
+    int width() const;
+    int height() const;
+
+    float waterHeight(int i, int j) const;
+    float groundHeight(int i, int j) const;
+
+protected:
+    void exchange(int i, int j);
+    bool isInflow(int i, int j) const;
+
+private:
+    struct Tap
+    {
+        int di;
+        int dj;
+        float baseContribution;
+    };
+
+    const int _WIDTH;
+    const int _HEIGHT;
+    const int _NEIGHBORS_RADIUS;
+    const float _STRETCHNESS;
+    const float _LOSSYNESS;
+
+    std::vector<Tap> _taps;
+    float _interiorContribution;
+    std::vector<float> _contribution;
+    std::vector<float> _overNeighbor;
+    std::vector<int> _neighbors;
+
+    WaterBoundaries _boundaries;
+    std::vector<float> _spongeRamp;
+    std::vector<float> _restLevels;
+    float _time;
+
+    std::vector<float> _heights;
+    std::vector<float> _nextHeights;
+    std::vector<float> _ground;
+    std::vector<float> _velocities;
+};
+
+
+
+// IMPLEMENTATION //
+inline int ReferenceWaterSolver::width() const
+{
+    return _WIDTH;
+}
+
+inline int ReferenceWaterSolver::height() const
+{
+    return _HEIGHT;
+}
+
+inline float ReferenceWaterSolver::waterHeight(int i, int j) const
+{
+    return _heights[j * _WIDTH + i];
+}
+
+inline float ReferenceWaterSolver::groundHeight(int i, int j) const
+{
+    return _ground[j * _WIDTH + i];
+}
+
+#endif // REFERENCEWATERSOLVER_H
@@ -0,0 +1,69 @@
+#include "ReplayWaterRun.h"
+
+#include <chrono>
+#include <iostream>
+
+#include "FrameTimeStats.h"
+#include "SessionRecord.h"
+#include "WaterSimulation.h"
+
+using namespace std;
+
+
+ReplayWaterRun::ReplayWaterRun(const WaterOptions& options) :
+    HeadlessWaterRun(options)
+{
+}
+
+int ReplayWaterRun::execute()
+{
+    SessionPlayer player(_options.replayFile);
+    WaterOptions recorded = player.recordedOptions(_options);
+
+    WaterSimulation simulation(recorded);
+    simulation.reset();
+
+    cout << "Replay run: " << _options.replayFile << " on a "
+         << recorded.width << "x" << recorded.height << " lattice, "
+         << recorded.scenario << " scenario" << endl;
+
+    FrameTimeStats recordedTimes("Recorded frame times");
+    FrameTimeStats stepTimes("Step times");
+    int firstMismatch = -1;
+    int mismatchCount = 0;
+
+    SessionFrame frame;
+    while(player.read(frame))
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        for(size_t k=0; k < frame.keyPresses.size(); ++k)
+            simulation.keyPress(frame.keyPresses[k]);
+        simulation.replayStep(frame.disturbances);
+
+        stepTimes.add(chrono::duration<double>(
+            chrono::steady_clock::now() - start).count());
+        recordedTimes.add(frame.elapsedTime);
+
+        if(simulation.checksum() != frame.checksum)
+        {
+            if(firstMismatch < 0)
+                firstMismatch = player.frameCount() - 1;
+            ++mismatchCount;
+        }
+    }
+
+    cout << "Replay run: " << player.frameCount() << " frames" << endl;
+    recordedTimes.report(cout);
+    stepTimes.report(cout);
+
+    if(mismatchCount != 0)
+    {
+        cout << "Replay run: " << mismatchCount << " frames differ from the "
+             << "recording, first at frame " << firstMismatch << endl;
+        return 1;
+    }
+
+    cout << "Replay run: surface matches the recording" << endl;
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef REPLAYWATERRUN_H
+#define REPLAYWATERRUN_H
+
+#include "HeadlessWaterRun.h"
+
+
+// Headless replay of a recorded session. Steps the simulation with the
+// recorded keys and disturbances, checks the surface against the recorded
+// checksums and reports the step times.
+class ReplayWaterRun : public HeadlessWaterRun
+{
+public:
+    ReplayWaterRun(const WaterOptions& options);
+
+    virtual int execute();
+};
+
+#endif // REPLAYWATERRUN_H
@@ -0,0 +1,93 @@
+#include "SeparableWaterRun.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "WaterSolver.h"
+
+using namespace std;
+
+
+SeparableWaterRun::SeparableWaterRun(const WaterOptions& options) :
+    HeadlessWaterRun(options)
+{
+}
+
+int SeparableWaterRun::execute()
+{
+    WaterSolver solver(_options.width, _options.height, _options.separableRadius,
+                       _STRETCHNESS, _LOSSYNESS);
+    solver.setStencil(WaterSolver::EStencil::SEPARABLE);
+    solver.setupScenario(_options.initialScenario());
+    solver.setBoundaries(_options.initialBoundaries());
+    double initialVolume = waterVolume(solver);
+
+    cout << "Separable run: " << _options.width << "x" << _options.height
+         << " lattice, radius " << _options.separableRadius << ", "
+         << solver.stencil().size() << " taps, "
+         << _options.stepCount << " steps" << endl;
+
+    double seconds = run(solver);
+    double drift = (waterVolume(solver) - initialVolume) / initialVolume;
+    cout << "Separable run: " << seconds * 1000.0 / _options.stepCount
+         << " ms per step, volume drift " << drift * 100.0 << "%" << endl;
+
+    if(!_options.verify)
+        return 0;
+
+    WaterSolver taps(_options.width, _options.height, _options.separableRadius,
+                     _STRETCHNESS, _LOSSYNESS);
+    taps.setStencil(WaterSolver::EStencil::SEPARABLE_TAPS);
+    taps.setupScenario(_options.initialScenario());
+    taps.setBoundaries(_options.initialBoundaries());
+    compare("Same weights tap by tap", taps, solver, run(taps), seconds);
+
+    WaterSolver inverseSquare(_options.width, _options.height,
+                              _options.separableRadius, _STRETCHNESS, _LOSSYNESS);
+    inverseSquare.setupScenario(_options.initialScenario());
+    inverseSquare.setBoundaries(_options.initialBoundaries());
+    compare("Inverse square weights", inverseSquare, solver,
+            run(inverseSquare), seconds);
+
+    return 0;
+}
+
+double SeparableWaterRun::run(WaterSolver& solver) const
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(int s=0; s < _options.stepCount; ++s)
+        solver.step();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void SeparableWaterRun::compare(const char* name, const WaterSolver& reference,
+                                const WaterSolver& separable, double seconds,
+                                double separableSeconds) const
+{
+    double sumSquares = 0.0;
+    float maxDifference = 0.0f;
+    const FieldArray& heights = reference.waterHeights();
+    for(size_t c=0; c < heights.size(); ++c)
+    {
+        float difference = fabs(heights[c] - separable.waterHeights()[c]);
+        sumSquares += difference * static_cast<double>(difference);
+        maxDifference = max(maxDifference, difference);
+    }
+
+    cout << name << ": " << seconds * 1000.0 / _options.stepCount
+         << " ms per step, separable speedup " << seconds / separableSeconds
+         << "x, RMS difference " << sqrt(sumSquares / heights.size())
+         << ", max difference " << maxDifference << endl;
+}
+
+double SeparableWaterRun::waterVolume(const WaterSolver& solver) const
+{
+    double volume = 0.0;
+    const FieldArray& heights = solver.waterHeights();
+    const FieldArray& ground = solver.groundHeights();
+    for(size_t c=0; c < heights.size(); ++c)
+        volume += max(heights[c] - ground[c], 0.0f);
+    return volume;
+}
@@ -0,0 +1,28 @@
+#ifndef SEPARABLEWATERRUN_H
+#define SEPARABLEWATERRUN_H
+
+#include "HeadlessWaterRun.h"
+
+class WaterSolver;
+
+
+// Headless run of the separable stencil over a wide radius. Verification
+// steps the same weights tap by tap, which the running sums must match up
+// to rounding, and the inverse square weights of the same radius, which
+// spread as far but do not have the same shape.
+class SeparableWaterRun : public HeadlessWaterRun
+{
+public:
+    SeparableWaterRun(const WaterOptions& options);
+
+    virtual int execute();
+
+protected:
+    double run(WaterSolver& solver) const;
+    void compare(const char* name, const WaterSolver& reference,
+                 const WaterSolver& separable, double seconds,
+                 double separableSeconds) const;
+    double waterVolume(const WaterSolver& solver) const;
+};
+
+#endif // SEPARABLEWATERRUN_H
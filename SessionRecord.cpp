@@ -0,0 +1,210 @@
+#include "SessionRecord.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "TiledTerrain.h"
+
+using namespace std;
+
+
+namespace
+{
+    const char MAGIC[4] = {'W', 'S', 'R', 'C'};
+    const unsigned int VERSION = 2;
+
+    template<typename T>
+    void put(ostream& out, const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    bool get(istream& in, T& value)
+    {
+        return static_cast<bool>(
+            in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+}
+
+
+SessionFrame::SessionFrame() :
+    elapsedTime(0.0f),
+    movements(0),
+    isTurning(false),
+    mouseX(0),
+    mouseY(0),
+    checksum(0),
+    keyPresses(),
+    disturbances()
+{
+    for(int c=0; c < 3; ++c)
+        from[c] = to[c] = 0.0f;
+}
+
+
+SessionRecorder::SessionRecorder(const std::string& fileName,
+                                 const WaterOptions& options) :
+    _file(fileName.c_str(), ios::binary),
+    _frameCount(0)
+{
+    if(!_file)
+        throw runtime_error("Could not create session file " + fileName);
+
+    _file.write(MAGIC, sizeof(MAGIC));
+    put(_file, VERSION);
+    put(_file, options.width);
+    put(_file, options.height);
+    put(_file, static_cast<unsigned char>(options.scenario.size()));
+    _file.write(options.scenario.data(), options.scenario.size());
+    put(_file, static_cast<unsigned short>(options.terrainFile.size()));
+    _file.write(options.terrainFile.data(), options.terrainFile.size());
+    put(_file, static_cast<unsigned char>(options.adaptiveTimestep));
+    put(_file, static_cast<unsigned char>(options.boundaries.size()));
+    _file.write(options.boundaries.data(), options.boundaries.size());
+}
+
+void SessionRecorder::write(const SessionFrame& frame)
+{
+    put(_file, frame.elapsedTime);
+    put(_file, frame.movements);
+    put(_file, static_cast<unsigned char>(frame.isTurning));
+    put(_file, static_cast<short>(frame.mouseX));
+    put(_file, static_cast<short>(frame.mouseY));
+    _file.write(reinterpret_cast<const char*>(frame.from), sizeof(frame.from));
+    _file.write(reinterpret_cast<const char*>(frame.to), sizeof(frame.to));
+    put(_file, frame.checksum);
+
+    put(_file, static_cast<unsigned char>(frame.keyPresses.size()));
+    _file.write(frame.keyPresses.data(), frame.keyPresses.size());
+
+    put(_file, static_cast<unsigned short>(frame.disturbances.size()));
+    for(size_t d=0; d < frame.disturbances.size(); ++d)
+    {
+        const WaterDisturbance& disturbance = frame.disturbances[d];
+        put(_file, static_cast<unsigned char>(disturbance.type));
+        put(_file, disturbance.x);
+        put(_file, disturbance.y);
+        put(_file, disturbance.radius);
+        put(_file, disturbance.amount);
+        put(_file, disturbance.duration);
+        put(_file, disturbance.seed);
+    }
+
+    if(!_file)
+        throw runtime_error("Could not write session frame");
+
+    ++_frameCount;
+}
+
+
+SessionPlayer::SessionPlayer(const std::string& fileName) :
+    _fileName(fileName),
+    _file(fileName.c_str(), ios::binary),
+    _width(0),
+    _height(0),
+    _scenario(),
+    _terrainFile(),
+    _adaptiveTimestep(false),
+    _boundaries(),
+    _frameCount(0)
+{
+    char magic[sizeof(MAGIC)];
+    unsigned int version = 0;
+    if(!_file.read(magic, sizeof(magic)) ||
+       memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+       !get(_file, version))
+        throw runtime_error(fileName + " is not a session file");
+    if(version != VERSION)
+        throw runtime_error(fileName + " was recorded by another version");
+
+    unsigned char scenarioLength = 0;
+    unsigned short terrainLength = 0;
+    unsigned char adaptiveTimestep = 0;
+    unsigned char boundariesLength = 0;
+    bool ok = get(_file, _width) && get(_file, _height) &&
+              get(_file, scenarioLength);
+    _scenario.resize(scenarioLength);
+    ok = ok && _file.read(&_scenario[0], scenarioLength) &&
+         get(_file, terrainLength);
+    _terrainFile.resize(terrainLength);
+    ok = ok && _file.read(&_terrainFile[0], terrainLength) &&
+         get(_file, adaptiveTimestep) &&
+         get(_file, boundariesLength);
+    _boundaries.resize(boundariesLength);
+    ok = ok && _file.read(&_boundaries[0], boundariesLength);
+
+    if(!ok)
+        throw runtime_error(fileName + " is truncated");
+    _adaptiveTimestep = adaptiveTimestep != 0;
+}
+
+WaterOptions SessionPlayer::recordedOptions(const WaterOptions& options) const
+{
+    WaterOptions recorded = options;
+    recorded.width = _width;
+    recorded.height = _height;
+    recorded.scenario = _scenario;
+    if(recorded.terrainFile != _terrainFile)
+        recorded.terrain.reset();
+    recorded.terrainFile = _terrainFile;
+    recorded.adaptiveTimestep = _adaptiveTimestep;
+    recorded.boundaries = _boundaries;
+
+    int width = 0, height = 0;
+    if(!_terrainFile.empty() &&
+       (!TiledTerrain::readSize(_terrainFile, width, height) ||
+        width != _width || height != _height))
+        throw runtime_error(_terrainFile + " is missing or no longer matches " + _fileName);
+
+    return recorded;
+}
+
+bool SessionPlayer::read(SessionFrame& frame)
+{
+    unsigned char isTurning = 0;
+    short mouseX = 0, mouseY = 0;
+    if(!get(_file, frame.elapsedTime))
+        return false;
+
+    unsigned char keyCount = 0;
+    unsigned short disturbanceCount = 0;
+    bool ok = get(_file, frame.movements) &&
+              get(_file, isTurning) &&
+              get(_file, mouseX) &&
+              get(_file, mouseY) &&
+              _file.read(reinterpret_cast<char*>(frame.from), sizeof(frame.from)) &&
+              _file.read(reinterpret_cast<char*>(frame.to), sizeof(frame.to)) &&
+              get(_file, frame.checksum) &&
+              get(_file, keyCount);
+
+    frame.isTurning = isTurning != 0;
+    frame.mouseX = mouseX;
+    frame.mouseY = mouseY;
+
+    frame.keyPresses.resize(keyCount);
+    ok = ok && _file.read(&frame.keyPresses[0], keyCount) &&
+         get(_file, disturbanceCount);
+
+    frame.disturbances.resize(disturbanceCount);
+    for(int d=0; ok && d < disturbanceCount; ++d)
+    {
+        WaterDisturbance& disturbance = frame.disturbances[d];
+        unsigned char type = 0;
+        ok = get(_file, type) &&
+             get(_file, disturbance.x) &&
+             get(_file, disturbance.y) &&
+             get(_file, disturbance.radius) &&
+             get(_file, disturbance.amount) &&
+             get(_file, disturbance.duration) &&
+             get(_file, disturbance.seed);
+        disturbance.type = static_cast<WaterDisturbance::EType>(type);
+    }
+
+    if(!ok)
+        throw runtime_error(_fileName + " is truncated after frame " +
+                            to_string(_frameCount));
+
+    ++_frameCount;
+    return true;
+}
@@ -0,0 +1,92 @@
+#ifndef SESSIONRECORD_H
+#define SESSIONRECORD_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "DisturbanceQueue.h"
+#include "WaterOptions.h"
+
+
+// Everything that drives one frame of an interactive session
+struct SessionFrame
+{
+    SessionFrame();
+
+    enum EMovement {FORWARD = 1, BACKWARD = 2, LEFT = 4, RIGHT = 8};
+
+    float elapsedTime;
+    unsigned char movements;
+    bool isTurning;
+    int mouseX;
+    int mouseY;
+
+    // Camera tripod after the frame, up is always +z
+    float from[3];
+    float to[3];
+
+    // Surface checksum after the step
+    unsigned int checksum;
+
+    std::string keyPresses;
+    std::vector<WaterDisturbance> disturbances;
+};
+
+
+// Binary session file : a header holding the lattice, the scenario, the
+// terrain file, the timestep mode and the boundaries, then one record per
+// frame. Fields are written in host byte
+// order.
+class SessionRecorder
+{
+public:
+    SessionRecorder(const std::string& fileName, const WaterOptions& options);
+
+    void write(const SessionFrame& frame);
+    int frameCount() const;
+
+private:
+    std::ofstream _file;
+    int _frameCount;
+};
+
+
+class SessionPlayer
+{
+public:
+    SessionPlayer(const std::string& fileName);
+
+    // Lattice and scenario of the recorded session over the given options.
+    // Throws when the terrain file no longer has the recorded size.
+    WaterOptions recordedOptions(const WaterOptions& options) const;
+
+    bool read(SessionFrame& frame);
+    int frameCount() const;
+
+private:
+    std::string _fileName;
+    std::ifstream _file;
+    int _width;
+    int _height;
+    std::string _scenario;
+    std::string _terrainFile;
+    bool _adaptiveTimestep;
+    std::string _boundaries;
+    int _frameCount;
+};
+
+
+
+// IMPLEMENTATION //
+inline int SessionRecorder::frameCount() const
+{
+    return _frameCount;
+}
+
+inline int SessionPlayer::frameCount() const
+{
+    return _frameCount;
+}
+
+#endif // SESSIONRECORD_H
@@ -0,0 +1,66 @@
+#ifndef SHAREDHEIGHTFIELD_H
+#define SHAREDHEIGHTFIELD_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+// Layout of the shared memory segment where the simulation publishes its
+// surface. The header is followed by the ground heights and by two slots
+// holding the water heights of alternate frames. The ground is written when
+// the segment is created and rewritten in place where the terrain is
+// edited.
+//
+// Each slot is guarded by a sequence that is odd while the slot is written.
+// A reader picks the slot of the latest frame, reads the heights in place
+// and checks that the sequence did not move meanwhile. The writer never
+// waits for readers.
+//
+// The ground revision guards the ground the same way, it is odd while an
+// edit is written and moves by two per edit. A reader loads it with acquire
+// ordering, gives up on an odd value, reads the ground, then loads it again
+// after an acquire fence. The ground it read is whole only if both loads
+// gave the same value.
+namespace SharedHeightField
+{
+    const char MAGIC[8] = {'W', 'S', 'H', 'E', 'I', 'G', 'H', 'T'};
+    const uint32_t VERSION = 3;
+    const int SLOT_COUNT = 2;
+    const size_t CACHE_LINE = 64;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        int32_t width;
+        int32_t height;
+        int32_t slotCount;
+        uint64_t groundOffset;
+        uint64_t slotOffset;
+        uint64_t slotStride;
+
+        // Zero until the first frame is published
+        std::atomic<uint64_t> latestFrame;
+        std::atomic<uint64_t> groundRevision;
+        std::atomic<int32_t> writerPid;
+    };
+
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence;
+        uint64_t frame;
+    };
+
+    inline size_t alignUp(size_t size)
+    {
+        return (size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    }
+
+    inline size_t slotHeightsOffset()
+    {
+        return alignUp(sizeof(Slot));
+    }
+}
+
+#endif // SHAREDHEIGHTFIELD_H
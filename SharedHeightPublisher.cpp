@@ -0,0 +1,130 @@
+#include "SharedHeightPublisher.h"
+
+#include <new>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "SharedHeightField.h"
+
+using namespace std;
+using namespace SharedHeightField;
+
+
+SharedHeightPublisher::SharedHeightPublisher(const std::string& name,
+                                             int width, int height,
+                                             const FieldArray& groundHeights) :
+    _name(name),
+    _width(width),
+    _height(height),
+    _segmentSize(0),
+    _segment(nullptr),
+    _frame(0)
+{
+    size_t fieldSize = alignUp(sizeof(float) * width * height);
+    size_t slotStride = slotHeightsOffset() + fieldSize;
+    _segmentSize = alignUp(sizeof(Header)) + fieldSize + SLOT_COUNT * slotStride;
+
+    // A segment left by a crashed writer is replaced
+    shm_unlink(_name.c_str());
+    int fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0)
+        throw runtime_error("Could not create shared memory segment " + _name);
+
+    if(ftruncate(fd, _segmentSize) != 0)
+    {
+        close(fd);
+        shm_unlink(_name.c_str());
+        throw runtime_error("Could not size shared memory segment " + _name);
+    }
+
+    void* address = mmap(nullptr, _segmentSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    close(fd);
+    if(address == MAP_FAILED)
+    {
+        shm_unlink(_name.c_str());
+        throw runtime_error("Could not map shared memory segment " + _name);
+    }
+
+    _segment = static_cast<char*>(address);
+
+    Header* header = new (_segment) Header();
+    header->version = VERSION;
+    header->width = width;
+    header->height = height;
+    header->slotCount = SLOT_COUNT;
+    header->groundOffset = alignUp(sizeof(Header));
+    header->slotOffset = header->groundOffset + fieldSize;
+    header->slotStride = slotStride;
+    header->latestFrame.store(0, memory_order_relaxed);
+    header->groundRevision.store(0, memory_order_relaxed);
+    header->writerPid.store(getpid(), memory_order_relaxed);
+
+    memcpy(_segment + header->groundOffset, groundHeights.data(),
+           sizeof(float) * width * height);
+
+    for(int s=0; s < SLOT_COUNT; ++s)
+    {
+        Slot* slot = new (_segment + header->slotOffset + s * slotStride) Slot();
+        slot->sequence.store(0, memory_order_relaxed);
+        slot->frame = 0;
+    }
+
+    // Readers check the magic last
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, MAGIC, sizeof(MAGIC));
+}
+
+SharedHeightPublisher::~SharedHeightPublisher()
+{
+    Header* header = reinterpret_cast<Header*>(_segment);
+    header->writerPid.store(0, memory_order_release);
+
+    munmap(_segment, _segmentSize);
+    shm_unlink(_name.c_str());
+}
+
+void SharedHeightPublisher::publish(const FieldArray& waterHeights)
+{
+    Header* header = reinterpret_cast<Header*>(_segment);
+    uint64_t frame = ++_frame;
+
+    char* base = _segment + header->slotOffset + (frame % SLOT_COUNT) * header->slotStride;
+    Slot* slot = reinterpret_cast<Slot*>(base);
+
+    uint64_t sequence = slot->sequence.load(memory_order_relaxed);
+    slot->sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->frame = frame;
+    memcpy(base + slotHeightsOffset(), waterHeights.data(),
+           sizeof(float) * _width * _height);
+
+    slot->sequence.store(sequence + 2, memory_order_release);
+    header->latestFrame.store(frame, memory_order_release);
+}
+
+void SharedHeightPublisher::publishGround(const FieldArray& groundHeights,
+                                          const LatticeRegion& region)
+{
+    Header* header = reinterpret_cast<Header*>(_segment);
+    float* ground = reinterpret_cast<float*>(_segment + header->groundOffset);
+
+    // Odd while the edit is written, as the slots
+    uint64_t revision = header->groundRevision.load(memory_order_relaxed);
+    header->groundRevision.store(revision + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    int count = region.i1 - region.i0;
+    for(int j=region.j0; j < region.j1; ++j)
+    {
+        int c = j * _width + region.i0;
+        memcpy(ground + c, groundHeights.data() + c, sizeof(float) * count);
+    }
+
+    header->groundRevision.store(revision + 2, memory_order_release);
+}
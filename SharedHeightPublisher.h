@@ -0,0 +1,44 @@
+#ifndef SHAREDHEIGHTPUBLISHER_H
+#define SHAREDHEIGHTPUBLISHER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "FieldAllocator.h"
+#include "WaterSolver.h"
+
+
+// Writer side of the shared height field. Creates the named segment, owns
+// it for its lifetime and publishes one frame per completed step.
+class SharedHeightPublisher
+{
+public:
+    SharedHeightPublisher(const std::string& name, int width, int height,
+                          const FieldArray& groundHeights);
+    ~SharedHeightPublisher();
+
+    void publish(const FieldArray& waterHeights);
+
+    // Rewrites the rows of an edited region of the ground
+    void publishGround(const FieldArray& groundHeights, const LatticeRegion& region);
+    uint64_t frame() const;
+
+private:
+    std::string _name;
+    int _width;
+    int _height;
+    size_t _segmentSize;
+    char* _segment;
+    uint64_t _frame;
+};
+
+
+
+// IMPLEMENTATION //
+inline uint64_t SharedHeightPublisher::frame() const
+{
+    return _frame;
+}
+
+#endif // SHAREDHEIGHTPUBLISHER_H
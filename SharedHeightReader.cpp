@@ -0,0 +1,175 @@
+#include "SharedHeightReader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "SharedHeightField.h"
+
+using namespace std;
+using namespace SharedHeightField;
+
+
+namespace
+{
+    const Header& headerOf(const char* segment)
+    {
+        return *reinterpret_cast<const Header*>(segment);
+    }
+
+    const Slot& slotOf(const char* segment, int slot)
+    {
+        const Header& header = headerOf(segment);
+        return *reinterpret_cast<const Slot*>(
+            segment + header.slotOffset + slot * header.slotStride);
+    }
+}
+
+
+SharedHeightReader::SharedHeightReader(const std::string& name) :
+    _name(name),
+    _segmentSize(0),
+    _segment(nullptr)
+{
+    int fd = shm_open(_name.c_str(), O_RDONLY, 0);
+    if(fd < 0)
+        throw runtime_error("No height field published as " + _name);
+
+    struct stat status;
+    if(fstat(fd, &status) != 0 ||
+       static_cast<size_t>(status.st_size) < alignUp(sizeof(Header)))
+    {
+        close(fd);
+        throw runtime_error("Height field " + _name + " is not ready");
+    }
+
+    _segmentSize = status.st_size;
+    void* address = mmap(nullptr, _segmentSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(address == MAP_FAILED)
+        throw runtime_error("Could not map height field " + _name);
+
+    _segment = static_cast<const char*>(address);
+
+    const Header& header = headerOf(_segment);
+    if(memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+       header.version != VERSION)
+    {
+        munmap(const_cast<char*>(_segment), _segmentSize);
+        throw runtime_error("Height field " + _name + " has an unknown layout");
+    }
+    atomic_thread_fence(memory_order_acquire);
+}
+
+SharedHeightReader::~SharedHeightReader()
+{
+    munmap(const_cast<char*>(_segment), _segmentSize);
+}
+
+int SharedHeightReader::width() const
+{
+    return headerOf(_segment).width;
+}
+
+int SharedHeightReader::height() const
+{
+    return headerOf(_segment).height;
+}
+
+const float* SharedHeightReader::groundHeights() const
+{
+    return reinterpret_cast<const float*>(_segment + headerOf(_segment).groundOffset);
+}
+
+uint64_t SharedHeightReader::groundRevision() const
+{
+    return headerOf(_segment).groundRevision.load(memory_order_acquire);
+}
+
+uint64_t SharedHeightReader::latestFrame() const
+{
+    return headerOf(_segment).latestFrame.load(memory_order_acquire);
+}
+
+bool SharedHeightReader::isWriterAlive() const
+{
+    int pid = headerOf(_segment).writerPid.load(memory_order_acquire);
+    return pid != 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+bool SharedHeightReader::acquire(Snapshot& snapshot) const
+{
+    uint64_t frame = latestFrame();
+    if(frame == 0)
+        return false;
+
+    snapshot.slot = static_cast<int>(frame % SLOT_COUNT);
+    const Slot& slot = slotOf(_segment, snapshot.slot);
+
+    snapshot.sequence = slot.sequence.load(memory_order_acquire);
+    if(snapshot.sequence & 1)
+        return false;
+
+    snapshot.frame = slot.frame;
+    snapshot.waterHeights = reinterpret_cast<const float*>(
+        reinterpret_cast<const char*>(&slot) + slotHeightsOffset());
+    return true;
+}
+
+bool SharedHeightReader::validate(const Snapshot& snapshot) const
+{
+    atomic_thread_fence(memory_order_acquire);
+    const Slot& slot = slotOf(_segment, snapshot.slot);
+    return slot.sequence.load(memory_order_relaxed) == snapshot.sequence;
+}
+
+bool SharedHeightReader::copyLatest(float* waterHeights, uint64_t& frame,
+                                    int maxAttempts) const
+{
+    size_t size = sizeof(float) * width() * height();
+    for(int a=0; a < maxAttempts; ++a)
+    {
+        Snapshot snapshot;
+        if(!acquire(snapshot))
+            continue;
+
+        memcpy(waterHeights, snapshot.waterHeights, size);
+        if(validate(snapshot))
+        {
+            frame = snapshot.frame;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool SharedHeightReader::copyGround(float* groundHeights, uint64_t& revision,
+                                    int maxAttempts) const
+{
+    const Header& header = headerOf(_segment);
+    size_t size = sizeof(float) * width() * height();
+    for(int a=0; a < maxAttempts; ++a)
+    {
+        uint64_t before = header.groundRevision.load(memory_order_acquire);
+        if(before & 1)
+            continue;
+
+        memcpy(groundHeights, _segment + header.groundOffset, size);
+
+        atomic_thread_fence(memory_order_acquire);
+        if(header.groundRevision.load(memory_order_relaxed) == before)
+        {
+            revision = before;
+            return true;
+        }
+    }
+
+    return false;
+}
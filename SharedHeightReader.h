@@ -0,0 +1,54 @@
+#ifndef SHAREDHEIGHTREADER_H
+#define SHAREDHEIGHTREADER_H
+
+#include <string>
+#include <cstdint>
+
+
+// Reader side of the shared height field, for external processes. Heights
+// are read in place : acquire() points at the latest frame and validate()
+// tells whether the writer overwrote it while it was being used. The writer
+// is never blocked, a reader slower than two steps simply retries.
+class SharedHeightReader
+{
+public:
+    struct Snapshot
+    {
+        uint64_t frame;
+        const float* waterHeights;
+
+        uint64_t sequence;
+        int slot;
+    };
+
+    SharedHeightReader(const std::string& name);
+    ~SharedHeightReader();
+
+    int width() const;
+    int height() const;
+    const float* groundHeights() const;
+
+    // Odd while an edit of the ground is written, moves by two per edit.
+    // groundHeights() may show an edit in progress, copyGround() does not.
+    uint64_t groundRevision() const;
+
+    uint64_t latestFrame() const;
+    bool isWriterAlive() const;
+
+    // False when nothing is published yet or the slot is being written
+    bool acquire(Snapshot& snapshot) const;
+    bool validate(const Snapshot& snapshot) const;
+
+    // Copies the latest consistent frame, retrying on overwrites
+    bool copyLatest(float* waterHeights, uint64_t& frame, int maxAttempts = 16) const;
+
+    // Copies the whole ground and the revision it matches, retrying on edits
+    bool copyGround(float* groundHeights, uint64_t& revision, int maxAttempts = 16) const;
+
+private:
+    std::string _name;
+    size_t _segmentSize;
+    const char* _segment;
+};
+
+#endif // SHAREDHEIGHTREADER_H
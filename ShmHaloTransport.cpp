@@ -0,0 +1,164 @@
+#include "ShmHaloTransport.h"
+
+#include <new>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+
+namespace
+{
+    const size_t CACHE_LINE = 64;
+
+    size_t alignUp(size_t size)
+    {
+        return (size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    }
+
+    void pause(int& spins)
+    {
+        if(++spins > 1000)
+            sched_yield();
+    }
+}
+
+
+ShmHaloTransport::ShmHaloTransport(const std::string& name,
+                                   int rankCount, int capacity) :
+    _name(name),
+    _rank(0),
+    _rankCount(rankCount),
+    _capacity(capacity),
+    _mailboxStride(alignUp(sizeof(Mailbox)) + alignUp(capacity * sizeof(float))),
+    _segmentSize(alignUp(sizeof(Header)) +
+                 _mailboxStride * rankCount * rankCount * 2),
+    _ownerPid(getpid()),
+    _segment(nullptr)
+{
+    int fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(fd < 0)
+        throw runtime_error("Could not create shared memory segment " + _name);
+
+    if(ftruncate(fd, _segmentSize) != 0)
+    {
+        close(fd);
+        shm_unlink(_name.c_str());
+        throw runtime_error("Could not size shared memory segment " + _name);
+    }
+
+    void* address = mmap(nullptr, _segmentSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    close(fd);
+    if(address == MAP_FAILED)
+    {
+        shm_unlink(_name.c_str());
+        throw runtime_error("Could not map shared memory segment " + _name);
+    }
+
+    _segment = static_cast<char*>(address);
+
+    Header* header = new (_segment) Header();
+    header->barrierCount.store(0);
+    header->barrierGeneration.store(0);
+
+    for(int from=0; from < _rankCount; ++from)
+    {
+        for(int to=0; to < _rankCount; ++to)
+        {
+            for(int slot=0; slot < 2; ++slot)
+            {
+                Mailbox* box = new (&mailbox(from, to, slot)) Mailbox();
+                box->sequence.store(_EMPTY);
+                box->size = 0;
+            }
+        }
+    }
+}
+
+ShmHaloTransport::~ShmHaloTransport()
+{
+    munmap(_segment, _segmentSize);
+
+    if(getpid() == _ownerPid)
+        shm_unlink(_name.c_str());
+}
+
+void ShmHaloTransport::setRank(int rank)
+{
+    _rank = rank;
+}
+
+int ShmHaloTransport::rank() const
+{
+    return _rank;
+}
+
+int ShmHaloTransport::rankCount() const
+{
+    return _rankCount;
+}
+
+void ShmHaloTransport::send(int peer, int sequence, const std::vector<float>& data)
+{
+    if(static_cast<int>(data.size()) > _capacity)
+        throw runtime_error("Halo strip exceeds mailbox capacity");
+
+    Mailbox& box = mailbox(_rank, peer, sequence);
+
+    int spins = 0;
+    while(box.sequence.load(memory_order_acquire) != _EMPTY)
+        pause(spins);
+
+    memcpy(mailboxData(box), data.data(), data.size() * sizeof(float));
+    box.size = static_cast<int>(data.size());
+    box.sequence.store(sequence, memory_order_release);
+}
+
+void ShmHaloTransport::receive(int peer, int sequence, std::vector<float>& data)
+{
+    Mailbox& box = mailbox(peer, _rank, sequence);
+
+    int spins = 0;
+    while(box.sequence.load(memory_order_acquire) != sequence)
+        pause(spins);
+
+    const float* strip = mailboxData(box);
+    data.assign(strip, strip + box.size);
+    box.sequence.store(_EMPTY, memory_order_release);
+}
+
+void ShmHaloTransport::barrier()
+{
+    Header* header = reinterpret_cast<Header*>(_segment);
+
+    int generation = header->barrierGeneration.load(memory_order_acquire);
+    if(header->barrierCount.fetch_add(1, memory_order_acq_rel) + 1 == _rankCount)
+    {
+        header->barrierCount.store(0, memory_order_relaxed);
+        header->barrierGeneration.fetch_add(1, memory_order_release);
+        return;
+    }
+
+    int spins = 0;
+    while(header->barrierGeneration.load(memory_order_acquire) == generation)
+        pause(spins);
+}
+
+ShmHaloTransport::Mailbox& ShmHaloTransport::mailbox(int from, int to, int sequence)
+{
+    size_t slot = (static_cast<size_t>(from) * _rankCount + to) * 2 + (sequence & 1);
+    char* address = _segment + alignUp(sizeof(Header)) + slot * _mailboxStride;
+    return *reinterpret_cast<Mailbox*>(address);
+}
+
+float* ShmHaloTransport::mailboxData(Mailbox& box)
+{
+    return reinterpret_cast<float*>(reinterpret_cast<char*>(&box) +
+                                    alignUp(sizeof(Mailbox)));
+}
@@ -0,0 +1,61 @@
+#ifndef SHMHALOTRANSPORT_H
+#define SHMHALOTRANSPORT_H
+
+#include <string>
+#include <atomic>
+
+#include "HaloTransport.h"
+
+
+// Halo transport between processes of the same host through a POSIX shared
+// memory segment. Every ordered pair of ranks has two mailboxes, used on
+// alternate sequences, so a sender only waits when its receiver is two
+// steps behind.
+//
+// The segment is created before forking the ranks, each child then picks
+// its rank with setRank().
+class ShmHaloTransport : public HaloTransport
+{
+public:
+    ShmHaloTransport(const std::string& name, int rankCount, int capacity);
+    virtual ~ShmHaloTransport();
+
+    void setRank(int rank);
+
+    virtual int rank() const;
+    virtual int rankCount() const;
+
+    virtual void send(int peer, int sequence, const std::vector<float>& data);
+    virtual void receive(int peer, int sequence, std::vector<float>& data);
+    virtual void barrier();
+
+protected:
+    struct Header
+    {
+        std::atomic<int> barrierCount;
+        std::atomic<int> barrierGeneration;
+    };
+
+    struct Mailbox
+    {
+        std::atomic<int> sequence;
+        int size;
+    };
+
+    Mailbox& mailbox(int from, int to, int sequence);
+    float* mailboxData(Mailbox& box);
+
+private:
+    static const int _EMPTY = -1;
+
+    std::string _name;
+    int _rank;
+    int _rankCount;
+    int _capacity;
+    size_t _mailboxStride;
+    size_t _segmentSize;
+    int _ownerPid;
+    char* _segment;
+};
+
+#endif // SHMHALOTRANSPORT_H
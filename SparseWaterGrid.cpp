@@ -0,0 +1,266 @@
+#include "SparseWaterGrid.h"
+
+#include <algorithm>
+
+#include "TiledTerrain.h"
+
+using namespace std;
+
+
+SparseWaterGrid::SparseWaterGrid(int width, int height, int tileSize,
+                                 int neighborsRadius,
+                                 float stretchness, float lossyness) :
+    _WIDTH(width),
+    _HEIGHT(height),
+    _TILE_SIZE(tileSize),
+    _NEIGHBORS_RADIUS(neighborsRadius),
+    _PREFETCH_MARGIN(max(tileSize / 4, neighborsRadius)),
+    _STRETCHNESS(stretchness),
+    _LOSSYNESS(lossyness),
+    _TILES_X((width + tileSize - 1) / tileSize),
+    _TILES_Y((height + tileSize - 1) / tileSize),
+    _scenario(),
+    _directory(),
+    _resident(),
+    _wetCellCount(0)
+{
+    // Border bands of a tile must not overlap its far neighbors
+    assert( tileSize >= neighborsRadius );
+}
+
+void SparseWaterGrid::setup(const WaterScenario& scenario)
+{
+    _scenario = scenario;
+    _directory.clear();
+    _directory.resize(tileCount());
+    _resident.clear();
+
+    // One tile at a time, the dense lattice is never allocated
+    for(int t=0; t < tileCount(); ++t)
+    {
+        activate(t, false);
+        if(isDrained(*_directory[t]))
+            release(t);
+
+        // Only the terrain of a row of tiles is mapped during the sweep
+        if(_scenario.terrain && (t + 1) % _TILES_X == 0)
+            _scenario.terrain->evict();
+    }
+
+    updateResidency();
+}
+
+void SparseWaterGrid::step()
+{
+    updateResidency();
+
+    for(size_t r=0; r < _resident.size(); ++r)
+        refreshHalo(*_directory[_resident[r]]);
+
+    // Halos hold a copy, tiles can be stepped in any order
+    for(size_t r=0; r < _resident.size(); ++r)
+        _directory[_resident[r]]->step();
+}
+
+void SparseWaterGrid::tileBounds(int tile, int& i0, int& j0, int& i1, int& j1) const
+{
+    i0 = (tile % _TILES_X) * _TILE_SIZE;
+    j0 = (tile / _TILES_X) * _TILE_SIZE;
+    i1 = min(i0 + _TILE_SIZE, _WIDTH);
+    j1 = min(j0 + _TILE_SIZE, _HEIGHT);
+}
+
+void SparseWaterGrid::activate(int tile, bool isDry)
+{
+    int i0, j0, i1, j1;
+    tileBounds(tile, i0, j0, i1, j1);
+
+    WaterSolver* solver = new WaterSolver(_WIDTH, _HEIGHT, _NEIGHBORS_RADIUS,
+                                          _STRETCHNESS, _LOSSYNESS,
+                                          i0, j0, i1, j1);
+    solver->setupScenario(_scenario);
+
+    // Water that flows in finds the tile as it was left
+    if(isDry)
+    {
+        solver->waterHeights() = solver->groundHeights();
+        fill(solver->velocities().begin(), solver->velocities().end(), 0.0f);
+    }
+
+    _directory[tile].reset(solver);
+    _resident.push_back(tile);
+}
+
+void SparseWaterGrid::release(int tile)
+{
+    _directory[tile].reset();
+    _resident.erase(find(_resident.begin(), _resident.end(), tile));
+}
+
+bool SparseWaterGrid::isDrained(const WaterSolver& solver) const
+{
+    for(int j=solver.ownedY0(); j < solver.ownedY1(); ++j)
+    {
+        for(int i=solver.ownedX0(); i < solver.ownedX1(); ++i)
+        {
+            if(solver.waterHeight(i, j) > solver.groundHeight(i, j) ||
+               solver.velocity(i, j) != 0.0f)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void SparseWaterGrid::updateResidency()
+{
+    const int R = _NEIGHBORS_RADIUS;
+    const int M = _PREFETCH_MARGIN;
+    vector<char> isWoken(tileCount(), 0);
+    vector<char> isApproached(tileCount(), 0);
+    vector<int> drained;
+    _wetCellCount = 0;
+
+    for(size_t r=0; r < _resident.size(); ++r)
+    {
+        int tile = _resident[r];
+        const WaterSolver& solver = *_directory[tile];
+        int i0, j0, i1, j1;
+        tileBounds(tile, i0, j0, i1, j1);
+
+        // Wet cells within the radius of each border
+        bool isMoving = false;
+        bool wetX[3] = {false, false, false};
+        bool wetY[3] = {false, false, false};
+        bool nearX[3] = {false, false, false};
+        bool nearY[3] = {false, false, false};
+        for(int j=j0; j < j1; ++j)
+        {
+            for(int i=i0; i < i1; ++i)
+            {
+                isMoving = isMoving || solver.velocity(i, j) != 0.0f;
+                if(solver.waterHeight(i, j) <= solver.groundHeight(i, j))
+                    continue;
+
+                ++_wetCellCount;
+                wetX[0] = wetX[0] || i <  i0 + R;
+                wetX[1] = true;
+                wetX[2] = wetX[2] || i >= i1 - R;
+                wetY[0] = wetY[0] || j <  j0 + R;
+                wetY[1] = true;
+                wetY[2] = wetY[2] || j >= j1 - R;
+                nearX[0] = nearX[0] || i <  i0 + M;
+                nearX[2] = nearX[2] || i >= i1 - M;
+                nearY[0] = nearY[0] || j <  j0 + M;
+                nearY[2] = nearY[2] || j >= j1 - M;
+            }
+        }
+
+        if(!wetX[1] && !isMoving)
+            drained.push_back(tile);
+
+        int ti = tile % _TILES_X;
+        int tj = tile / _TILES_X;
+        for(int dy=-1; dy <= 1; ++dy)
+        {
+            for(int dx=-1; dx <= 1; ++dx)
+            {
+                int neighbor = tileIndex(ti + dx, tj + dy);
+                if(neighbor < 0 || (dx == 0 && dy == 0))
+                    continue;
+
+                if(wetX[dx + 1] && wetY[dy + 1])
+                    isWoken[neighbor] = 1;
+                if((dx == 0 || nearX[dx + 1]) && (dy == 0 || nearY[dy + 1]) &&
+                   wetX[1])
+                    isApproached[neighbor] = 1;
+            }
+        }
+    }
+
+    for(size_t d=0; d < drained.size(); ++d)
+    {
+        if(!isWoken[drained[d]])
+            release(drained[d]);
+    }
+
+    for(int t=0; t < tileCount(); ++t)
+    {
+        if(isWoken[t] && !_directory[t])
+            activate(t, true);
+    }
+
+    if(_scenario.terrain)
+        updateTerrain(isApproached);
+}
+
+void SparseWaterGrid::updateTerrain(const std::vector<char>& isApproached)
+{
+    // Tiles read their ground, halo included, when they are activated
+    TiledTerrain& terrain = *_scenario.terrain;
+    const int R = _NEIGHBORS_RADIUS;
+    for(int t=0; t < tileCount(); ++t)
+    {
+        if(!_directory[t] && !isApproached[t])
+            continue;
+
+        int i0, j0, i1, j1;
+        tileBounds(t, i0, j0, i1, j1);
+        float x0 = (i0 - R) / static_cast<float>(_WIDTH);
+        float y0 = (j0 - R) / static_cast<float>(_HEIGHT);
+        float x1 = (i1 + R) / static_cast<float>(_WIDTH);
+        float y1 = (j1 + R) / static_cast<float>(_HEIGHT);
+
+        if(_directory[t])
+            terrain.retain(x0, y0, x1, y1);
+        else
+            terrain.prefetch(x0, y0, x1, y1);
+    }
+
+    terrain.evict();
+}
+
+void SparseWaterGrid::refreshHalo(WaterSolver& solver)
+{
+    FieldArray& heights = solver.waterHeights();
+    const FieldArray& ground = solver.groundHeights();
+
+    for(int j=solver.storageY0(); j < solver.storageY0() + solver.storageHeight(); ++j)
+    {
+        for(int i=solver.storageX0(); i < solver.storageX0() + solver.storageWidth(); ++i)
+        {
+            if(solver.ownedX0() <= i && i < solver.ownedX1() &&
+               solver.ownedY0() <= j && j < solver.ownedY1())
+                continue;
+
+            int s = solver.storageIndex(i, j);
+            const WaterSolver* neighbor =
+                _directory[tileIndex(i / _TILE_SIZE, j / _TILE_SIZE)].get();
+            heights[s] = neighbor ? neighbor->waterHeight(i, j) : ground[s];
+        }
+    }
+}
+
+size_t SparseWaterGrid::residentBytes() const
+{
+    size_t bytes = _directory.size() * sizeof(_directory[0]);
+    for(size_t r=0; r < _resident.size(); ++r)
+    {
+        const WaterSolver& solver = *_directory[_resident[r]];
+        size_t storageSize = solver.storageWidth() * solver.storageHeight();
+        bytes += sizeof(WaterSolver) + storageSize * 4 * sizeof(float);
+        bytes += solver.stencil().size() * sizeof(StencilTap);
+    }
+    return bytes;
+}
+
+float SparseWaterGrid::waterHeight(int i, int j) const
+{
+    const WaterSolver* solver =
+        _directory[tileIndex(i / _TILE_SIZE, j / _TILE_SIZE)].get();
+    if(solver)
+        return solver->waterHeight(i, j);
+
+    return _scenario.groundHeight(i / static_cast<float>(_WIDTH),
+                                  j / static_cast<float>(_HEIGHT));
+}
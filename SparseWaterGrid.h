@@ -0,0 +1,100 @@
+#ifndef SPARSEWATERGRID_H
+#define SPARSEWATERGRID_H
+
+#include <vector>
+#include <memory>
+
+#include "WaterScenario.h"
+#include "WaterSolver.h"
+
+
+// Lattice stored as square tiles, allocated only where there is water.
+//
+// A tile missing from the directory is dry : its water lies on the ground
+// and does not move, so it needs no storage at all. Each resident tile is a
+// solver of its own rectangle whose halo is refreshed from the directory
+// before a step, which steps the cells exactly as the dense lattice does.
+// A tile is allocated when water comes within the neighbors radius of its
+// border and released once it has drained, so the memory follows the
+// wetted area rather than the extent of the lattice.
+//
+// A scenario on a tiled terrain gets the same treatment for its ground :
+// terrain under resident tiles stays mapped, terrain of tiles that water
+// approaches is prefetched before they are woken, the rest is unmapped.
+class SparseWaterGrid
+{
+public:
+    SparseWaterGrid(int width, int height, int tileSize, int neighborsRadius,
+                    float stretchness, float lossyness);
+
+    void setup(const WaterScenario& scenario);
+    void step();
+
+    const WaterScenario& scenario() const;
+    int tileCount() const;
+    int residentCount() const;
+    int wetCellCount() const;
+    size_t residentBytes() const;
+
+    // Dry tiles give back their ground
+    float waterHeight(int i, int j) const;
+
+protected:
+    int tileIndex(int ti, int tj) const;
+    void tileBounds(int tile, int& i0, int& j0, int& i1, int& j1) const;
+
+    void activate(int tile, bool isDry);
+    void release(int tile);
+    bool isDrained(const WaterSolver& solver) const;
+    void updateResidency();
+    void updateTerrain(const std::vector<char>& isApproached);
+    void refreshHalo(WaterSolver& solver);
+
+private:
+    const int _WIDTH;
+    const int _HEIGHT;
+    const int _TILE_SIZE;
+    const int _NEIGHBORS_RADIUS;
+    const int _PREFETCH_MARGIN;
+    const float _STRETCHNESS;
+    const float _LOSSYNESS;
+    const int _TILES_X;
+    const int _TILES_Y;
+
+    WaterScenario _scenario;
+    std::vector<std::unique_ptr<WaterSolver>> _directory;
+    std::vector<int> _resident;
+    int _wetCellCount;
+};
+
+
+
+// IMPLEMENTATION //
+inline const WaterScenario& SparseWaterGrid::scenario() const
+{
+    return _scenario;
+}
+
+inline int SparseWaterGrid::tileCount() const
+{
+    return _TILES_X * _TILES_Y;
+}
+
+inline int SparseWaterGrid::residentCount() const
+{
+    return static_cast<int>(_resident.size());
+}
+
+inline int SparseWaterGrid::wetCellCount() const
+{
+    return _wetCellCount;
+}
+
+inline int SparseWaterGrid::tileIndex(int ti, int tj) const
+{
+    if(ti < 0 || ti >= _TILES_X || tj < 0 || tj >= _TILES_Y)
+        return -1;
+    return tj * _TILES_X + ti;
+}
+
+#endif // SPARSEWATERGRID_H
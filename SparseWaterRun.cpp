@@ -0,0 +1,105 @@
+#include "SparseWaterRun.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "SparseWaterGrid.h"
+#include "TiledTerrain.h"
+#include "WaterSolver.h"
+
+using namespace std;
+
+
+SparseWaterRun::SparseWaterRun(const WaterOptions& options) :
+    HeadlessWaterRun(options),
+    _DENSE_BYTES(4.0 * sizeof(float) * options.width * options.height)
+{
+}
+
+int SparseWaterRun::execute()
+{
+    SparseWaterGrid grid(_options.width, _options.height, _options.tileSize,
+                         _NEIGHBORS_RADIUS, _STRETCHNESS, _LOSSYNESS);
+    grid.setup(_options.initialScenario());
+
+    cout << "Sparse run: " << _options.width << "x" << _options.height
+         << " lattice in " << grid.tileCount() << " tiles of "
+         << _options.tileSize << ", " << _options.stepCount << " steps" << endl;
+    report(grid, 0);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    size_t peakBytes = grid.residentBytes();
+    int reportInterval = max(_options.stepCount / 10, 1);
+    for(int s=1; s <= _options.stepCount; ++s)
+    {
+        grid.step();
+        peakBytes = max(peakBytes, grid.residentBytes());
+        if(s % reportInterval == 0)
+            report(grid, s);
+    }
+
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+    cout << "Sparse run: " << seconds << " s, "
+         << _options.stepCount / seconds << " steps/s, peak fields "
+         << peakBytes / 1048576.0 << " MiB, dense fields "
+         << _DENSE_BYTES / 1048576.0 << " MiB" << endl;
+
+    if(_options.verify)
+        return verify(grid);
+
+    return 0;
+}
+
+void SparseWaterRun::report(const SparseWaterGrid& grid, int step) const
+{
+    double cellCount = _options.width * static_cast<double>(_options.height);
+    cout << "Step " << step << ": "
+         << grid.residentCount() << " resident tiles, "
+         << 100.0 * grid.wetCellCount() / cellCount << "% wet, fields "
+         << grid.residentBytes() / 1048576.0 << " MiB ("
+         << 100.0 * grid.residentBytes() / _DENSE_BYTES << "% of dense)" << endl;
+
+    const TiledTerrain* terrain = grid.scenario().terrain.get();
+    if(terrain)
+    {
+        cout << "  terrain: " << terrain->mappedCount() << " of "
+             << terrain->tileCount() << " tiles mapped ("
+             << terrain->mappedBytes() / 1048576.0 << " MiB), "
+             << terrain->prefetchCount() << " prefetched, "
+             << terrain->missCount() << " mapped on demand" << endl;
+    }
+}
+
+int SparseWaterRun::verify(const SparseWaterGrid& grid)
+{
+    WaterSolver solver(_options.width, _options.height, _NEIGHBORS_RADIUS,
+                       _STRETCHNESS, _LOSSYNESS);
+    solver.setupScenario(_options.initialScenario());
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(int s=0; s < _options.stepCount; ++s)
+        solver.step();
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+
+    float maxDifference = 0.0f;
+    for(int j=0; j < _options.height; ++j)
+    {
+        for(int i=0; i < _options.width; ++i)
+        {
+            float difference = fabs(solver.waterHeight(i, j) -
+                                    grid.waterHeight(i, j));
+            maxDifference = max(maxDifference, difference);
+        }
+    }
+
+    cout << "Dense lattice: " << seconds << " s, "
+         << _options.stepCount / seconds << " steps/s" << endl;
+    cout << "Max difference with the dense lattice: " << maxDifference << endl;
+
+    return maxDifference == 0.0f ? 0 : 1;
+}
@@ -0,0 +1,27 @@
+#ifndef SPARSEWATERRUN_H
+#define SPARSEWATERRUN_H
+
+#include "HeadlessWaterRun.h"
+
+class SparseWaterGrid;
+
+
+// Headless run of the tiled lattice. Reports how the resident memory
+// follows the wetted area, and with verification compares the surface
+// with the dense lattice, which it must match exactly.
+class SparseWaterRun : public HeadlessWaterRun
+{
+public:
+    SparseWaterRun(const WaterOptions& options);
+
+    virtual int execute();
+
+protected:
+    void report(const SparseWaterGrid& grid, int step) const;
+    int verify(const SparseWaterGrid& grid);
+
+private:
+    const double _DENSE_BYTES;
+};
+
+#endif // SPARSEWATERRUN_H
@@ -0,0 +1,192 @@
+#include "TemporalWaterGrid.h"
+
+#include <algorithm>
+
+#include "WorkerPool.h"
+
+using namespace std;
+
+
+TemporalWaterGrid::TemporalWaterGrid(int width, int height, int tileSize,
+                                     int blockSteps, int neighborsRadius,
+                                     float stretchness, float lossyness) :
+    _WIDTH(width),
+    _HEIGHT(height),
+    _TILE_SIZE(tileSize),
+    _BLOCK_STEPS(blockSteps),
+    _NEIGHBORS_RADIUS(neighborsRadius),
+    _TILES_X((width + tileSize - 1) / tileSize),
+    _TILES_Y((height + tileSize - 1) / tileSize),
+    _solvers(),
+    _idleSolvers(),
+    _solversMutex(),
+    _current(0),
+    _groundHeights(),
+    _waterHeights(),
+    _velocities()
+{
+    assert( blockSteps >= 1 );
+
+    // The caller steps tiles with the workers, a tile in the middle of the
+    // lattice sizes the storage of every other one
+    int participants = getWorkerPool().threadCount() + 1;
+    int middle = (_TILES_Y / 2) * _TILES_X + _TILES_X / 2;
+    for(int p=0; p < participants; ++p)
+    {
+        _solvers.push_back(unique_ptr<WaterSolver>(new WaterSolver(
+            width, height, neighborsRadius, stretchness, lossyness)));
+        moveToTile(middle, neighborsRadius * (blockSteps - 1), *_solvers.back());
+        _idleSolvers.push_back(_solvers.back().get());
+    }
+}
+
+void TemporalWaterGrid::setup(const WaterScenario& scenario)
+{
+    _groundHeights.assign(_WIDTH * _HEIGHT, 0.0f);
+    for(int b=0; b < 2; ++b)
+    {
+        _waterHeights[b].assign(_WIDTH * _HEIGHT, 0.0f);
+        _velocities[b].assign(_WIDTH * _HEIGHT, 0.0f);
+    }
+    _current = 0;
+
+    // Filled tile by tile, as the solvers fill them
+    WaterSolver& solver = *_solvers.front();
+    for(int t=0; t < tileCount(); ++t)
+    {
+        moveToTile(t, 0, solver);
+        solver.setupScenario(scenario);
+
+        for(int j=solver.ownedY0(); j < solver.ownedY1(); ++j)
+        {
+            for(int i=solver.ownedX0(); i < solver.ownedX1(); ++i)
+            {
+                int s = solver.storageIndex(i, j);
+                _groundHeights[index(i, j)] = solver.groundHeights()[s];
+                _waterHeights[0][index(i, j)] = solver.waterHeights()[s];
+                _velocities[0][index(i, j)] = solver.velocities()[s];
+            }
+        }
+    }
+}
+
+void TemporalWaterGrid::step(int stepCount)
+{
+    for(int s=0; s < stepCount; s += _BLOCK_STEPS)
+        advanceBlock(min(_BLOCK_STEPS, stepCount - s));
+}
+
+void TemporalWaterGrid::advanceBlock(int blockSteps)
+{
+    // Tiles read the current lattice and write their own cells of the next
+    getWorkerPool().parallelFor(0, tileCount(), [&](int t0, int t1)
+    {
+        WaterSolver* solver = takeSolver();
+        for(int t=t0; t < t1; ++t)
+            advanceTile(t, blockSteps, *solver);
+        giveSolver(solver);
+    });
+
+    _current = 1 - _current;
+}
+
+void TemporalWaterGrid::advanceTile(int tile, int blockSteps, WaterSolver& solver)
+{
+    const int R = _NEIGHBORS_RADIUS;
+    moveToTile(tile, R * (blockSteps - 1), solver);
+
+    const int ti = tile % _TILES_X;
+    const int tj = tile / _TILES_X;
+    const int i0 = ti * _TILE_SIZE;
+    const int j0 = tj * _TILE_SIZE;
+    const int i1 = min(i0 + _TILE_SIZE, _WIDTH);
+    const int j1 = min(j0 + _TILE_SIZE, _HEIGHT);
+
+    const int x0 = solver.storageX0();
+    const int y0 = solver.storageY0();
+    const int x1 = x0 + solver.storageWidth();
+    const int y1 = y0 + solver.storageHeight();
+
+    const vector<float>& heights = _waterHeights[_current];
+    const vector<float>& velocities = _velocities[_current];
+    for(int j=y0; j < y1; ++j)
+    {
+        int row = index(x0, j);
+        int s = solver.storageIndex(x0, j);
+        copy(_groundHeights.begin() + row, _groundHeights.begin() + row + (x1 - x0),
+             solver.groundHeights().begin() + s);
+        copy(heights.begin() + row, heights.begin() + row + (x1 - x0),
+             solver.waterHeights().begin() + s);
+        copy(velocities.begin() + row, velocities.begin() + row + (x1 - x0),
+             solver.velocities().begin() + s);
+    }
+
+    // Each step loses a radius of valid cells around the stepped region
+    for(int k=0; k < blockSteps; ++k)
+    {
+        int grow = R * (blockSteps - 1 - k);
+        solver.stepRegion(max(i0 - grow, 0), max(j0 - grow, 0),
+                          min(i1 + grow, _WIDTH), min(j1 + grow, _HEIGHT));
+        solver.swapBuffers();
+    }
+
+    vector<float>& nextHeights = _waterHeights[1 - _current];
+    vector<float>& nextVelocities = _velocities[1 - _current];
+    for(int j=j0; j < j1; ++j)
+    {
+        int row = index(i0, j);
+        int s = solver.storageIndex(i0, j);
+        copy(solver.waterHeights().begin() + s,
+             solver.waterHeights().begin() + s + (i1 - i0),
+             nextHeights.begin() + row);
+        copy(solver.velocities().begin() + s,
+             solver.velocities().begin() + s + (i1 - i0),
+             nextVelocities.begin() + row);
+    }
+}
+
+void TemporalWaterGrid::moveToTile(int tile, int grow, WaterSolver& solver) const
+{
+    int i0 = (tile % _TILES_X) * _TILE_SIZE;
+    int j0 = (tile / _TILES_X) * _TILE_SIZE;
+    int i1 = min(i0 + _TILE_SIZE, _WIDTH);
+    int j1 = min(j0 + _TILE_SIZE, _HEIGHT);
+    solver.moveDomain(max(i0 - grow, 0), max(j0 - grow, 0),
+                      min(i1 + grow, _WIDTH), min(j1 + grow, _HEIGHT));
+}
+
+WaterSolver* TemporalWaterGrid::takeSolver()
+{
+    // No more chunks run at once than there are participants
+    lock_guard<mutex> lock(_solversMutex);
+    WaterSolver* solver = _idleSolvers.back();
+    _idleSolvers.pop_back();
+    return solver;
+}
+
+void TemporalWaterGrid::giveSolver(WaterSolver* solver)
+{
+    lock_guard<mutex> lock(_solversMutex);
+    _idleSolvers.push_back(solver);
+}
+
+double TemporalWaterGrid::overhead() const
+{
+    const int R = _NEIGHBORS_RADIUS;
+    double stepped = 0.0;
+    for(int t=0; t < tileCount(); ++t)
+    {
+        int i0 = (t % _TILES_X) * _TILE_SIZE;
+        int j0 = (t / _TILES_X) * _TILE_SIZE;
+        int i1 = min(i0 + _TILE_SIZE, _WIDTH);
+        int j1 = min(j0 + _TILE_SIZE, _HEIGHT);
+        for(int k=0; k < _BLOCK_STEPS; ++k)
+        {
+            int grow = R * (_BLOCK_STEPS - 1 - k);
+            stepped += double(min(i1 + grow, _WIDTH) - max(i0 - grow, 0)) *
+                       double(min(j1 + grow, _HEIGHT) - max(j0 - grow, 0));
+        }
+    }
+
+    return stepped / (double(_WIDTH) * _HEIGHT * _BLOCK_STEPS);
+}
@@ -0,0 +1,95 @@
+#ifndef TEMPORALWATERGRID_H
+#define TEMPORALWATERGRID_H
+
+#include <mutex>
+#include <vector>
+#include <memory>
+
+#include "WaterScenario.h"
+#include "WaterSolver.h"
+
+
+// Lattice advanced by blocks of steps, one tile at a time.
+//
+// A plain step streams the whole lattice through memory once. Here each
+// tile copies its cells plus a halo of K times the neighbors radius, then
+// steps K times on its own while it stays in cache : the stepped region
+// shrinks by the radius each step, so the tile cells see the same inputs
+// as on the whole lattice after K steps. Halos overlap, the cells they
+// hold are stepped by each tile that needs them. Results match the whole
+// lattice exactly, only the intermediate steps are never assembled.
+//
+// Tiles are stepped by scratch solvers, one per thread stepping at once,
+// moved over the tile and filled from the lattice, ground included.
+class TemporalWaterGrid
+{
+public:
+    TemporalWaterGrid(int width, int height, int tileSize, int blockSteps,
+                      int neighborsRadius, float stretchness, float lossyness);
+
+    void setup(const WaterScenario& scenario);
+
+    // Steps by blocks of K, the last block may be shorter
+    void step(int stepCount);
+
+    int tileCount() const;
+    int blockSteps() const;
+
+    // Cells stepped per lattice cell and step, halos included
+    double overhead() const;
+
+    float waterHeight(int i, int j) const;
+
+protected:
+    int index(int i, int j) const;
+    void advanceBlock(int blockSteps);
+    void advanceTile(int tile, int blockSteps, WaterSolver& solver);
+    void moveToTile(int tile, int grow, WaterSolver& solver) const;
+    WaterSolver* takeSolver();
+    void giveSolver(WaterSolver* solver);
+
+private:
+    const int _WIDTH;
+    const int _HEIGHT;
+    const int _TILE_SIZE;
+    const int _BLOCK_STEPS;
+    const int _NEIGHBORS_RADIUS;
+    const int _TILES_X;
+    const int _TILES_Y;
+
+    // A stepped tile owns its cells grown by K-1 radii, the storage adds
+    // one more. Solvers are only kept for the threads, not for the tiles.
+    std::vector<std::unique_ptr<WaterSolver>> _solvers;
+    std::vector<WaterSolver*> _idleSolvers;
+    std::mutex _solversMutex;
+
+    int _current;
+    std::vector<float> _groundHeights;
+    std::vector<float> _waterHeights[2];
+    std::vector<float> _velocities[2];
+};
+
+
+
+// IMPLEMENTATION //
+inline int TemporalWaterGrid::tileCount() const
+{
+    return _TILES_X * _TILES_Y;
+}
+
+inline int TemporalWaterGrid::blockSteps() const
+{
+    return _BLOCK_STEPS;
+}
+
+inline int TemporalWaterGrid::index(int i, int j) const
+{
+    return j * _WIDTH + i;
+}
+
+inline float TemporalWaterGrid::waterHeight(int i, int j) const
+{
+    return _waterHeights[_current][index(i, j)];
+}
+
+#endif // TEMPORALWATERGRID_H
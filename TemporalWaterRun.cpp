@@ -0,0 +1,97 @@
+#include "TemporalWaterRun.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "TemporalWaterGrid.h"
+#include "WaterSolver.h"
+
+using namespace std;
+
+
+TemporalWaterRun::TemporalWaterRun(const WaterOptions& options) :
+    HeadlessWaterRun(options),
+    _CACHE_BYTES(512 * 1024),
+    _MIN_TILE_SIZE(16),
+    _reference()
+{
+}
+
+int TemporalWaterRun::execute()
+{
+    WaterScenario scenario = _options.initialScenario();
+
+    cout << "Temporal run: " << _options.width << "x" << _options.height
+         << " lattice, " << _options.stepCount << " steps" << endl;
+
+    WaterSolver solver(_options.width, _options.height, _NEIGHBORS_RADIUS,
+                       _STRETCHNESS, _LOSSYNESS);
+    solver.setupScenario(scenario);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(int s=0; s < _options.stepCount; ++s)
+        solver.step();
+    double plainRate = _options.stepCount / chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+    cout << "Plain lattice: " << plainRate << " steps/s" << endl;
+
+    _reference.resize(_options.width * _options.height);
+    for(int j=0; j < _options.height; ++j)
+        for(int i=0; i < _options.width; ++i)
+            _reference[j * _options.width + i] = solver.waterHeight(i, j);
+
+    bool isExact = true;
+    for(int k=1; ; k = min(2 * k, _options.blockSteps))
+    {
+        int size = tileSize(k);
+        TemporalWaterGrid grid(_options.width, _options.height, size, k,
+                               _NEIGHBORS_RADIUS, _STRETCHNESS, _LOSSYNESS);
+        grid.setup(scenario);
+
+        start = chrono::steady_clock::now();
+        grid.step(_options.stepCount);
+        double rate = _options.stepCount / chrono::duration<double>(
+            chrono::steady_clock::now() - start).count();
+
+        cout << "K " << k << ", tiles of " << size << ": "
+             << rate << " steps/s (" << rate / plainRate << "x), "
+             << grid.overhead() << " cells stepped per cell";
+
+        if(_options.verify)
+        {
+            float difference = maxDifference(grid);
+            isExact = isExact && difference == 0.0f;
+            cout << ", max difference " << difference;
+        }
+        cout << endl;
+
+        if(k == _options.blockSteps)
+            break;
+    }
+
+    return isExact ? 0 : 1;
+}
+
+int TemporalWaterRun::tileSize(int blockSteps) const
+{
+    // Two height buffers, ground and velocities per stored cell
+    int side = static_cast<int>(sqrt(_CACHE_BYTES / (4.0 * sizeof(float))));
+    int size = side - 2 * _NEIGHBORS_RADIUS * blockSteps;
+    return max(size, _MIN_TILE_SIZE);
+}
+
+float TemporalWaterRun::maxDifference(const TemporalWaterGrid& grid) const
+{
+    float difference = 0.0f;
+    for(int j=0; j < _options.height; ++j)
+    {
+        for(int i=0; i < _options.width; ++i)
+        {
+            float reference = _reference[j * _options.width + i];
+            difference = max(difference, fabs(grid.waterHeight(i, j) - reference));
+        }
+    }
+    return difference;
+}
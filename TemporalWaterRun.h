@@ -0,0 +1,34 @@
+#ifndef TEMPORALWATERRUN_H
+#define TEMPORALWATERRUN_H
+
+#include <vector>
+
+#include "HeadlessWaterRun.h"
+
+class TemporalWaterGrid;
+
+
+// Headless fast forward by temporal blocking. Advances the lattice with
+// block lengths doubling up to the requested one and reports the steps per
+// second of each against the plain lattice. With verification, every
+// surface must match the plain lattice exactly.
+class TemporalWaterRun : public HeadlessWaterRun
+{
+public:
+    TemporalWaterRun(const WaterOptions& options);
+
+    virtual int execute();
+
+protected:
+    // Largest tile whose fields and halo fit the cache budget
+    int tileSize(int blockSteps) const;
+    float maxDifference(const TemporalWaterGrid& grid) const;
+
+private:
+    const int _CACHE_BYTES;
+    const int _MIN_TILE_SIZE;
+
+    std::vector<float> _reference;
+};
+
+#endif // TEMPORALWATERRUN_H
@@ -0,0 +1,234 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+using namespace std;
+
+#include "TerrainFile.h"
+using namespace TerrainFile;
+
+
+namespace
+{
+    struct ConverterOptions
+    {
+        string input;
+        string output;
+        int width;
+        int height;
+        bool isInt16;
+        bool isBigEndian;
+        bool isTopFirst;
+        int tileSize;
+        bool hasRange;
+        float low;
+        float high;
+    };
+
+    const char* USAGE =
+        "Usage: TerrainConverter INPUT WIDTH HEIGHT OUTPUT [options]\n"
+        "Converts a raw elevation grid to the tiled terrain read by --terrain.\n"
+        "  --int16            Samples are 16 bits integers (32 bits floats)\n"
+        "  --big-endian       Samples are big endian, as in SRTM tiles\n"
+        "  --top-first        Rows go from the top, as in most DEMs (bottom)\n"
+        "  --tile N           Tile size in cells, a multiple of 32 (256)\n"
+        "  --range LOW HIGH   Elevations mapped to ground heights 0 and 1\n"
+        "                     (lowest and highest elevations of the grid)\n";
+
+    bool parse(int argc, char** argv, ConverterOptions& options)
+    {
+        if(argc < 5)
+            return false;
+
+        options.input = argv[1];
+        options.width = atoi(argv[2]);
+        options.height = atoi(argv[3]);
+        options.output = argv[4];
+        options.isInt16 = false;
+        options.isBigEndian = false;
+        options.isTopFirst = false;
+        options.tileSize = 256;
+        options.hasRange = false;
+
+        for(int a=5; a < argc; ++a)
+        {
+            if(strcmp(argv[a], "--int16") == 0)
+                options.isInt16 = true;
+            else if(strcmp(argv[a], "--big-endian") == 0)
+                options.isBigEndian = true;
+            else if(strcmp(argv[a], "--top-first") == 0)
+                options.isTopFirst = true;
+            else if(strcmp(argv[a], "--tile") == 0 && a + 1 < argc)
+                options.tileSize = atoi(argv[++a]);
+            else if(strcmp(argv[a], "--range") == 0 && a + 2 < argc)
+            {
+                options.hasRange = true;
+                options.low = static_cast<float>(atof(argv[++a]));
+                options.high = static_cast<float>(atof(argv[++a]));
+            }
+            else
+                return false;
+        }
+
+        return options.width > 0 && options.height > 0 &&
+               options.tileSize > 0 && options.tileSize % 32 == 0 &&
+               (!options.hasRange || options.high != options.low);
+    }
+
+    // Reads rows of elevations, as floats
+    class ElevationReader
+    {
+    public:
+        ElevationReader(const ConverterOptions& options) :
+            _options(options),
+            _file(fopen(options.input.c_str(), "rb")),
+            _samples(options.width * (options.isInt16 ? 2 : 4))
+        {
+            if(!_file)
+                throw runtime_error("Could not open " + options.input);
+        }
+
+        ~ElevationReader()
+        {
+            fclose(_file);
+        }
+
+        // Row j of the lattice, counted from the bottom
+        void readRow(int j, float* row)
+        {
+            int r = _options.isTopFirst ? _options.height - 1 - j : j;
+            if(fseeko(_file, off_t(r) * _samples.size(), SEEK_SET) != 0)
+                throw runtime_error("Could not seek in " + _options.input);
+
+            if(fread(_samples.data(), 1, _samples.size(), _file) != _samples.size())
+                throw runtime_error(_options.input + " is shorter than the grid");
+
+            const int sampleSize = _options.isInt16 ? 2 : 4;
+            for(int i=0; i < _options.width; ++i)
+            {
+                unsigned char* sample = &_samples[i * sampleSize];
+                if(_options.isBigEndian)
+                    reverse(sample, sample + sampleSize);
+
+                if(_options.isInt16)
+                {
+                    int16_t value;
+                    memcpy(&value, sample, sizeof(value));
+                    row[i] = value;
+                }
+                else
+                    memcpy(&row[i], sample, sizeof(float));
+            }
+        }
+
+    private:
+        const ConverterOptions& _options;
+        FILE* _file;
+        vector<unsigned char> _samples;
+    };
+}
+
+
+// Converts a raw elevation grid to a tiled terrain. Goes through the grid a
+// band of tile rows at a time, so grids larger than memory convert too.
+int main(int argc, char** argv) try
+{
+    ConverterOptions options;
+    if(!parse(argc, argv, options))
+    {
+        cerr << USAGE;
+        return 1;
+    }
+
+    const int W = options.width;
+    const int H = options.height;
+    const int T = options.tileSize;
+    ElevationReader reader(options);
+    vector<float> band(size_t(W) * T);
+
+    if(!options.hasRange)
+    {
+        options.low = numeric_limits<float>::max();
+        options.high = numeric_limits<float>::lowest();
+        for(int j=0; j < H; ++j)
+        {
+            reader.readRow(j, band.data());
+            for(int i=0; i < W; ++i)
+            {
+                options.low = min(options.low, band[i]);
+                options.high = max(options.high, band[i]);
+            }
+        }
+        if(options.high == options.low)
+            options.high = options.low + 1.0f;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.width = W;
+    header.height = H;
+    header.tileSize = T;
+    header.tilesX = (W + T - 1) / T;
+    header.tilesY = (H + T - 1) / T;
+    header.tileOffset = alignUp(sizeof(Header));
+    header.tileStride = alignUp(tileBytes(T));
+    header.lowElevation = options.low;
+    header.highElevation = options.high;
+
+    FILE* output = fopen(options.output.c_str(), "wb");
+    if(!output)
+        throw runtime_error("Could not create " + options.output);
+
+    vector<char> padding(header.tileOffset - sizeof(Header), 0);
+    fwrite(&header, sizeof(header), 1, output);
+    fwrite(padding.data(), 1, padding.size(), output);
+
+    const float scale = 1.0f / (options.high - options.low);
+    vector<float> tile(header.tileStride / sizeof(float), 0.0f);
+    for(int ty=0; ty < header.tilesY; ++ty)
+    {
+        int rows = min(T, H - ty * T);
+        for(int r=0; r < rows; ++r)
+        {
+            float* row = &band[size_t(r) * W];
+            reader.readRow(ty * T + r, row);
+            for(int i=0; i < W; ++i)
+                row[i] = (row[i] - options.low) * scale;
+        }
+
+        for(int tx=0; tx < header.tilesX; ++tx)
+        {
+            for(int r=0; r < T; ++r)
+            {
+                const float* row = &band[size_t(min(r, rows - 1)) * W];
+                for(int c=0; c < T; ++c)
+                    tile[r * T + c] = row[min(tx * T + c, W - 1)];
+            }
+
+            if(fwrite(tile.data(), 1, header.tileStride, output) != header.tileStride)
+                throw runtime_error("Could not write " + options.output);
+        }
+
+        cout << "\rConverted " << (ty + 1) * header.tilesX << " of "
+             << header.tilesX * header.tilesY << " tiles" << flush;
+    }
+
+    fclose(output);
+    cout << endl << options.output << ": " << W << "x" << H << " in tiles of "
+         << T << ", elevations " << options.low << " to " << options.high
+         << " mapped to 0 and 1" << endl;
+    return 0;
+}
+catch(exception& e)
+{
+    cerr << "Exception caught : " << e.what() << endl;
+    return 1;
+}
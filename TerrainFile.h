@@ -0,0 +1,47 @@
+#ifndef TERRAINFILE_H
+#define TERRAINFILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+
+// Layout of a tiled terrain file, as written by TerrainConverter. The header
+// is followed by square tiles of ground heights in row major tile order,
+// each one stored row by row. Tiles on the right and top borders are padded
+// with their last cells so every tile has the same size.
+//
+// Heights are in the units of the scenarios : the elevations mapped to 0
+// and 1 are kept in the header.
+namespace TerrainFile
+{
+    const char MAGIC[8] = {'W', 'S', 'T', 'E', 'R', 'R', 'A', 'N'};
+    const uint32_t VERSION = 1;
+    const size_t ALIGNMENT = 4096;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        int32_t width;
+        int32_t height;
+        int32_t tileSize;
+        int32_t tilesX;
+        int32_t tilesY;
+        uint64_t tileOffset;
+        uint64_t tileStride;
+        float lowElevation;
+        float highElevation;
+    };
+
+    inline size_t alignUp(size_t size)
+    {
+        return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    inline size_t tileBytes(int tileSize)
+    {
+        return sizeof(float) * tileSize * tileSize;
+    }
+}
+
+#endif // TERRAINFILE_H
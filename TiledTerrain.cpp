@@ -0,0 +1,288 @@
+#include "TiledTerrain.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "MemoryAccounting.h"
+
+using namespace std;
+using namespace TerrainFile;
+
+
+namespace
+{
+    bool readHeader(int file, Header& header)
+    {
+        return pread(file, &header, sizeof(header), 0) == sizeof(header) &&
+               memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+               header.version == VERSION &&
+               header.width > 0 && header.height > 0 && header.tileSize > 0;
+    }
+}
+
+
+TiledTerrain::TiledTerrain(const std::string& fileName) :
+    _file(open(fileName.c_str(), O_RDONLY)),
+    _header(),
+    _pageSize(sysconf(_SC_PAGESIZE)),
+    _tiles(),
+    _mapped(),
+    _isRetained(),
+    _retained(),
+    _isQueued(),
+    _mutex(),
+    _wakeUp(),
+    _queue(),
+    _prefetcher(),
+    _isStopping(false),
+    _missCount(0),
+    _prefetchCount(0)
+{
+    if(_file < 0)
+        throw runtime_error("Could not open terrain " + fileName);
+
+    struct stat status;
+    if(!readHeader(_file, _header) || fstat(_file, &status) != 0 ||
+       static_cast<uint64_t>(status.st_size) <
+            _header.tileOffset + _header.tileStride * tileCount())
+    {
+        close(_file);
+        throw runtime_error("Not a tiled terrain or truncated: " + fileName);
+    }
+
+    _tiles.reset(new atomic<const float*>[tileCount()]);
+    for(int t=0; t < tileCount(); ++t)
+        _tiles[t].store(nullptr, memory_order_relaxed);
+    _isRetained.assign(tileCount(), 0);
+    _isQueued.assign(tileCount(), 0);
+
+    _prefetcher = thread(&TiledTerrain::prefetchTiles, this);
+}
+
+TiledTerrain::~TiledTerrain()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _isStopping = true;
+    }
+    _wakeUp.notify_one();
+    _prefetcher.join();
+
+    while(!_mapped.empty())
+        unmap(_mapped.back());
+    close(_file);
+}
+
+bool TiledTerrain::readSize(const std::string& fileName, int& width, int& height)
+{
+    int file = open(fileName.c_str(), O_RDONLY);
+    if(file < 0)
+        return false;
+
+    Header header;
+    bool isTerrain = readHeader(file, header);
+    close(file);
+
+    if(isTerrain)
+    {
+        width = header.width;
+        height = header.height;
+    }
+    return isTerrain;
+}
+
+float TiledTerrain::groundHeight(float x, float y) const
+{
+    int i = min(max(static_cast<int>(x * _header.width + 0.5f), 0), _header.width - 1);
+    int j = min(max(static_cast<int>(y * _header.height + 0.5f), 0), _header.height - 1);
+    return groundHeight(i, j);
+}
+
+void TiledTerrain::retain(float x0, float y0, float x1, float y1)
+{
+    mark(x0, y0, x1, y1, false);
+}
+
+void TiledTerrain::prefetch(float x0, float y0, float x1, float y1)
+{
+    mark(x0, y0, x1, y1, true);
+    _wakeUp.notify_one();
+}
+
+void TiledTerrain::evict()
+{
+    lock_guard<mutex> lock(_mutex);
+
+    for(size_t m=0; m < _mapped.size();)
+    {
+        if(_isRetained[_mapped[m]])
+            ++m;
+        else
+            unmap(_mapped[m]);
+    }
+
+    for(size_t r=0; r < _retained.size(); ++r)
+        _isRetained[_retained[r]] = 0;
+    _retained.clear();
+}
+
+int TiledTerrain::mappedCount() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return static_cast<int>(_mapped.size());
+}
+
+size_t TiledTerrain::mappedBytes() const
+{
+    return mappedCount() * tileBytes(_header.tileSize);
+}
+
+const float* TiledTerrain::map(int t) const
+{
+    lock_guard<mutex> lock(_mutex);
+
+    // Mapped by another thread while we were waiting
+    const float* data = _tiles[t].load(memory_order_relaxed);
+    if(data)
+        return data;
+
+    uint64_t start;
+    size_t shift;
+    tileMapping(t, start, shift);
+    size_t length = shift + tileBytes(_header.tileSize);
+
+    void* address = mmap(nullptr, length, PROT_READ, MAP_SHARED, _file, start);
+    if(address == MAP_FAILED)
+        throw runtime_error("Could not map a terrain tile");
+
+    data = reinterpret_cast<const float*>(static_cast<char*>(address) + shift);
+    _tiles[t].store(data, memory_order_release);
+    _mapped.push_back(t);
+    _missCount.fetch_add(1, memory_order_relaxed);
+    getMemoryAccounting().allocate(MemoryAccounting::ESubsystem::TERRAIN,
+                                   tileBytes(_header.tileSize));
+    return data;
+}
+
+void TiledTerrain::unmap(int t)
+{
+    uint64_t start;
+    size_t shift;
+    tileMapping(t, start, shift);
+    size_t length = shift + tileBytes(_header.tileSize);
+
+    const char* data = reinterpret_cast<const char*>(_tiles[t].load(memory_order_relaxed));
+    munmap(const_cast<char*>(data) - shift, length);
+    _tiles[t].store(nullptr, memory_order_relaxed);
+    getMemoryAccounting().release(MemoryAccounting::ESubsystem::TERRAIN,
+                                  tileBytes(_header.tileSize));
+
+    vector<int>::iterator it = find(_mapped.begin(), _mapped.end(), t);
+    *it = _mapped.back();
+    _mapped.pop_back();
+}
+
+void TiledTerrain::tileMapping(int t, uint64_t& start, size_t& shift) const
+{
+    // Offsets of mappings must be multiples of the page size
+    uint64_t offset = _header.tileOffset + _header.tileStride * t;
+    start = offset / _pageSize * _pageSize;
+    shift = offset - start;
+}
+
+void TiledTerrain::tileRange(float x0, float y0, float x1, float y1,
+                             int& tx0, int& ty0, int& tx1, int& ty1) const
+{
+    const float T = static_cast<float>(_header.tileSize);
+    tx0 = max(static_cast<int>(floor(x0 * _header.width / T)), 0);
+    ty0 = max(static_cast<int>(floor(y0 * _header.height / T)), 0);
+    tx1 = min(static_cast<int>(ceil(x1 * _header.width / T)), int(_header.tilesX));
+    ty1 = min(static_cast<int>(ceil(y1 * _header.height / T)), int(_header.tilesY));
+}
+
+void TiledTerrain::mark(float x0, float y0, float x1, float y1, bool isPrefetched)
+{
+    int tx0, ty0, tx1, ty1;
+    tileRange(x0, y0, x1, y1, tx0, ty0, tx1, ty1);
+
+    lock_guard<mutex> lock(_mutex);
+    for(int ty=ty0; ty < ty1; ++ty)
+    {
+        for(int tx=tx0; tx < tx1; ++tx)
+        {
+            int t = ty * _header.tilesX + tx;
+            if(!_isRetained[t])
+            {
+                _isRetained[t] = 1;
+                _retained.push_back(t);
+            }
+
+            if(isPrefetched && !_isQueued[t] &&
+               !_tiles[t].load(memory_order_relaxed))
+            {
+                _isQueued[t] = 1;
+                _queue.push_back(t);
+            }
+        }
+    }
+}
+
+void TiledTerrain::prefetchTiles()
+{
+    unique_lock<mutex> lock(_mutex);
+    while(true)
+    {
+        _wakeUp.wait(lock, [this](){return _isStopping || !_queue.empty();});
+        if(_isStopping)
+            return;
+
+        int t = _queue.front();
+        _queue.pop_front();
+        _isQueued[t] = 0;
+        if(_tiles[t].load(memory_order_relaxed))
+            continue;
+
+        // Mapped and paged in without the lock, which lookups need for
+        // their misses. The tile is only published once it is resident.
+        uint64_t start;
+        size_t shift;
+        tileMapping(t, start, shift);
+        size_t length = shift + tileBytes(_header.tileSize);
+        lock.unlock();
+
+        void* address = mmap(nullptr, length, PROT_READ, MAP_SHARED, _file, start);
+        volatile char sink = 0;
+        if(address != MAP_FAILED)
+        {
+            madvise(address, length, MADV_WILLNEED);
+            for(size_t b=0; b < length; b += _pageSize)
+                sink += static_cast<const char*>(address)[b];
+        }
+        (void)sink;
+
+        lock.lock();
+        if(address == MAP_FAILED)
+            continue;
+
+        // A lookup got there first
+        if(_tiles[t].load(memory_order_relaxed))
+        {
+            munmap(address, length);
+            continue;
+        }
+
+        _tiles[t].store(reinterpret_cast<const float*>(
+            static_cast<char*>(address) + shift), memory_order_release);
+        _mapped.push_back(t);
+        _prefetchCount.fetch_add(1, memory_order_relaxed);
+        getMemoryAccounting().allocate(MemoryAccounting::ESubsystem::TERRAIN,
+                                       tileBytes(_header.tileSize));
+    }
+}
@@ -0,0 +1,130 @@
+#ifndef TILEDTERRAIN_H
+#define TILEDTERRAIN_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "TerrainFile.h"
+
+
+// Ground of a terrain file too large for memory, mapped one tile at a time.
+//
+// Lookups go through the resident tile set and map a missing tile on the
+// spot, so the ground reads the same whether its tile was expected or not.
+// The owner says which regions it needs : retained tiles stay mapped,
+// prefetched ones are mapped and paged in ahead of use by a background I/O
+// thread, and evict() unmaps every tile that was not asked for since the
+// previous eviction.
+//
+// Lookups may come from any thread, but evict() must not run concurrently
+// with them.
+class TiledTerrain
+{
+public:
+    TiledTerrain(const std::string& fileName);
+    ~TiledTerrain();
+
+    static bool readSize(const std::string& fileName, int& width, int& height);
+
+    int width() const;
+    int height() const;
+    int tileSize() const;
+    int tileCount() const;
+
+    // Nearest cell of the terrain at lattice normalized coordinates
+    float groundHeight(float x, float y) const;
+    float groundHeight(int i, int j) const;
+
+    // Regions in lattice normalized coordinates
+    void retain(float x0, float y0, float x1, float y1);
+    void prefetch(float x0, float y0, float x1, float y1);
+    void evict();
+
+    int mappedCount() const;
+    size_t mappedBytes() const;
+    int missCount() const;
+    int prefetchCount() const;
+
+protected:
+    const float* tile(int t) const;
+    const float* map(int t) const;
+    void unmap(int t);
+    void tileMapping(int t, uint64_t& start, size_t& shift) const;
+    void tileRange(float x0, float y0, float x1, float y1,
+                   int& tx0, int& ty0, int& tx1, int& ty1) const;
+    void mark(float x0, float y0, float x1, float y1, bool isPrefetched);
+    void prefetchTiles();
+
+private:
+    int _file;
+    TerrainFile::Header _header;
+    size_t _pageSize;
+
+    std::unique_ptr<std::atomic<const float*>[]> _tiles;
+    mutable std::vector<int> _mapped;
+    std::vector<char> _isRetained;
+    std::vector<int> _retained;
+    std::vector<char> _isQueued;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wakeUp;
+    std::deque<int> _queue;
+    std::thread _prefetcher;
+    bool _isStopping;
+
+    mutable std::atomic<int> _missCount;
+    std::atomic<int> _prefetchCount;
+};
+
+
+
+// IMPLEMENTATION //
+inline int TiledTerrain::width() const
+{
+    return _header.width;
+}
+
+inline int TiledTerrain::height() const
+{
+    return _header.height;
+}
+
+inline int TiledTerrain::tileSize() const
+{
+    return _header.tileSize;
+}
+
+inline int TiledTerrain::tileCount() const
+{
+    return _header.tilesX * _header.tilesY;
+}
+
+inline float TiledTerrain::groundHeight(int i, int j) const
+{
+    const int T = _header.tileSize;
+    return tile((j / T) * _header.tilesX + i / T)[(j % T) * T + i % T];
+}
+
+inline const float* TiledTerrain::tile(int t) const
+{
+    const float* data = _tiles[t].load(std::memory_order_acquire);
+    return data ? data : map(t);
+}
+
+inline int TiledTerrain::missCount() const
+{
+    return _missCount.load(std::memory_order_relaxed);
+}
+
+inline int TiledTerrain::prefetchCount() const
+{
+    return _prefetchCount.load(std::memory_order_relaxed);
+}
+
+#endif // TILEDTERRAIN_H
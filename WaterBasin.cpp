@@ -0,0 +1,90 @@
+#include "WaterBasin.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+
+WaterBasin::WaterBasin() :
+    width(0),
+    height(0),
+    scenario(),
+    priority(0),
+    stepRate(1.0f)
+{
+}
+
+std::vector<WaterBasin> WaterBasin::read(const std::string& fileName,
+                                         const std::string& defaultScenario)
+{
+    ifstream file(fileName.c_str());
+    if(!file)
+        throw runtime_error("Could not open " + fileName);
+
+    vector<WaterBasin> basins;
+    string line;
+    int lineNumber = 0;
+    while(getline(file, line))
+    {
+        ++lineNumber;
+
+        size_t comment = line.find('#');
+        if(comment != string::npos)
+            line.erase(comment);
+
+        istringstream fields(line);
+        WaterBasin basin;
+        basin.scenario = defaultScenario;
+        if(!(fields >> basin.width))
+            continue;
+
+        WaterScenario built;
+        bool ok = fields >> basin.height && basin.width > 0 && basin.height > 0;
+        if(ok && fields >> basin.scenario)
+        {
+            ok = WaterScenario::byName(basin.scenario, built);
+            if(ok && fields >> basin.priority)
+            {
+                if(fields >> basin.stepRate)
+                    ok = basin.stepRate > 0.0f;
+                else
+                    ok = fields.eof();
+            }
+            else
+                ok = ok && fields.eof();
+        }
+
+        if(!ok)
+        {
+            throw runtime_error(fileName + ":" + to_string(lineNumber) +
+                                ": expected 'width height [scenario] "
+                                "[priority] [steps per tick]'");
+        }
+
+        basins.push_back(basin);
+    }
+
+    if(basins.empty())
+        throw runtime_error("No basin in " + fileName);
+    return basins;
+}
+
+WaterOptions WaterBasin::options(const WaterOptions& base, int index) const
+{
+    WaterOptions basinOptions = base;
+    basinOptions.width = width;
+    basinOptions.height = height;
+    basinOptions.scenario = scenario;
+    basinOptions.terrainFile.clear();
+    basinOptions.terrain.reset();
+    basinOptions.adaptiveTimestep = false;
+    basinOptions.autotune = false;
+    basinOptions.frameBudget = 0.0f;
+    basinOptions.recordFile.clear();
+    basinOptions.replayFile.clear();
+    if(!base.publishName.empty())
+        basinOptions.publishName = base.publishName + "_" + to_string(index);
+    return basinOptions;
+}
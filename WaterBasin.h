@@ -0,0 +1,31 @@
+#ifndef WATERBASIN_H
+#define WATERBASIN_H
+
+#include <string>
+#include <vector>
+
+#include "WaterOptions.h"
+
+
+// One of the separate basins of a scene. Basins files list one per line :
+// width height [scenario] [priority] [steps per tick]
+struct WaterBasin
+{
+    WaterBasin();
+
+    // Lines without a width are skipped, '#' starts a comment
+    static std::vector<WaterBasin> read(const std::string& fileName,
+                                        const std::string& defaultScenario);
+
+    // Options of the basin's own simulation over those of the application.
+    // Basins take nominal steps and are neither recorded nor replayed.
+    WaterOptions options(const WaterOptions& base, int index) const;
+
+    int width;
+    int height;
+    std::string scenario;
+    int priority;
+    float stepRate;
+};
+
+#endif // WATERBASIN_H
@@ -0,0 +1,108 @@
+#include "WaterBoundaries.h"
+
+#include <sstream>
+
+using namespace std;
+
+
+namespace
+{
+    bool modeByName(const std::string& name, WaterBoundaries::EBoundary& mode)
+    {
+        if(name == "wall")
+            mode = WaterBoundaries::EBoundary::WALL;
+        else if(name == "periodic")
+            mode = WaterBoundaries::EBoundary::PERIODIC;
+        else if(name == "sponge")
+            mode = WaterBoundaries::EBoundary::SPONGE;
+        else if(name == "inflow")
+            mode = WaterBoundaries::EBoundary::INFLOW;
+        else
+            return false;
+
+        return true;
+    }
+}
+
+
+WaterBoundaries::WaterBoundaries() :
+    spongeWidth(16),
+    spongeDamping(0.1f),
+    spongeRelaxation(0.025f),
+    inflowAmplitude(0.03f),
+    inflowPeriod(120.0f)
+{
+    for(int e=0; e < EDGE_COUNT; ++e)
+        edges[e] = EBoundary::WALL;
+}
+
+std::vector<std::string> WaterBoundaries::names()
+{
+    vector<string> modes;
+    modes.push_back("wall");
+    modes.push_back("periodic");
+    modes.push_back("sponge");
+    modes.push_back("inflow");
+    return modes;
+}
+
+bool WaterBoundaries::byName(const std::string& spec, WaterBoundaries& boundaries)
+{
+    vector<string> names;
+    istringstream fields(spec);
+    string name;
+    while(getline(fields, name, ','))
+        names.push_back(name);
+
+    if(names.size() == 1)
+        names.resize(EDGE_COUNT, names[0]);
+    if(names.size() != EDGE_COUNT)
+        return false;
+
+    WaterBoundaries built = boundaries;
+    for(int e=0; e < EDGE_COUNT; ++e)
+    {
+        if(!modeByName(names[e], built.edges[e]))
+            return false;
+    }
+
+    // Wrapping needs both sides
+    if((built.edges[LEFT] == EBoundary::PERIODIC) !=
+       (built.edges[RIGHT] == EBoundary::PERIODIC) ||
+       (built.edges[BOTTOM] == EBoundary::PERIODIC) !=
+       (built.edges[TOP] == EBoundary::PERIODIC))
+        return false;
+
+    boundaries = built;
+    return true;
+}
+
+bool WaterBoundaries::isWalled() const
+{
+    for(int e=0; e < EDGE_COUNT; ++e)
+    {
+        if(edges[e] != EBoundary::WALL)
+            return false;
+    }
+    return true;
+}
+
+bool WaterBoundaries::hasSponge() const
+{
+    for(int e=0; e < EDGE_COUNT; ++e)
+    {
+        if(edges[e] == EBoundary::SPONGE)
+            return true;
+    }
+    return false;
+}
+
+bool WaterBoundaries::hasInflow() const
+{
+    for(int e=0; e < EDGE_COUNT; ++e)
+    {
+        if(edges[e] == EBoundary::INFLOW)
+            return true;
+    }
+    return false;
+}
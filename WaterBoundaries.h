@@ -0,0 +1,64 @@
+#ifndef WATERBOUNDARIES_H
+#define WATERBOUNDARIES_H
+
+#include <string>
+#include <vector>
+
+
+// Behavior of each edge of the lattice.
+//
+// A wall drops the neighbors past the edge. Periodic edges wrap to the
+// opposite one and come in pairs. A sponge damps the velocities over a
+// layer along the edge and pulls the water back to its initial level, so
+// waves and the water they carry leave instead of coming back. An inflow
+// edge holds its water at the initial level, plus a wave.
+struct WaterBoundaries
+{
+    enum class EBoundary {WALL, PERIODIC, SPONGE, INFLOW};
+    enum EEdge {LEFT, RIGHT, BOTTOM, TOP, EDGE_COUNT};
+
+    WaterBoundaries();
+
+    // One mode for every edge, or four for left,right,bottom,top
+    static std::vector<std::string> names();
+    static bool byName(const std::string& spec, WaterBoundaries& boundaries);
+
+    bool isWall(int edge) const;
+    bool isWalled() const;
+    bool isWrappedX() const;
+    bool isWrappedY() const;
+    bool hasSponge() const;
+    bool hasInflow() const;
+
+    EBoundary edges[EDGE_COUNT];
+
+    // Sponge layer, in cells, with the damping of the velocities and the
+    // part of the excess water let go each step at the edge
+    int spongeWidth;
+    float spongeDamping;
+    float spongeRelaxation;
+
+    // Inflow wave, in nominal steps
+    float inflowAmplitude;
+    float inflowPeriod;
+};
+
+
+
+// IMPLEMENTATION //
+inline bool WaterBoundaries::isWall(int edge) const
+{
+    return edges[edge] == EBoundary::WALL;
+}
+
+inline bool WaterBoundaries::isWrappedX() const
+{
+    return edges[LEFT] == EBoundary::PERIODIC;
+}
+
+inline bool WaterBoundaries::isWrappedY() const
+{
+    return edges[BOTTOM] == EBoundary::PERIODIC;
+}
+
+#endif // WATERBOUNDARIES_H
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <stdexcept>
 
 #include <GL3/gl3w.h>
 
@@ -20,20 +21,13 @@ using namespace scaena;
 WaterCharacter::WaterCharacter(scaena::AbstractStage &stage) :
     AbstractCharacter(stage, "WaterCharacter"),
     _resolution(256, 256),
-    _waterVelocityFbo(0),
-    _waterHeightFbo(0),
-    _waterHeightRead(0),
-    _waterHeightWrite(1),
-    _waterVelocityRead(2),
-    _waterVelocityWrite(3),
-    _groundRead(4),
+    _current(0),
     _latticeVao(0),
     _latticeBuffer(0),
     _latticeIndices(),
     _quadVao(0),
     _quadBuffer(0),
-    _waterVelocityShader(),
-    _waterHeightShader(),
+    _updateShader(),
     _renderShader(),
     _cameraMan( stage.camera() ),
     _fps()
@@ -55,8 +49,7 @@ WaterCharacter::WaterCharacter(scaena::AbstractStage &stage) :
     stage.camera().registerObserver( *this );
 
 
-    glGenFramebuffers(1, &_waterHeightFbo);
-    glGenFramebuffers(1, &_waterVelocityFbo);
+    glGenFramebuffers(2, _updateFbos);
 
     glGenTextures(5, _textures);
 
@@ -74,8 +67,7 @@ WaterCharacter::WaterCharacter(scaena::AbstractStage &stage) :
 WaterCharacter::~WaterCharacter()
 {
     glDeleteTextures(5, _textures);
-    glDeleteFramebuffers(1, &_waterHeightFbo);
-    glDeleteFramebuffers(1, &_waterVelocityFbo);
+    glDeleteFramebuffers(2, _updateFbos);
 
     glDeleteVertexArrays(1, &_latticeVao);
     glDeleteBuffers(1, &_latticeBuffer);
@@ -86,66 +78,60 @@ WaterCharacter::~WaterCharacter()
 
 void WaterCharacter::setupWater()
 {
-    vector<Vec4f> zero;
-    for(int j=0; j<_resolution.y(); ++j)
-        for(int i=0; i<_resolution.x(); ++i)
-            zero.push_back( Vec4f(0.0f, 0.0f, 0.0f, 1.0f) );
-
-    vector<Vec4f> waterHeight;    
-    vector<Vec4f> groundHeight;
+    int cellCount = _resolution.x() * _resolution.y();
+    vector<float> zero(cellCount, 0.0f);
+    vector<float> waterHeight(cellCount);
+    vector<float> groundHeight(cellCount);
     for(int j=0; j<_resolution.y(); ++j)
     {
         for(int i=0; i<_resolution.x(); ++i)
         {
             float x = i/(float)_resolution.x();
             float y = j/(float)_resolution.y();
+            int c = j*_resolution.x() + i;
 
-            float wz = 0.3 + (x < 0.25 ? cos(2*PI*x)*0.3 : 0.0);
-            waterHeight.push_back(Vec4f(x, y, wz, 1.0f));
-
-            float gz = (x > 0.7 && x < 0.8 && (y < 0.3 || y > 0.7)) ? 0.7 : 0.0;
-            groundHeight.push_back(Vec4f(x, y, gz, 1.0f));
+            waterHeight[c] = 0.3 + (x < 0.25 ? cos(2*PI*x)*0.3 : 0.0);
+            groundHeight[c] = (x > 0.7 && x < 0.8 && (y < 0.3 || y > 0.7)) ? 0.7 : 0.0;
         }
     }
 
-    // Height //
-    glBindTexture(GL_TEXTURE_2D, _textures[_groundRead]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _resolution.x(), _resolution.y(), 0, GL_RGBA, GL_FLOAT, groundHeight.data());
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-    glBindTexture(GL_TEXTURE_2D, _textures[_waterHeightRead]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _resolution.x(), _resolution.y(), 0, GL_RGBA, GL_FLOAT, waterHeight.data());
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-    glBindTexture(GL_TEXTURE_2D, _textures[_waterHeightWrite]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _resolution.x(), _resolution.y(), 0, GL_RGBA, GL_FLOAT, waterHeight.data());
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    setupStateTexture(_textures[_GROUND_TEX], groundHeight);
+    setupStateTexture(_textures[_WATER_HEIGHT_TEX],     waterHeight);
+    setupStateTexture(_textures[_WATER_HEIGHT_TEX + 1], waterHeight);
+    setupStateTexture(_textures[_WATER_VELOCITY_TEX],     zero);
+    setupStateTexture(_textures[_WATER_VELOCITY_TEX + 1], zero);
+    glBindTexture(GL_TEXTURE_2D, 0);
 
+    _current = 0;
+    setupUpdateFbos();
+}
 
-    // Velocity
-    glBindTexture(GL_TEXTURE_2D, _textures[_waterVelocityRead]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _resolution.x(), _resolution.y(), 0, GL_RGBA, GL_FLOAT, zero.data());
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-    glBindTexture(GL_TEXTURE_2D, _textures[_waterVelocityWrite]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _resolution.x(), _resolution.y(), 0, GL_RGBA, GL_FLOAT, zero.data());
+void WaterCharacter::setupStateTexture(unsigned int texture, const vector<float>& data)
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, _resolution.x(), _resolution.y(), 0, GL_RED, GL_FLOAT, data.data());
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+}
 
+void WaterCharacter::setupUpdateFbos()
+{
+    // Attachments never change, draw() only picks the fbo of the parity
+    const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    for(int p=0; p < 2; ++p)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, _updateFbos[p]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                               _textures[_WATER_VELOCITY_TEX + 1 - p], 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                               _textures[_WATER_HEIGHT_TEX + 1 - p], 0);
+        glDrawBuffers(2, drawBuffers);
+
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            throw runtime_error("Water update framebuffer is incomplete");
+    }
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
@@ -157,26 +143,20 @@ void WaterCharacter::setupShaders()
     locations.setInput(0, "position_att");
 
 
-    _waterVelocityShader.setInAndOutLocations(locations);
-    _waterVelocityShader.addShader(GL_VERTEX_SHADER, "resources/shaders/waterVelocity.vert");
-    _waterVelocityShader.addShader(GL_FRAGMENT_SHADER, "resources/shaders/waterVelocity.frag");
-    _waterVelocityShader.link();
-    _waterVelocityShader.pushProgram();
-    _waterVelocityShader.setInt("GroundHeightTex",  0);
-    _waterVelocityShader.setInt("WaterHeightTex",   1);
-    _waterVelocityShader.setInt("WaterVelocityTex", 2);
-    _waterVelocityShader.popProgram();
+    GlInputsOutputs updateLocations;
+    updateLocations.setInput(0, "position_att");
+    updateLocations.setOutput(0, "WaterVelocity");
+    updateLocations.setOutput(1, "WaterHeight");
 
-
-    _waterHeightShader.setInAndOutLocations(locations);
-    _waterHeightShader.addShader(GL_VERTEX_SHADER, "resources/shaders/waterHeight.vert");
-    _waterHeightShader.addShader(GL_FRAGMENT_SHADER, "resources/shaders/waterHeight.frag");
-    _waterHeightShader.link();
-    _waterHeightShader.pushProgram();
-    _waterHeightShader.setInt("GroundHeightTex",  0);
-    _waterHeightShader.setInt("WaterHeightTex",   1);
-    _waterHeightShader.setInt("WaterVelocityTex", 2);
-    _waterHeightShader.popProgram();
+    _updateShader.setInAndOutLocations(updateLocations);
+    _updateShader.addShader(GL_VERTEX_SHADER, "resources/shaders/waterUpdate.vert");
+    _updateShader.addShader(GL_FRAGMENT_SHADER, "resources/shaders/waterUpdate.frag");
+    _updateShader.link();
+    _updateShader.pushProgram();
+    _updateShader.setInt("GroundHeightTex",  0);
+    _updateShader.setInt("WaterHeightTex",   1);
+    _updateShader.setInt("WaterVelocityTex", 2);
+    _updateShader.popProgram();
 
 
     _renderShader.setInAndOutLocations(locations);
@@ -292,36 +272,24 @@ void WaterCharacter::draw(const StageTime &time)
     glBindVertexArray(_quadVao);
 
     glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, _textures[_waterVelocityRead]);
+    glBindTexture(GL_TEXTURE_2D, _textures[_WATER_VELOCITY_TEX + _current]);
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, _textures[_waterHeightRead]);
+    glBindTexture(GL_TEXTURE_2D, _textures[_WATER_HEIGHT_TEX + _current]);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, _textures[_groundRead]);
+    glBindTexture(GL_TEXTURE_2D, _textures[_GROUND_TEX]);
 
 
-    // Velocity
-    _waterVelocityShader.pushProgram();
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _waterVelocityFbo);    
-    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _textures[_waterVelocityWrite], 0);
+    // Velocity and height in a single pass
+    _updateShader.pushProgram();
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _updateFbos[_current]);
     glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-    _waterVelocityShader.popProgram();
+    _updateShader.popProgram();
 
-    swap(_waterVelocityRead, _waterVelocityWrite);
+    _current = 1 - _current;
     glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, _textures[_waterVelocityRead]);
-    glActiveTexture(GL_TEXTURE0);
-
-
-    // Height
-    _waterHeightShader.pushProgram();
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _waterHeightFbo);
-    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _textures[_waterHeightWrite], 0);
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
-    _waterHeightShader.popProgram();
-
-    swap(_waterHeightRead, _waterHeightWrite);
+    glBindTexture(GL_TEXTURE_2D, _textures[_WATER_VELOCITY_TEX + _current]);
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, _textures[_waterHeightRead]);
+    glBindTexture(GL_TEXTURE_2D, _textures[_WATER_HEIGHT_TEX + _current]);
     glActiveTexture(GL_TEXTURE0);
 
 
@@ -30,22 +30,23 @@ public:
 
 private:
     void setupWater();
+    void setupStateTexture(unsigned int texture, const std::vector<float>& data);
+    void setupUpdateFbos();
     void setupShaders();
     void setupVaos();
 
 
     cellar::Vec2i _resolution;
 
-    unsigned int _waterVelocityFbo;
-    unsigned int _waterHeightFbo;
+    // Fbo i reads the state of parity i and writes the other one
+    unsigned int _updateFbos[2];
 
+    // Single channel state, the lattice gives x and y
     unsigned int _textures[5];
-
-    int _waterHeightRead;
-    int _waterHeightWrite;
-    int _waterVelocityRead;
-    int _waterVelocityWrite;
-    int _groundRead;
+    static const int _WATER_HEIGHT_TEX = 0;
+    static const int _WATER_VELOCITY_TEX = 2;
+    static const int _GROUND_TEX = 4;
+    int _current;
 
     unsigned int _latticeVao;
     unsigned int _latticeBuffer;
@@ -54,8 +55,7 @@ private:
     unsigned int _quadVao;
     unsigned int _quadBuffer;
 
-    media::GlProgram _waterVelocityShader;
-    media::GlProgram _waterHeightShader;
+    media::GlProgram _updateShader;
     media::GlProgram _renderShader;
 
     media::CameraManFree _cameraMan;
@@ -0,0 +1,194 @@
+#include "WaterDisturber.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <DataStructure/Vector.h>
+
+using namespace std;
+using namespace cellar;
+
+
+const float WaterDisturber::_RAIN_DROP_RADIUS = 0.015f;
+
+
+WaterDisturber::WaterDisturber() :
+    _queue(),
+    _batch(),
+    _emitters(),
+    _groundEdits(),
+    _groundScratch()
+{
+}
+
+const std::vector<WaterDisturbance>& WaterDisturber::drain()
+{
+    _batch.clear();
+    _queue.drain(_batch);
+    return _batch;
+}
+
+void WaterDisturber::apply(WaterSolver& solver)
+{
+    apply(solver, drain());
+}
+
+void WaterDisturber::apply(WaterSolver& solver,
+                           const std::vector<WaterDisturbance>& batch)
+{
+    _groundEdits.clear();
+    for(size_t d=0; d < batch.size(); ++d)
+    {
+        const WaterDisturbance& disturbance = batch[d];
+        if(disturbance.type == WaterDisturbance::EType::DROP)
+            stamp(solver, disturbance.x, disturbance.y,
+                  disturbance.radius, disturbance.amount);
+        else if(disturbance.type == WaterDisturbance::EType::GROUND)
+            editGround(solver, disturbance.x, disturbance.y,
+                       disturbance.radius, disturbance.amount);
+        else
+            start(disturbance);
+    }
+
+    for(size_t e=0; e < _emitters.size(); ++e)
+        emit(_emitters[e], solver);
+
+    // Durations of zero never expire
+    _emitters.erase(remove_if(_emitters.begin(), _emitters.end(),
+        [](const Emitter& e) {return e.disturbance.duration > 0 && e.remaining <= 0;}),
+        _emitters.end());
+}
+
+void WaterDisturber::reset()
+{
+    drain();
+    _emitters.clear();
+    _groundEdits.clear();
+}
+
+void WaterDisturber::start(const WaterDisturbance& disturbance)
+{
+    if(disturbance.type == WaterDisturbance::EType::CLEAR)
+    {
+        _emitters.clear();
+        return;
+    }
+
+    Emitter emitter;
+    emitter.disturbance = disturbance;
+    emitter.remaining = disturbance.duration;
+    emitter.random = disturbance.seed | 1u;
+    _emitters.push_back(emitter);
+}
+
+void WaterDisturber::emit(Emitter& emitter, WaterSolver& solver)
+{
+    // Emitters pour at a steady rate, whatever the length of the step
+    const WaterDisturbance& d = emitter.disturbance;
+    float scale = solver.timeScale();
+    emitter.remaining -= scale;
+
+    if(d.type == WaterDisturbance::EType::RAIN)
+    {
+        // One drop per step, uniformly over the rain disk
+        float angle = random(emitter.random) * 2.0f * PI;
+        float distance = d.radius * sqrt(random(emitter.random));
+        stamp(solver, d.x + cos(angle) * distance, d.y + sin(angle) * distance,
+              _RAIN_DROP_RADIUS, d.amount * scale);
+    }
+    else
+    {
+        stamp(solver, d.x, d.y, d.radius, d.amount * scale);
+    }
+}
+
+void WaterDisturber::stamp(WaterSolver& solver, float x, float y,
+                           float radius, float amount)
+{
+    if(radius <= 0.0f)
+        return;
+
+    // Smooth bump (1 - r^2/R^2)^2, no transcendental in the inner loop
+    float ci = x * solver.width();
+    float cj = y * solver.height();
+    float ri = radius * solver.width();
+    float rj = radius * solver.height();
+    float invRi2 = 1.0f / (ri * ri);
+    float invRj2 = 1.0f / (rj * rj);
+
+    int i0 = max(static_cast<int>(ceil(ci - ri)), solver.storageX0());
+    int j0 = max(static_cast<int>(ceil(cj - rj)), solver.storageY0());
+    int i1 = min(static_cast<int>(floor(ci + ri)) + 1,
+                 solver.storageX0() + solver.storageWidth());
+    int j1 = min(static_cast<int>(floor(cj + rj)) + 1,
+                 solver.storageY0() + solver.storageHeight());
+    if(i0 >= i1 || j0 >= j1)
+        return;
+
+    int count = i1 - i0;
+    for(int j=j0; j < j1; ++j)
+    {
+        float dj = j - cj;
+        float rowDistance2 = dj * dj * invRj2;
+
+        int s = solver.storageIndex(i0, j);
+        float* heights = solver.waterHeights().data() + s;
+        const float* ground = solver.groundHeights().data() + s;
+
+        for(int k=0; k < count; ++k)
+        {
+            float di = (i0 + k) - ci;
+            float weight = max(1.0f - (di * di * invRi2 + rowDistance2), 0.0f);
+            heights[k] = max(heights[k] + amount * weight * weight, ground[k]);
+        }
+    }
+}
+
+void WaterDisturber::editGround(WaterSolver& solver, float x, float y,
+                                float radius, float height)
+{
+    if(radius <= 0.0f)
+        return;
+
+    // Only the bounding box of the disk is rewritten
+    float ci = x * solver.width();
+    float cj = y * solver.height();
+    float ri = radius * solver.width();
+    float rj = radius * solver.height();
+
+    LatticeRegion region;
+    region.i0 = max(static_cast<int>(ceil(ci - ri)), solver.storageX0());
+    region.j0 = max(static_cast<int>(ceil(cj - rj)), solver.storageY0());
+    region.i1 = min(static_cast<int>(floor(ci + ri)) + 1,
+                    solver.storageX0() + solver.storageWidth());
+    region.j1 = min(static_cast<int>(floor(cj + rj)) + 1,
+                    solver.storageY0() + solver.storageHeight());
+    if(region.i0 >= region.i1 || region.j0 >= region.j1)
+        return;
+
+    int count = region.i1 - region.i0;
+    _groundScratch.resize(count * (region.j1 - region.j0));
+    for(int j=region.j0; j < region.j1; ++j)
+    {
+        float dj = (j - cj) / rj;
+        float* row = _groundScratch.data() + (j - region.j0) * count;
+        for(int k=0; k < count; ++k)
+        {
+            float di = (region.i0 + k - ci) / ri;
+            row[k] = di * di + dj * dj <= 1.0f ?
+                height : solver.groundHeight(region.i0 + k, j);
+        }
+    }
+
+    solver.editGround(region, _groundScratch.data());
+    _groundEdits.push_back(region);
+}
+
+float WaterDisturber::random(unsigned int& state)
+{
+    // xorshift32, in [0, 1)
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
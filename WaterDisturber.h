@@ -0,0 +1,74 @@
+#ifndef WATERDISTURBER_H
+#define WATERDISTURBER_H
+
+#include <vector>
+
+#include "DisturbanceQueue.h"
+#include "WaterSolver.h"
+
+
+// Applies the disturbances posted to its queue onto a solver. The queue is
+// drained once per step, before the exchange, and each command is stamped
+// in queue order so a given command stream always gives the same water.
+class WaterDisturber
+{
+public:
+    WaterDisturber();
+
+    DisturbanceQueue& queue();
+    int emitterCount() const;
+
+    // Commands posted since the last drain, in queue order
+    const std::vector<WaterDisturbance>& drain();
+
+    void apply(WaterSolver& solver);
+    void apply(WaterSolver& solver, const std::vector<WaterDisturbance>& batch);
+    void reset();
+
+    // Regions whose ground changed in the last apply, in apply order
+    const std::vector<LatticeRegion>& groundEdits() const;
+
+protected:
+    struct Emitter
+    {
+        WaterDisturbance disturbance;
+        float remaining;
+        unsigned int random;
+    };
+
+    void start(const WaterDisturbance& disturbance);
+    void emit(Emitter& emitter, WaterSolver& solver);
+    void stamp(WaterSolver& solver, float x, float y, float radius, float amount);
+    void editGround(WaterSolver& solver, float x, float y, float radius, float height);
+
+    static float random(unsigned int& state);
+
+private:
+    static const float _RAIN_DROP_RADIUS;
+
+    DisturbanceQueue _queue;
+    std::vector<WaterDisturbance> _batch;
+    std::vector<Emitter> _emitters;
+    std::vector<LatticeRegion> _groundEdits;
+    std::vector<float> _groundScratch;
+};
+
+
+
+// IMPLEMENTATION //
+inline DisturbanceQueue& WaterDisturber::queue()
+{
+    return _queue;
+}
+
+inline int WaterDisturber::emitterCount() const
+{
+    return static_cast<int>(_emitters.size());
+}
+
+inline const std::vector<LatticeRegion>& WaterDisturber::groundEdits() const
+{
+    return _groundEdits;
+}
+
+#endif // WATERDISTURBER_H
@@ -0,0 +1,281 @@
+#include "WaterEnsemble.h"
+#include "WaterOptions.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+
+EnsembleMember::EnsembleMember() :
+    stretchness(WaterOptions::STRETCHNESS),
+    lossyness(WaterOptions::LOSSYNESS),
+    water(WaterScenario::EWater::LINE_WAVE),
+    amplitudeScale(1.0f)
+{
+}
+
+
+WaterEnsemble::WaterEnsemble(int width, int height, int neighborsRadius,
+                             const WaterScenario& groundScenario) :
+    _WIDTH(width),
+    _HEIGHT(height),
+    _NEIGHBORS_RADIUS(neighborsRadius),
+    _GROUND_SCENARIO(groundScenario),
+    _members(),
+    _stride(0),
+    _stepCount(0),
+    _stencil(),
+    _interiorContribution(0.0f),
+    _groundHeights(),
+    _stretchness(),
+    _lossyness(),
+    _initialVolumes(),
+    _current(0),
+    _velocities()
+{
+    _interiorContribution = WaterSolver::buildStencil(
+        _NEIGHBORS_RADIUS, _WIDTH, _stencil);
+}
+
+void WaterEnsemble::addMember(const EnsembleMember& member)
+{
+    _members.push_back(member);
+}
+
+void WaterEnsemble::setup()
+{
+    // Padding lanes stay dry and never move
+    int memberCount = static_cast<int>(_members.size());
+    _stride = (memberCount + _LANES - 1) / _LANES * _LANES;
+    _stepCount = 0;
+    _current = 0;
+
+    int cellCount = _WIDTH * _HEIGHT;
+    _groundHeights.resize(cellCount);
+    _waterHeights[0].assign(cellCount * _stride, 0.0f);
+    _waterHeights[1].assign(cellCount * _stride, 0.0f);
+    _velocities.assign(cellCount * _stride, 0.0f);
+
+    _stretchness.assign(_stride, 0.0f);
+    _lossyness.assign(_stride, 0.0f);
+    for(int m=0; m < memberCount; ++m)
+    {
+        _stretchness[m] = _members[m].stretchness;
+        _lossyness[m] = _members[m].lossyness;
+    }
+
+    for(int j=0; j < _HEIGHT; ++j)
+    {
+        for(int i=0; i < _WIDTH; ++i)
+        {
+            float x = i / static_cast<float>(_WIDTH);
+            float y = j / static_cast<float>(_HEIGHT);
+            int c = j * _WIDTH + i;
+
+            float ground = _GROUND_SCENARIO.groundHeight(x, y);
+            _groundHeights[c] = ground;
+
+            for(int m=0; m < _stride; ++m)
+            {
+                float water = ground;
+                float velocity = 0.0f;
+                if(m < memberCount)
+                {
+                    WaterScenario scenario(_GROUND_SCENARIO.ground,
+                                           _members[m].water,
+                                           _members[m].amplitudeScale);
+                    water = max(scenario.waterHeight(x, y), ground);
+                    velocity = scenario.waterVelocity(x, y);
+                }
+
+                _waterHeights[0][c * _stride + m] = water;
+                _waterHeights[1][c * _stride + m] = water;
+                _velocities[c * _stride + m] = velocity;
+            }
+        }
+    }
+
+    int tapCount = static_cast<int>(_stencil.size());
+    _contribution.resize(tapCount);
+    _overNeighbor.resize(tapCount * _stride);
+    _dzMean.resize(_stride);
+    _totContrib.resize(_stride);
+    _waterMoved.resize(_stride);
+
+    _initialVolumes.resize(memberCount);
+    for(int m=0; m < memberCount; ++m)
+        _initialVolumes[m] = memberVolume(m);
+}
+
+void WaterEnsemble::step()
+{
+    for(int j=0; j < _HEIGHT; ++j)
+    {
+        bool rowInterior = _NEIGHBORS_RADIUS <= j && j < _HEIGHT - _NEIGHBORS_RADIUS;
+        for(int i=0; i < _WIDTH; ++i)
+        {
+            bool interior = rowInterior &&
+                _NEIGHBORS_RADIUS <= i && i < _WIDTH - _NEIGHBORS_RADIUS;
+            exchangeCell(i, j, interior);
+        }
+    }
+
+    _current = 1 - _current;
+    ++_stepCount;
+}
+
+void WaterEnsemble::exchangeCell(int i, int j, bool interior)
+{
+    const int M = _stride;
+    const int tapCount = static_cast<int>(_stencil.size());
+    float* contribution = _contribution.data();
+
+    // Off bounds neighbors do not contribute, same for every member
+    if(interior)
+    {
+        for(int t=0; t < tapCount; ++t)
+            contribution[t] = _stencil[t].baseContribution * _interiorContribution;
+    }
+    else
+    {
+        float totalContribution = 0.0f;
+        for(int t=0; t < tapCount; ++t)
+        {
+            const StencilTap& tap = _stencil[t];
+            bool inBounds = 0 <= i + tap.di && i + tap.di < _WIDTH &&
+                            0 <= j + tap.dj && j + tap.dj < _HEIGHT;
+            contribution[t] = inBounds ? tap.baseContribution : 0.0f;
+            totalContribution += contribution[t];
+        }
+        for(int t=0; t < tapCount; ++t)
+            contribution[t] /= totalContribution;
+    }
+
+    const int c = j * _WIDTH + i;
+    const float g = _groundHeights[c];
+    const float* heights = _waterHeights[_current].data();
+    const float* h = heights + c * M;
+    float* next = _waterHeights[1 - _current].data() + c * M;
+    float* velocities = _velocities.data() + c * M;
+
+    float* dzMean = _dzMean.data();
+    float* totContrib = _totContrib.data();
+    float* waterMoved = _waterMoved.data();
+    const float* stretchness = _stretchness.data();
+    const float* lossyness = _lossyness.data();
+
+    for(int m=0; m < M; ++m)
+    {
+        dzMean[m] = 0.0f;
+        totContrib[m] = 0.0f;
+        waterMoved[m] = 0.0f;
+    }
+
+    for(int t=0; t < tapCount; ++t)
+    {
+        float* overNeighbor = &_overNeighbor[t * M];
+        float w = contribution[t];
+        if(w == 0.0f)
+        {
+            for(int m=0; m < M; ++m)
+                overNeighbor[m] = -1.0f;
+            continue;
+        }
+
+        const int n = c + _stencil[t].offset;
+        const float gn = _groundHeights[n];
+        const float* hn = heights + n * M;
+
+        for(int m=0; m < M; ++m)
+        {
+            float over = max(h[m] - g, 0.0f);
+            float overN = max(hn[m] - gn, 0.0f);
+            float dz = hn[m] - h[m];
+            dzMean[m] += min(max(dz, -over), overN) * w;
+
+            bool isExchangePermitted = (dz != 0.0f) &
+                                      !((dz < 0.0f) & (h[m] <= g)) &
+                                      !((dz > 0.0f) & (hn[m] <= gn));
+            overNeighbor[m] = isExchangePermitted ? overN : -1.0f;
+            totContrib[m] += isExchangePermitted ? w : 0.0f;
+        }
+    }
+
+    // dzMean now holds the water each member wants to move
+    for(int m=0; m < M; ++m)
+    {
+        float over = max(h[m] - g, 0.0f);
+        float velocity = velocities[m];
+        float acc = (dzMean[m] * stretchness[m]) - (velocity * lossyness[m]);
+        dzMean[m] = max(velocity + acc, -over);
+    }
+
+    for(int t=0; t < tapCount; ++t)
+    {
+        const float* overNeighbor = &_overNeighbor[t * M];
+        float w = contribution[t];
+        for(int m=0; m < M; ++m)
+        {
+            float moved = min(dzMean[m] * w / totContrib[m], overNeighbor[m]);
+            waterMoved[m] += overNeighbor[m] < 0.0f ? 0.0f : moved;
+        }
+    }
+
+    for(int m=0; m < M; ++m)
+    {
+        bool isExchangePermitted = totContrib[m] != 0.0f;
+        next[m] = isExchangePermitted ? max(h[m] + waterMoved[m], g) : h[m];
+        velocities[m] = isExchangePermitted ? waterMoved[m] : 0.0f;
+    }
+}
+
+double WaterEnsemble::memberVolume(int member) const
+{
+    double volume = 0.0;
+    const vector<float>& heights = _waterHeights[_current];
+    for(int c=0; c < _WIDTH * _HEIGHT; ++c)
+        volume += max(heights[c * _stride + member] - _groundHeights[c], 0.0f);
+    return volume;
+}
+
+void WaterEnsemble::writeSummaries(std::ostream& out) const
+{
+    out << "member,stretchness,lossyness,water,amplitude,steps,"
+           "volume,volumeDrift,minSurface,maxSurface,maxVelocity" << endl;
+
+    const vector<float>& heights = _waterHeights[_current];
+    for(int m=0; m < memberCount(); ++m)
+    {
+        float minSurface = INFINITY;
+        float maxSurface = -INFINITY;
+        float maxVelocity = 0.0f;
+        for(int c=0; c < _WIDTH * _HEIGHT; ++c)
+        {
+            float h = heights[c * _stride + m];
+            if(h > _groundHeights[c])
+            {
+                minSurface = min(minSurface, h);
+                maxSurface = max(maxSurface, h);
+            }
+            maxVelocity = max(maxVelocity, fabs(_velocities[c * _stride + m]));
+        }
+
+        double volume = memberVolume(m);
+        double drift = _initialVolumes[m] > 0.0 ?
+            (volume - _initialVolumes[m]) / _initialVolumes[m] : 0.0;
+
+        const EnsembleMember& member = _members[m];
+        out << m << ','
+            << member.stretchness << ','
+            << member.lossyness << ','
+            << WaterScenario::waterName(member.water) << ','
+            << member.amplitudeScale << ','
+            << _stepCount << ','
+            << volume << ','
+            << drift << ','
+            << minSurface << ','
+            << maxSurface << ','
+            << maxVelocity << endl;
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef WATERENSEMBLE_H
+#define WATERENSEMBLE_H
+
+#include <vector>
+#include <ostream>
+
+#include "WaterScenario.h"
+#include "WaterSolver.h"
+
+
+struct EnsembleMember
+{
+    EnsembleMember();
+
+    float stretchness;
+    float lossyness;
+    WaterScenario::EWater water;
+    float amplitudeScale;
+};
+
+
+// Many independent simulations sharing one ground and one lattice, stepped
+// in lockstep. Member states are interleaved cell by cell, so the members
+// of a cell are contiguous and the inner loops run across SIMD lanes.
+//
+// Each member follows exactly the same arithmetic as WaterSolver.
+class WaterEnsemble
+{
+public:
+    WaterEnsemble(int width, int height, int neighborsRadius,
+                  const WaterScenario& groundScenario);
+
+    void addMember(const EnsembleMember& member);
+    void setup();
+    void step();
+
+    int memberCount() const;
+    int stepCount() const;
+    float waterHeight(int member, int i, int j) const;
+    float velocity(int member, int i, int j) const;
+
+    void writeSummaries(std::ostream& out) const;
+
+protected:
+    double memberVolume(int member) const;
+    void exchangeCell(int i, int j, bool interior);
+
+private:
+    static const int _LANES = 8;
+
+    const int _WIDTH;
+    const int _HEIGHT;
+    const int _NEIGHBORS_RADIUS;
+    const WaterScenario _GROUND_SCENARIO;
+
+    std::vector<EnsembleMember> _members;
+    int _stride;
+    int _stepCount;
+
+    std::vector<StencilTap> _stencil;
+    float _interiorContribution;
+
+    std::vector<float> _groundHeights;
+    std::vector<float> _stretchness;
+    std::vector<float> _lossyness;
+    std::vector<double> _initialVolumes;
+
+    int _current;
+    std::vector<float> _waterHeights[2];
+    std::vector<float> _velocities;
+
+    // Per cell scratch, one row per tap
+    std::vector<float> _contribution;
+    std::vector<float> _overNeighbor;
+    std::vector<float> _dzMean;
+    std::vector<float> _totContrib;
+    std::vector<float> _waterMoved;
+};
+
+
+
+// IMPLEMENTATION //
+inline int WaterEnsemble::memberCount() const
+{
+    return static_cast<int>(_members.size());
+}
+
+inline int WaterEnsemble::stepCount() const
+{
+    return _stepCount;
+}
+
+inline float WaterEnsemble::waterHeight(int member, int i, int j) const
+{
+    return _waterHeights[_current][(j * _WIDTH + i) * _stride + member];
+}
+
+inline float WaterEnsemble::velocity(int member, int i, int j) const
+{
+    return _velocities[(j * _WIDTH + i) * _stride + member];
+}
+
+#endif // WATERENSEMBLE_H
@@ -0,0 +1,325 @@
+#include "WaterOptions.h"
+
+#include <cstring>
+#include <cstdlib>
+
+#include "TiledTerrain.h"
+
+using namespace std;
+
+
+namespace
+{
+    bool readInt(int argc, char** argv, int& a, int& value)
+    {
+        if(a + 1 >= argc)
+            return false;
+
+        char* end = nullptr;
+        value = static_cast<int>(strtol(argv[++a], &end, 10));
+        return *end == '\0' && value > 0;
+    }
+
+    bool readFloat(int argc, char** argv, int& a, float& value)
+    {
+        if(a + 1 >= argc)
+            return false;
+
+        char* end = nullptr;
+        value = strtof(argv[++a], &end);
+        return *end == '\0' && value > 0.0f;
+    }
+
+    // Tolerances may be zero
+    bool readTolerance(int argc, char** argv, int& a, float& value)
+    {
+        if(a + 1 >= argc)
+            return false;
+
+        char* end = nullptr;
+        value = strtof(argv[++a], &end);
+        return *end == '\0' && value >= 0.0f;
+    }
+
+    bool readString(int argc, char** argv, int& a, std::string& value)
+    {
+        if(a + 1 >= argc)
+            return false;
+
+        value = argv[++a];
+        return !value.empty();
+    }
+}
+
+
+const int WaterOptions::NEIGHBORS_RADIUS = 2;
+const float WaterOptions::STRETCHNESS = 0.35f;
+const float WaterOptions::LOSSYNESS = WaterOptions::STRETCHNESS / 1000.0f;
+
+
+WaterOptions::WaterOptions() :
+    width(128),
+    height(128),
+    stepCount(1000),
+    scenario("line-wave"),
+    terrainFile(),
+    terrain(),
+    adaptiveTimestep(false),
+    boundaries("wall"),
+    autotune(false),
+    frameBudget(0.0f),
+    implicitScale(0.0f),
+    fixedPoint(false),
+    separableRadius(0),
+    tileSize(0),
+    blockSteps(0),
+    probeCount(0),
+    processCount(0),
+    verify(false),
+    ensembleFile(),
+    resultsFile(),
+    reference(false),
+    referenceTolerance(0.0f),
+    basinsFile(),
+    cellBudget(0),
+    recordFile(),
+    replayFile(),
+    headless(false),
+    memoryReport(),
+    publishName(),
+    offscreenDirectory(),
+    frameWidth(800),
+    frameHeight(600),
+    frameCount(250)
+{
+}
+
+bool WaterOptions::parse(int argc, char** argv)
+{
+    // Unknown arguments are left to Qt
+    bool isSized = false;
+    for(int a=1; a < argc; ++a)
+    {
+        bool ok = true;
+
+        if(strcmp(argv[a], "--width") == 0)
+        {
+            ok = readInt(argc, argv, a, width);
+            isSized = true;
+        }
+        else if(strcmp(argv[a], "--height") == 0)
+        {
+            ok = readInt(argc, argv, a, height);
+            isSized = true;
+        }
+        else if(strcmp(argv[a], "--steps") == 0)
+            ok = readInt(argc, argv, a, stepCount);
+        else if(strcmp(argv[a], "--scenario") == 0)
+        {
+            WaterScenario built;
+            ok = readString(argc, argv, a, scenario) &&
+                 WaterScenario::byName(scenario, built);
+        }
+        else if(strcmp(argv[a], "--terrain") == 0)
+            ok = readString(argc, argv, a, terrainFile);
+        else if(strcmp(argv[a], "--adaptive-dt") == 0)
+            adaptiveTimestep = true;
+        else if(strcmp(argv[a], "--boundary") == 0)
+        {
+            WaterBoundaries built;
+            ok = readString(argc, argv, a, boundaries) &&
+                 WaterBoundaries::byName(boundaries, built);
+        }
+        else if(strcmp(argv[a], "--autotune") == 0)
+            autotune = true;
+        else if(strcmp(argv[a], "--frame-budget") == 0)
+            ok = readFloat(argc, argv, a, frameBudget);
+        else if(strcmp(argv[a], "--implicit") == 0)
+            ok = readFloat(argc, argv, a, implicitScale);
+        else if(strcmp(argv[a], "--fixed-point") == 0)
+            fixedPoint = true;
+        else if(strcmp(argv[a], "--separable") == 0)
+            ok = readInt(argc, argv, a, separableRadius);
+        else if(strcmp(argv[a], "--sparse") == 0)
+            ok = readInt(argc, argv, a, tileSize);
+        else if(strcmp(argv[a], "--temporal") == 0)
+            ok = readInt(argc, argv, a, blockSteps);
+        else if(strcmp(argv[a], "--probes") == 0)
+            ok = readInt(argc, argv, a, probeCount);
+        else if(strcmp(argv[a], "--distributed") == 0)
+            ok = readInt(argc, argv, a, processCount);
+        else if(strcmp(argv[a], "--verify") == 0)
+            verify = true;
+        else if(strcmp(argv[a], "--ensemble") == 0)
+            ok = readString(argc, argv, a, ensembleFile);
+        else if(strcmp(argv[a], "--results") == 0)
+            ok = readString(argc, argv, a, resultsFile);
+        else if(strcmp(argv[a], "--reference") == 0)
+        {
+            reference = true;
+            ok = readTolerance(argc, argv, a, referenceTolerance);
+        }
+        else if(strcmp(argv[a], "--basins") == 0)
+            ok = readString(argc, argv, a, basinsFile);
+        else if(strcmp(argv[a], "--budget") == 0)
+            ok = readInt(argc, argv, a, cellBudget);
+        else if(strcmp(argv[a], "--record") == 0)
+            ok = readString(argc, argv, a, recordFile);
+        else if(strcmp(argv[a], "--replay") == 0)
+            ok = readString(argc, argv, a, replayFile);
+        else if(strcmp(argv[a], "--headless") == 0)
+            headless = true;
+        else if(strcmp(argv[a], "--memory-report") == 0)
+            ok = readString(argc, argv, a, memoryReport);
+        else if(strcmp(argv[a], "--publish") == 0)
+            ok = readString(argc, argv, a, publishName) && publishName[0] == '/';
+        else if(strcmp(argv[a], "--offscreen") == 0)
+            ok = readString(argc, argv, a, offscreenDirectory);
+        else if(strcmp(argv[a], "--frame-width") == 0)
+            ok = readInt(argc, argv, a, frameWidth);
+        else if(strcmp(argv[a], "--frame-height") == 0)
+            ok = readInt(argc, argv, a, frameHeight);
+        else if(strcmp(argv[a], "--frames") == 0)
+            ok = readInt(argc, argv, a, frameCount);
+
+        if(!ok)
+            return false;
+    }
+
+    // The lattice takes the size of the terrain
+    if(!terrainFile.empty())
+    {
+        if(isSized || !TiledTerrain::readSize(terrainFile, width, height))
+            return false;
+        terrain.reset(new TiledTerrain(terrainFile));
+    }
+
+    // One run mode at a time, the offscreen frames may follow a replay
+    int modes = int(reference) + int(processCount > 0) +
+                int(implicitScale > 0.0f) + int(fixedPoint) +
+                int(separableRadius > 0) + int(tileSize > 0) +
+                int(blockSteps > 0) + int(probeCount > 0) +
+                int(!basinsFile.empty()) + int(!ensembleFile.empty()) +
+                int(!offscreenDirectory.empty() || !replayFile.empty());
+    if(modes > 1)
+        return false;
+
+    // Steps sliced over frames run on the uniform lattice of a fixed step
+    if(frameBudget > 0.0f && (adaptiveTimestep || !basinsFile.empty()))
+        return false;
+
+    // Runs on lattices of their own only have walls, and periodic edges
+    // need the whole lattice in one process
+    WaterBoundaries edges = initialBoundaries();
+    bool hasOwnLattice = implicitScale > 0.0f || fixedPoint || tileSize > 0 ||
+                         blockSteps > 0 || !ensembleFile.empty();
+    if(!edges.isWalled() && hasOwnLattice)
+        return false;
+    if((edges.isWrappedX() || edges.isWrappedY()) && processCount > 0)
+        return false;
+
+    return true;
+}
+
+WaterScenario WaterOptions::initialScenario() const
+{
+    WaterScenario initial;
+    WaterScenario::byName(scenario, initial);
+    if(!terrainFile.empty())
+    {
+        if(!terrain)
+            terrain.reset(new TiledTerrain(terrainFile));
+        initial.terrain = terrain;
+    }
+    return initial;
+}
+
+WaterBoundaries WaterOptions::initialBoundaries() const
+{
+    WaterBoundaries initial;
+    WaterBoundaries::byName(boundaries, initial);
+    return initial;
+}
+
+std::string WaterOptions::usage()
+{
+    string scenarios;
+    vector<string> names = WaterScenario::names();
+    for(size_t n=0; n < names.size(); ++n)
+        scenarios += (n == 0 ? "" : ", ") + names[n];
+
+    string modes;
+    names = WaterBoundaries::names();
+    for(size_t n=0; n < names.size(); ++n)
+        modes += (n == 0 ? "" : ", ") + names[n];
+
+    return
+        "Options:\n"
+        "  --width N          Lattice width (128)\n"
+        "  --height N         Lattice height (128)\n"
+        "  --steps N          Steps of headless runs (1000)\n"
+        "  --scenario NAME    Initial ground and water (line-wave)\n"
+        "                     One of " + scenarios + "\n"
+        "  --terrain FILE     Ground of a tiled terrain made by TerrainConverter,\n"
+        "                     mapped by tiles, the lattice takes its size and\n"
+        "                     --width and --height are refused\n"
+        "  --adaptive-dt      Step length follows the stability of the surface\n"
+        "  --boundary MODES   Edge modes, one for all or left,right,bottom,top\n"
+        "                     (wall), each one of " + modes + "\n"
+        "                     Refused by the implicit, fixed point, sparse,\n"
+        "                     temporal and ensemble runs, periodic is refused by\n"
+        "                     the distributed run\n"
+        "  --autotune         Time the ways of splitting a step on this host\n"
+        "                     and lattice, the choice is cached for later runs\n"
+        "  --frame-budget MS  Step the lattice by tiles for about MS per frame, a\n"
+        "                     step too long for a frame spreads over several and\n"
+        "                     the last completed one is shown (whole steps),\n"
+        "                     refused with --adaptive-dt and --basins, and off\n"
+        "                     while the adaptive grid (Q) or a recording runs\n"
+        "  --implicit TAU     Headless run of the multigrid implicit solver,\n"
+        "                     TAU nominal steps per step\n"
+        "  --fixed-point      Headless run of the fixed point lattice, which\n"
+        "                     keeps the volume exactly for any thread count\n"
+        "  --separable R      Headless run of neighbors within R through running\n"
+        "                     sums, at a cost per cell that does not grow with R\n"
+        "  --sparse N         Headless run on tiles of NxN cells, allocated\n"
+        "                     where there is water\n"
+        "  --temporal K       Headless fast forward stepping cache sized tiles\n"
+        "                     by blocks of up to K steps\n"
+        "  --probes N         Headless run sampling N probes per batch from\n"
+        "                     another thread while the simulation steps\n"
+        "  --distributed N    Headless run split over N processes\n"
+        "  --verify           Compare an implicit, fixed point, separable, sparse,\n"
+        "                     temporal, distributed or basins run with the explicit\n"
+        "                     single process\n"
+        "  --ensemble FILE    Headless sweep of the members listed in FILE,\n"
+        "                     one per line : stretchness lossyness [water] [amplitude]\n"
+        "  --results FILE     Per member summaries of a sweep (ensemble.csv), or\n"
+        "                     per step divergences of a reference run (reference.csv)\n"
+        "  --reference TOL    Headless run of the optimized backends side by side\n"
+        "                     with the frozen reference step, on every scenario and\n"
+        "                     a few sizes, each stops at a divergence over TOL,\n"
+        "                     0 for identical heights\n"
+        "  --basins FILE      Basins listed in FILE side by side, stepped on one\n"
+        "                     worker pool, one per line : width height [scenario]\n"
+        "                     [priority] [steps per tick]\n"
+        "  --budget N         Cells a tick of the basins steps at most, the lowest\n"
+        "                     priorities wait (no limit)\n"
+        "  --record FILE      Record the input and disturbances of the session\n"
+        "  --replay FILE      Replay a recorded session and report frame times\n"
+        "  --headless         Replay, or run the basins for --steps ticks,\n"
+        "                     without a window\n"
+        "  --memory-report FILE\n"
+        "                     Current and peak bytes of each subsystem, and per\n"
+        "                     cell, written as JSON at the end of the run\n"
+        "  --publish /NAME    Publish each step in a shared memory segment\n"
+        "  --offscreen DIR    Render frames to DIR without a window, following\n"
+        "                     the replayed session if any\n"
+        "  --frame-width N    Width of offscreen frames (800)\n"
+        "  --frame-height N   Height of offscreen frames (600)\n"
+        "  --frames N         Number of offscreen frames (250)\n"
+        "\n"
+        "Runs take one of --reference, --distributed, --implicit, --fixed-point,\n"
+        "--separable, --sparse, --temporal, --probes, --basins, --ensemble, and\n"
+        "--offscreen or --replay or both\n";
+}
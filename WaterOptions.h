@@ -0,0 +1,98 @@
+#ifndef WATEROPTIONS_H
+#define WATEROPTIONS_H
+
+#include <string>
+#include <memory>
+
+#include "WaterBoundaries.h"
+#include "WaterScenario.h"
+
+
+// Command line options of the application
+struct WaterOptions
+{
+    WaterOptions();
+
+    // Physics of the lattice, the same in every mode
+    static const int NEIGHBORS_RADIUS;
+    static const float STRETCHNESS;
+    static const float LOSSYNESS;
+
+    bool parse(int argc, char** argv);
+    static std::string usage();
+
+    // Scenarios share one mapping of the terrain file
+    WaterScenario initialScenario() const;
+    WaterBoundaries initialBoundaries() const;
+
+    int width;
+    int height;
+    int stepCount;
+    std::string scenario;
+    std::string terrainFile;
+    // Mapping of the terrain file, opened by parse or by the first initial
+    // scenario and shared by the copies of the options made after
+    mutable std::shared_ptr<TiledTerrain> terrain;
+    bool adaptiveTimestep;
+    std::string boundaries;
+    bool autotune;
+
+    // Milliseconds of stepping per frame, 0 steps whole steps
+    float frameBudget;
+
+    // Implicit solver, step length in nominal steps
+    float implicitScale;
+
+    // Fixed point lattice
+    bool fixedPoint;
+
+    // Separable stencil, neighbors radius
+    int separableRadius;
+
+    // Sparse storage, tile size in cells
+    int tileSize;
+
+    // Temporal blocking, steps per block
+    int blockSteps;
+
+    // Probe benchmark, probes per batch
+    int probeCount;
+
+    // Distributed mode
+    int processCount;
+    bool verify;
+
+    // Ensemble mode
+    std::string ensembleFile;
+
+    // Per member summaries or per step divergences, each mode has a default
+    std::string resultsFile;
+
+    // Differential run against the reference step, tolerance on the heights
+    // and the volume, zero for identical heights
+    bool reference;
+    float referenceTolerance;
+
+    // Basins mode, cells stepped per tick at most
+    std::string basinsFile;
+    int cellBudget;
+
+    // Session record and replay
+    std::string recordFile;
+    std::string replayFile;
+    bool headless;
+
+    // Bytes per subsystem, written as JSON at the end of the run
+    std::string memoryReport;
+
+    // Shared memory name of the published surface
+    std::string publishName;
+
+    // Offscreen image sequence
+    std::string offscreenDirectory;
+    int frameWidth;
+    int frameHeight;
+    int frameCount;
+};
+
+#endif // WATEROPTIONS_H
@@ -1,14 +1,57 @@
+#include <iostream>
 #include <memory>
 using namespace std;
 
+#include <Stage/Event/StageTime.h>
+
 #include "WaterPlay.h"
 #include "WaterCharacter.h"
 #include "CpuWaterSim.h"
+#include "WaterBasin.h"
+#include "WaterScheduler.h"
+#include "WorkerPool.h"
 using namespace scaena;
 
 
-WaterPlay::WaterPlay() :
-    SingleActPlay("WaterPlay")
+namespace
+{
+    // Ticks the scheduler of the basins once per frame, before the basins
+    // pull their surfaces
+    class BasinTicker : public AbstractCharacter
+    {
+    public:
+        BasinTicker(AbstractStage& stage, const shared_ptr<WaterScheduler>& scheduler) :
+            AbstractCharacter(stage, "BasinTicker"),
+            _scheduler(scheduler)
+        {
+        }
+
+        virtual void enterStage()
+        {
+            _scheduler->clearStats();
+        }
+
+        virtual void beginStep(const StageTime&)
+        {
+            _scheduler->tick();
+        }
+
+        virtual void exitStage()
+        {
+            _scheduler->report(cout);
+        }
+
+    private:
+        shared_ptr<WaterScheduler> _scheduler;
+    };
+}
+
+
+WaterPlay::WaterPlay(const WaterOptions& options) :
+    SingleActPlay("WaterPlay"),
+    _options(options),
+    _basins(),
+    _scheduler()
 {
 }
 
@@ -18,7 +61,24 @@ void WaterPlay::loadExternalRessources()
 
 void WaterPlay::setUpPersistentCharacters()
 {
+    if(_options.basinsFile.empty())
+    {
+        addPersistentCharacter(
+            shared_ptr<AbstractCharacter>(new CpuWaterSim( stage(), _options ))
+        );
+        return;
+    }
+
+    _basins = WaterBasin::read(_options.basinsFile, _options.scenario);
+    _scheduler.reset(new WaterScheduler(getWorkerPool()));
+    _scheduler->setCellBudget(_options.cellBudget);
+
     addPersistentCharacter(
-        shared_ptr<AbstractCharacter>(new CpuWaterSim( stage() ))
+        shared_ptr<AbstractCharacter>(new BasinTicker( stage(), _scheduler ))
     );
+    for(size_t b=0; b < _basins.size(); ++b)
+    {
+        addPersistentCharacter(shared_ptr<AbstractCharacter>(
+            new CpuWaterSim( stage(), _options, *_scheduler, _basins[b], b )));
+    }
 }
@@ -3,14 +3,29 @@
 
 #include <Play/SingleActPlay.h>
 
+#include <memory>
+#include <vector>
+
+#include "WaterBasin.h"
+#include "WaterOptions.h"
+
+class WaterScheduler;
+
 
 class WaterPlay : public scaena::SingleActPlay
 {
 public:
-    WaterPlay();
+    WaterPlay(const WaterOptions& options);
 
     virtual void loadExternalRessources();
     virtual void setUpPersistentCharacters();
+
+private:
+    WaterOptions _options;
+
+    // Basins hosted side by side, stepped by one scheduler
+    std::vector<WaterBasin> _basins;
+    std::shared_ptr<WaterScheduler> _scheduler;
 };
 
 #endif // WATERPLAY_H
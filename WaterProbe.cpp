@@ -0,0 +1,115 @@
+#include "WaterProbe.h"
+
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+using namespace std;
+
+
+WaterSnapshot::WaterSnapshot() :
+    width(0),
+    height(0),
+    stepCount(0),
+    groundRevision(0),
+    waterHeights(),
+    groundHeights(),
+    velocities()
+{
+}
+
+
+void ProbeSamples::resize(size_t count)
+{
+    height.resize(count);
+    depth.resize(count);
+    normalX.resize(count);
+    normalY.resize(count);
+    normalZ.resize(count);
+    velocity.resize(count);
+}
+
+
+void WaterProbe::sample(const WaterSnapshot& snapshot,
+                        const float* x, const float* y, size_t count,
+                        ProbeSamples& samples)
+{
+    assert( snapshot.width >= 2 && snapshot.height >= 2 );
+
+    samples.resize(count);
+    for(size_t first=0; first < count; first += _LANES)
+    {
+        int batch = static_cast<int>(min(count - first, size_t(_LANES)));
+        sampleBatch(snapshot, x + first, y + first, batch, samples, first);
+    }
+}
+
+void WaterProbe::sampleBatch(const WaterSnapshot& snapshot,
+                             const float* x, const float* y, int count,
+                             ProbeSamples& samples, size_t first)
+{
+    const int W = snapshot.width;
+    const int H = snapshot.height;
+    const float* heights = snapshot.waterHeights.data();
+    const float* ground = snapshot.groundHeights->data();
+    const float* velocities = snapshot.velocities.data();
+
+    // Lower left corner of the cell and the weights within it
+    int corner[_LANES];
+    float tx[_LANES];
+    float ty[_LANES];
+    for(int p=0; p < count; ++p)
+    {
+        float fx = min(max(x[p] * W, 0.0f), float(W - 1));
+        float fy = min(max(y[p] * H, 0.0f), float(H - 1));
+        int i = min(static_cast<int>(fx), W - 2);
+        int j = min(static_cast<int>(fy), H - 2);
+        tx[p] = fx - i;
+        ty[p] = fy - j;
+        corner[p] = j * W + i;
+    }
+
+    float h00[_LANES], h10[_LANES], h01[_LANES], h11[_LANES];
+    float g00[_LANES], g10[_LANES], g01[_LANES], g11[_LANES];
+    float v00[_LANES], v10[_LANES], v01[_LANES], v11[_LANES];
+    for(int p=0; p < count; ++p)
+    {
+        int c = corner[p];
+        h00[p] = heights[c];     h10[p] = heights[c + 1];
+        h01[p] = heights[c + W]; h11[p] = heights[c + W + 1];
+        g00[p] = ground[c];      g10[p] = ground[c + 1];
+        g01[p] = ground[c + W];  g11[p] = ground[c + W + 1];
+        v00[p] = velocities[c];     v10[p] = velocities[c + 1];
+        v01[p] = velocities[c + W]; v11[p] = velocities[c + W + 1];
+    }
+
+    float* height = samples.height.data() + first;
+    float* depth = samples.depth.data() + first;
+    float* normalX = samples.normalX.data() + first;
+    float* normalY = samples.normalY.data() + first;
+    float* normalZ = samples.normalZ.data() + first;
+    float* velocity = samples.velocity.data() + first;
+    for(int p=0; p < count; ++p)
+    {
+        float sx = 1.0f - tx[p];
+        float sy = 1.0f - ty[p];
+        float w00 = sx * sy;
+        float w10 = tx[p] * sy;
+        float w01 = sx * ty[p];
+        float w11 = tx[p] * ty[p];
+
+        float h = w00*h00[p] + w10*h10[p] + w01*h01[p] + w11*h11[p];
+        float g = w00*g00[p] + w10*g10[p] + w01*g01[p] + w11*g11[p];
+        height[p] = h;
+        depth[p] = max(h - g, 0.0f);
+        velocity[p] = w00*v00[p] + w10*v10[p] + w01*v01[p] + w11*v11[p];
+
+        // Slopes in world units, cells are 1/W wide
+        float dx = ((h10[p] - h00[p]) * sy + (h11[p] - h01[p]) * ty[p]) * W;
+        float dy = ((h01[p] - h00[p]) * sx + (h11[p] - h10[p]) * tx[p]) * H;
+        float norm = 1.0f / sqrt(dx*dx + dy*dy + 1.0f);
+        normalX[p] = -dx * norm;
+        normalY[p] = -dy * norm;
+        normalZ[p] = norm;
+    }
+}
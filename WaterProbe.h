@@ -0,0 +1,69 @@
+#ifndef WATERPROBE_H
+#define WATERPROBE_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+#include "MemoryAccounting.h"
+
+
+// Copy of the surface after a completed step. Published by the simulation
+// and never modified while a reader holds it, so probes may read it from
+// any thread while the simulation keeps stepping. Snapshots of the same
+// ground revision share their ground.
+struct WaterSnapshot
+{
+    typedef std::vector<float, TrackingAllocator<float,
+                        MemoryAccounting::ESubsystem::SNAPSHOTS>> Array;
+
+    WaterSnapshot();
+
+    int width;
+    int height;
+    unsigned int stepCount;
+    unsigned int groundRevision;
+    Array waterHeights;
+    std::shared_ptr<const Array> groundHeights;
+    Array velocities;
+};
+
+
+// Samples of a batch of probes, one array per quantity
+struct ProbeSamples
+{
+    void resize(size_t count);
+
+    std::vector<float> height;
+    std::vector<float> depth;
+    std::vector<float> normalX;
+    std::vector<float> normalY;
+    std::vector<float> normalZ;
+    std::vector<float> velocity;
+};
+
+
+// Bilinear sampling of a snapshot at world positions, in the space of
+// realPosition : x = i / width, y = j / height. Positions off the lattice
+// are clamped to its border.
+//
+// Probes go by batches of lanes : weights, interpolation and normals are
+// computed a whole batch at a time so they vectorize, only the fetches of
+// the cell corners are scalar.
+class WaterProbe
+{
+public:
+    static void sample(const WaterSnapshot& snapshot,
+                       const float* x, const float* y, size_t count,
+                       ProbeSamples& samples);
+
+protected:
+    static void sampleBatch(const WaterSnapshot& snapshot,
+                            const float* x, const float* y, int count,
+                            ProbeSamples& samples, size_t first);
+
+private:
+    static const int _LANES = 8;
+};
+
+#endif // WATERPROBE_H
@@ -0,0 +1,522 @@
+#include "WaterRenderer.h"
+
+#include <stdexcept>
+
+#include <GL3/gl3w.h>
+
+#include <DataStructure/Vector.h>
+#include <GL/GlToolkit.h>
+
+#include "WorkerPool.h"
+
+
+using namespace std;
+using namespace cellar;
+using namespace media;
+
+
+namespace
+{
+    template<typename Vbo>
+    size_t bufferBytes(const Vbo& buffer)
+    {
+        return buffer.dataArray.size() * sizeof(buffer.dataArray[0]);
+    }
+}
+
+WaterRenderer::WaterRenderer(const WaterSimulation& simulation) :
+    _simulation(simulation),
+    _WIDTH(simulation.width()),
+    _HEIGHT(simulation.height()),
+    _ARRAY_SIZE(_WIDTH * _HEIGHT),
+    _placement(0.0f, 0.0f, 0.0f),
+    _textureImages(),
+    _textureLoads(),
+    _latticeIndices(),
+    _groundTex(0),
+    _groundVao(),
+    _groundMaterial(),
+    _groundRevision(0),
+    _wallsTex(0),
+    _wallsVao(),
+    _wallsMaterial(),
+    _waterTex(0),
+    _waterVao(),
+    _waterPositions(),
+    _waterNormals(),
+    _waterMaterial(),
+    _pointLight(),
+    _renderShader(),
+    _glBytes(0)
+{
+}
+
+WaterRenderer::~WaterRenderer()
+{
+    glDeleteTextures(1, &_groundTex);
+    glDeleteTextures(1, &_wallsTex);
+    glDeleteTextures(1, &_waterTex);
+    getMemoryAccounting().release(MemoryAccounting::ESubsystem::GL_OBJECTS, _glBytes);
+}
+
+void WaterRenderer::placeCamera(Camera& camera)
+{
+    camera.setTripod(Vec3f(2.3f, 1.6f, 1.5f),
+                     Vec3f(0.5f, 0.5f, 0.4f),
+                     Vec3f(0.0f, 0.0f, 1.0f));
+}
+
+void WaterRenderer::orbitCamera(Camera& camera)
+{
+    Vec3f from = camera.tripod().from();
+    Vec3f to = camera.tripod().to();
+    Vec2f radius = rotate(Vec2f(from - to), PI/200.0f);
+    Vec3f newPos(to.x() + radius.x(), to.y() + radius.y(), from.z());
+    camera.setTripod(newPos, to, Vec3f(0.0, 0.0, 1.0));
+}
+
+void WaterRenderer::setup()
+{
+    // Images decode on the pool while the shader compiles, buffers are
+    // filled in parallel and only the uploads run on the GL thread
+    setupLight();
+    loadImages();
+    setupShader();
+    setupLattice();
+    setupGround();
+    setupWalls();
+    setupWater();
+    setupTextures();
+}
+
+void WaterRenderer::setPlacement(const Vec3f& offset)
+{
+    _placement = offset;
+
+    _renderShader.pushProgram();
+    _renderShader.setVec3f("Offset", _placement);
+    _renderShader.popProgram();
+}
+
+void WaterRenderer::update()
+{
+    if(_groundRevision != _simulation.groundRevision())
+        updateGround();
+
+    const FieldArray& heights = _simulation.waterHeights();
+    for(int i=0; i<_ARRAY_SIZE; ++i)
+        _waterPositions[i].setZ(heights[i]);
+
+    // Update normals, across the seam of periodic edges
+    const WaterBoundaries& boundaries = _simulation.boundaries();
+    bool wrapX = boundaries.isWrappedX();
+    bool wrapY = boundaries.isWrappedY();
+    for(int j=0; j<_HEIGHT; ++j)
+    {
+        int jn = wrapY ? (j+1) % _HEIGHT           : clamp(j+1, 0, _HEIGHT-1);
+        int js = wrapY ? (j-1 + _HEIGHT) % _HEIGHT : clamp(j-1, 0, _HEIGHT-1);
+        for(int i=0; i<_WIDTH; ++i)
+        {
+            int ie = wrapX ? (i+1) % _WIDTH          : clamp(i+1, 0, _WIDTH-1);
+            int iw = wrapX ? (i-1 + _WIDTH) % _WIDTH : clamp(i-1, 0, _WIDTH-1);
+            float dx =
+                _waterPositions[index(ie, j)].z() -
+                _waterPositions[index(iw, j)].z();
+            float dy =
+                _waterPositions[index(i, jn)].z() -
+                _waterPositions[index(i, js)].z();
+
+            int currIndex = index(i, j);
+            _waterNormals[currIndex].setX( -dx );
+            _waterNormals[currIndex].setY( -dy );
+        }
+    }
+
+    uploadWater();
+}
+
+void WaterRenderer::updateGround()
+{
+    // Only the rows of the edited regions are uploaded
+    vector<LatticeRegion> regions;
+    if(!_simulation.groundEditsSince(_groundRevision, regions))
+    {
+        LatticeRegion lattice = {0, 0, _WIDTH, _HEIGHT};
+        regions.assign(1, lattice);
+    }
+
+    const FieldArray& ground = _simulation.groundHeights();
+    vector<Vec3f> row;
+    glBindBuffer(GL_ARRAY_BUFFER, _groundVao.bufferId("position"));
+    for(size_t r=0; r < regions.size(); ++r)
+    {
+        const LatticeRegion& region = regions[r];
+        int count = region.i1 - region.i0;
+        row.resize(count);
+        for(int j=region.j0; j < region.j1; ++j)
+        {
+            for(int k=0; k < count; ++k)
+            {
+                float x, y;
+                realPosition(region.i0 + k, j, x, y);
+                row[k](x, y, ground[index(region.i0 + k, j)]);
+            }
+
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(row[0]) * index(region.i0, j),
+                            sizeof(row[0]) * count, row.data());
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    _groundRevision = _simulation.groundRevision();
+}
+
+void WaterRenderer::uploadWater()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, _waterVao.bufferId("position"));
+    glBufferData(GL_ARRAY_BUFFER,  sizeof(_waterPositions[0]) * _waterPositions.size(),
+                 _waterPositions.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, _waterVao.bufferId("normal"));
+    glBufferData(GL_ARRAY_BUFFER,  sizeof(_waterNormals[0]) * _waterNormals.size(),
+                 _waterNormals.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void WaterRenderer::countGlBytes(size_t bytes)
+{
+    _glBytes += bytes;
+    getMemoryAccounting().allocate(MemoryAccounting::ESubsystem::GL_OBJECTS, bytes);
+}
+
+void WaterRenderer::draw()
+{
+    _renderShader.pushProgram();
+
+    _renderShader.setVec4f("material.diffuse",   _groundMaterial.diffuse);
+    _renderShader.setVec4f("material.specular",  _groundMaterial.specular);
+    _renderShader.setFloat("material.shininess", _groundMaterial.shininess);
+    _renderShader.setFloat("material.fresnel",   _groundMaterial.fresnel);
+    glEnable(GL_CULL_FACE);
+    glDisable(GL_BLEND);
+    glBindTexture(GL_TEXTURE_2D, _groundTex);
+    _groundVao.bind();
+    glDrawElements(GL_TRIANGLE_STRIP, _latticeIndices.size(),
+                   GL_UNSIGNED_INT,   _latticeIndices.data());
+
+    _renderShader.setVec4f("material.diffuse",   _wallsMaterial.diffuse);
+    _renderShader.setVec4f("material.specular",  _wallsMaterial.specular);
+    _renderShader.setFloat("material.shininess", _wallsMaterial.shininess);
+    _renderShader.setFloat("material.fresnel",   _wallsMaterial.fresnel);
+    glBindTexture(GL_TEXTURE_2D, _wallsTex);
+    _wallsVao.bind();
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+
+    // South, east and north walls, the open edges have none
+    const WaterBoundaries& boundaries = _simulation.boundaries();
+    const int WALL_EDGES[3] = {
+        WaterBoundaries::BOTTOM, WaterBoundaries::RIGHT, WaterBoundaries::TOP};
+    for(int f=1; f <= 3; ++f)
+    {
+        if(boundaries.isWall(WALL_EDGES[f-1]))
+            glDrawArrays(GL_TRIANGLES, f*6, 6);
+    }
+
+    _renderShader.setVec4f("material.diffuse",   _waterMaterial.diffuse);
+    _renderShader.setVec4f("material.specular",  _waterMaterial.specular);
+    _renderShader.setFloat("material.shininess", _waterMaterial.shininess);
+    _renderShader.setFloat("material.fresnel",   _waterMaterial.fresnel);
+    //glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBindTexture(GL_TEXTURE_2D, _waterTex);
+    _waterVao.bind();
+    glDrawElements(GL_TRIANGLE_STRIP, _latticeIndices.size(),
+                   GL_UNSIGNED_INT,   _latticeIndices.data());
+
+    _renderShader.popProgram();
+}
+
+void WaterRenderer::notify(CameraMsg &msg)
+{
+    _renderShader.pushProgram();
+
+    if(msg.change == CameraMsg::EChange::PROJECTION)
+        _renderShader.setMat4f("Projection", msg.camera.projectionMatrix());
+    else
+    {
+        _renderShader.setMat4f("View",   msg.camera.viewMatrix());
+        _renderShader.setMat3f("Normal", submat(msg.camera.viewMatrix(), 3, 3));
+        _renderShader.setVec4f("light.position", msg.camera.viewMatrix() * _pointLight.position);
+    }
+
+    _renderShader.popProgram();
+}
+
+void WaterRenderer::setupLattice()
+{
+    // One strip per row, closed by degenerate triangles
+    const int ROW_SIZE = 2 * _WIDTH + 2;
+    _latticeIndices.resize((_HEIGHT-1) * ROW_SIZE);
+
+    getWorkerPool().parallelFor(0, _HEIGHT-1, [&](int j0, int j1)
+    {
+        for(int j=j0; j<j1; ++j)
+        {
+            unsigned int* row = &_latticeIndices[j * ROW_SIZE];
+            row[0] = j * _WIDTH;
+            for(int i=0; i<_WIDTH; ++i)
+            {
+                row[1 + 2*i] = j     * _WIDTH + i;
+                row[2 + 2*i] = (j+1) * _WIDTH + i;
+            }
+            row[ROW_SIZE-1] = (j+2) * _WIDTH-1;
+        }
+    });
+}
+
+void WaterRenderer::setupGround()
+{
+    GlVbo3Df positionBuff;
+    positionBuff.attribLocation = _renderShader.getAttributeLocation("position");
+    positionBuff.dataArray.resize(_ARRAY_SIZE);
+
+    GlVbo3Df normalBuff;
+    normalBuff.attribLocation = _renderShader.getAttributeLocation("normal");
+    normalBuff.dataArray.resize(_ARRAY_SIZE);
+
+    GlVbo2Df texCoordBuff;
+    texCoordBuff.attribLocation = _renderShader.getAttributeLocation("texCoord");
+    texCoordBuff.dataArray.resize(_ARRAY_SIZE);
+
+    getWorkerPool().parallelFor(0, _HEIGHT, [&](int j0, int j1)
+    {
+        for(int j=j0; j<j1; ++j)
+        {
+            for(int i=0; i<_WIDTH; ++i)
+            {
+                float x, y;
+                realPosition(i, j, x, y);
+                int currIndex = index(i, j);
+
+                positionBuff.dataArray[currIndex](x, y, _simulation.scenario().groundHeight(x, y));
+                normalBuff  .dataArray[currIndex](0.0f, 0.0f, 2.0f / _WIDTH);
+                texCoordBuff.dataArray[currIndex](x, y);
+            }
+        }
+    });
+
+    _groundVao.createBuffer("position", positionBuff);
+    _groundVao.createBuffer("normal",   normalBuff);
+    _groundVao.createBuffer("texCoord", texCoordBuff);
+    countGlBytes(bufferBytes(positionBuff) + bufferBytes(normalBuff) +
+                 bufferBytes(texCoordBuff));
+    _groundRevision = _simulation.groundRevision();
+
+    _groundMaterial.diffuse(1.0f, 1.0f, 1.0f, 1.0f);
+    _groundMaterial.specular(0.0f, 0.0f, 0.0f, 0.0f);
+    _groundMaterial.shininess = 0.0f;
+    _groundMaterial.fresnel = 0.05f;
+}
+
+void WaterRenderer::setupWalls()
+{
+    const int NB_FACES = 6;
+    const int NB_VERT_FACE = 6;
+    const int NB_VERTICIES = NB_FACES * NB_VERT_FACE;
+
+    GlVbo3Df positionBuff;
+    positionBuff.attribLocation = _renderShader.getAttributeLocation("position");
+    positionBuff.dataArray.resize(NB_VERTICIES);
+
+    GlVbo3Df normalBuff;
+    normalBuff.attribLocation = _renderShader.getAttributeLocation("normal");
+    normalBuff.dataArray.resize(NB_VERTICIES);
+
+    GlVbo2Df texCoordBuff;
+    texCoordBuff.attribLocation = _renderShader.getAttributeLocation("texCoord");
+    texCoordBuff.dataArray.resize(NB_VERTICIES);
+
+    Vec3f faceU[NB_FACES] = {
+        Vec3f(0.5f, 0.0f, 0.0f), // Down
+        Vec3f(-.5f, 0.0f, 0.0f), // South
+        Vec3f(0.0f, -.5f, 0.0f), // East
+        Vec3f(0.5f, 0.0f, 0.0f), // North
+        Vec3f(0.0f, 0.5f, 0.0f), // West
+        Vec3f(0.5f, 0.0f, 0.0f)  // Up
+    };
+    Vec3f faceV[NB_FACES] = {
+        Vec3f(0.0f, 0.5f, 0.0f),
+        Vec3f(0.0f, 0.0f, 0.5f),
+        Vec3f(0.0f, 0.0f, 0.5f),
+        Vec3f(0.0f, 0.0f, 0.5f),
+        Vec3f(0.0f, 0.0f, 0.5f),
+        Vec3f(0.0f, -.5f, 0.0f)
+    };
+    Vec3f faceCenter[NB_FACES] = {
+        Vec3f(0.5f, 0.5f, 0.0f),
+        Vec3f(0.5f, 0.0f, 0.5f),
+        Vec3f(1.0f, 0.5f, 0.5f),
+        Vec3f(0.5f, 1.0f, 0.5f),
+        Vec3f(0.0f, 0.5f, 0.5f),
+        Vec3f(0.5f, 0.5f, 1.0f)
+    };
+    Vec3f faceNormal[NB_FACES] = {
+        Vec3f(0.0f, 0.0f, 1.0f),
+        Vec3f(0.0f, 1.0f, 0.0f),
+        Vec3f(-1.f, 0.0f, 0.0f),
+        Vec3f(0.0f, -1.f, 0.0f),
+        Vec3f(1.0f, 0.0f, 0.0f),
+        Vec3f(0.0f, 0.0f, -1.f)
+    };
+
+    for(int f=0; f<NB_FACES; ++f)
+    {
+        positionBuff.dataArray[f*NB_VERT_FACE + 0] = faceCenter[f] - faceU[f] - faceV[f];
+        positionBuff.dataArray[f*NB_VERT_FACE + 1] = faceCenter[f] + faceU[f] - faceV[f];
+        positionBuff.dataArray[f*NB_VERT_FACE + 2] = faceCenter[f] + faceU[f] + faceV[f];
+        positionBuff.dataArray[f*NB_VERT_FACE + 3] = faceCenter[f] + faceU[f] + faceV[f];
+        positionBuff.dataArray[f*NB_VERT_FACE + 4] = faceCenter[f] - faceU[f] + faceV[f];
+        positionBuff.dataArray[f*NB_VERT_FACE + 5] = faceCenter[f] - faceU[f] - faceV[f];
+
+        normalBuff.dataArray[f*NB_VERT_FACE + 0] = faceNormal[f];
+        normalBuff.dataArray[f*NB_VERT_FACE + 1] = faceNormal[f];
+        normalBuff.dataArray[f*NB_VERT_FACE + 2] = faceNormal[f];
+        normalBuff.dataArray[f*NB_VERT_FACE + 3] = faceNormal[f];
+        normalBuff.dataArray[f*NB_VERT_FACE + 4] = faceNormal[f];
+        normalBuff.dataArray[f*NB_VERT_FACE + 5] = faceNormal[f];
+
+        texCoordBuff.dataArray[f*NB_VERT_FACE + 0] = Vec2f(0.0f, 0.0f);
+        texCoordBuff.dataArray[f*NB_VERT_FACE + 1] = Vec2f(4.0f, 0.0f);
+        texCoordBuff.dataArray[f*NB_VERT_FACE + 2] = Vec2f(4.0f, 1.0f);
+        texCoordBuff.dataArray[f*NB_VERT_FACE + 3] = Vec2f(4.0f, 1.0f);
+        texCoordBuff.dataArray[f*NB_VERT_FACE + 4] = Vec2f(0.0f, 1.0f);
+        texCoordBuff.dataArray[f*NB_VERT_FACE + 5] = Vec2f(0.0f, 0.0f);
+    }
+
+
+    _wallsVao.createBuffer("position", positionBuff);
+    _wallsVao.createBuffer("normal",   normalBuff);
+    _wallsVao.createBuffer("texCoord", texCoordBuff);
+    countGlBytes(bufferBytes(positionBuff) + bufferBytes(normalBuff) +
+                 bufferBytes(texCoordBuff));
+
+    _wallsMaterial.diffuse(1.0f, 1.0f, 1.0f, 1.0f);
+    _wallsMaterial.specular(0.4f, 0.4f, 0.4f, 1.0f);
+    _wallsMaterial.shininess = 30.0f;
+    _wallsMaterial.fresnel = 0.05f;
+}
+
+void WaterRenderer::setupWater()
+{
+    GlVbo3Df positionBuff;
+    positionBuff.attribLocation = _renderShader.getAttributeLocation("position");
+    positionBuff.dataArray.resize(_ARRAY_SIZE);
+
+    GlVbo3Df normalBuff;
+    normalBuff.attribLocation = _renderShader.getAttributeLocation("normal");
+    normalBuff.dataArray.resize(_ARRAY_SIZE);
+
+    GlVbo2Df texCoordBuff;
+    texCoordBuff.attribLocation = _renderShader.getAttributeLocation("texCoord");
+    texCoordBuff.dataArray.resize(_ARRAY_SIZE);
+
+    getWorkerPool().parallelFor(0, _HEIGHT, [&](int j0, int j1)
+    {
+        for(int j=j0; j<j1; ++j)
+        {
+            for(int i=0; i<_WIDTH; ++i)
+            {
+                float x, y;
+                realPosition(i, j, x, y);
+                int currIndex = index(i, j);
+
+                normalBuff  .dataArray[currIndex](0.0f, 0.0f, 2.0f / _WIDTH);
+                texCoordBuff.dataArray[currIndex](x, y);
+                positionBuff.dataArray[currIndex](x, y, 0.0f);
+            }
+        }
+    });
+
+    _waterPositions.assign(positionBuff.dataArray.begin(), positionBuff.dataArray.end());
+    _waterNormals.assign(normalBuff.dataArray.begin(), normalBuff.dataArray.end());
+
+    _waterVao.createBuffer("position", positionBuff);
+    _waterVao.createBuffer("normal",   normalBuff);
+    _waterVao.createBuffer("texCoord", texCoordBuff);
+    countGlBytes(bufferBytes(positionBuff) + bufferBytes(normalBuff) +
+                 bufferBytes(texCoordBuff));
+
+    _waterMaterial.diffuse(1.0f, 1.0f, 1.0f, 1.0f);
+    _waterMaterial.specular(0.8f, 0.8f, 0.8f, 1.0f);
+    _waterMaterial.shininess = 100.0f;
+    _waterMaterial.fresnel = 0.05f;
+}
+
+void WaterRenderer::setupLight()
+{
+    _pointLight.ambient  = Vec4f(0.02f, 0.02f, 0.02f, 1.0f);
+    _pointLight.diffuse  = Vec4f(0.9f, 0.8f, 0.6f, 1.0f);
+    _pointLight.specular = Vec4f(0.6f, 0.5f, 0.2f, 1.0f);
+    _pointLight.position = Vec4f(0.9f, 0.9f, 0.9f, 1.0f);
+    _pointLight.attenuationCoefs = Vec4f(0.5f, 0.3f, 0.8f, 0.0f);
+}
+
+void WaterRenderer::loadImages()
+{
+    const char* FILES[] = {
+        "resources/textures/dirt.bmp",
+        "resources/textures/woodwall.bmp",
+        "resources/textures/water.bmp"
+    };
+    const int FILE_COUNT = sizeof(FILES) / sizeof(FILES[0]);
+
+    // The image bank is not thread safe, each load fills its own image
+    _textureImages.resize(FILE_COUNT);
+    for(int f=0; f<FILE_COUNT; ++f)
+    {
+        Image* image = &_textureImages[f];
+        string fileName = FILES[f];
+        _textureLoads.push_back(getWorkerPool().submit([image, fileName]()
+        {
+            if(!image->load(fileName))
+                throw runtime_error("Could not load " + fileName);
+        }));
+    }
+}
+
+void WaterRenderer::setupTextures()
+{
+    for(size_t l=0; l<_textureLoads.size(); ++l)
+        _textureLoads[l].get();
+
+    _groundTex = GlToolkit::genTextureId(_textureImages[0]);
+    _wallsTex  = GlToolkit::genTextureId(_textureImages[1]);
+    _waterTex  = GlToolkit::genTextureId(_textureImages[2]);
+
+    // Base levels, as RGBA8
+    for(size_t i=0; i<_textureImages.size(); ++i)
+        countGlBytes(size_t(_textureImages[i].width()) * _textureImages[i].height() * 4);
+
+    _textureLoads.clear();
+    _textureImages.clear();
+}
+
+void WaterRenderer::setupShader()
+{
+    GlInputsOutputs locations;
+    locations.setInput(0, "position");
+    locations.setInput(1, "normal");
+    locations.setInput(2, "texCoord");
+    _renderShader.setInAndOutLocations(locations);
+    _renderShader.addShader(GL_VERTEX_SHADER, "resources/shaders/renderCpu.vert");
+    _renderShader.addShader(GL_FRAGMENT_SHADER, "resources/shaders/renderCpu.frag");
+    _renderShader.link();
+
+    _renderShader.pushProgram();
+    _renderShader.setInt("DiffuseTex", 0);
+    _renderShader.setVec3f("Offset", _placement);
+    _renderShader.setVec4f("light.ambient", _pointLight.ambient);
+    _renderShader.setVec4f("light.diffuse", _pointLight.diffuse);
+    _renderShader.setVec4f("light.specular", _pointLight.specular);
+    _renderShader.setVec4f("light.attenuationCoefs", _pointLight.attenuationCoefs);
+    _renderShader.popProgram();
+}
@@ -0,0 +1,131 @@
+#ifndef WATERRENDERER_H
+#define WATERRENDERER_H
+
+#include <DesignPattern/SpecificObserver.h>
+#include <Camera/Camera.h>
+#include <Light/Light3D.h>
+#include <GL/GlProgram.h>
+#include <GL/GlVao.h>
+
+#include <Image/Image.h>
+
+#include <future>
+#include <vector>
+
+#include "MemoryAccounting.h"
+#include "WaterSimulation.h"
+
+#include <cassert>
+
+
+// Ground, walls and water surface of a simulation. Only needs a current GL
+// context, so the windowed character and the offscreen runs draw the same
+// scene. Observes the camera that views it.
+class WaterRenderer : public cellar::SpecificObserver<media::CameraMsg>
+{
+public:
+    typedef std::vector<cellar::Vec3f, TrackingAllocator<cellar::Vec3f,
+                        MemoryAccounting::ESubsystem::RENDERER>> VertexArray;
+
+    WaterRenderer(const WaterSimulation& simulation);
+    virtual ~WaterRenderer();
+
+    void setup();
+
+    // Moves the whole scene, for simulations drawn side by side. After setup
+    void setPlacement(const cellar::Vec3f& offset);
+
+    // Pulls the current surface of the simulation, and the ground where it
+    // was edited
+    void update();
+    void draw();
+
+    const VertexArray& waterPositions() const;
+
+    // Starting tripod, and one frame of the slow turn around the pool
+    static void placeCamera(media::Camera& camera);
+    static void orbitCamera(media::Camera& camera);
+
+    virtual void notify(media::CameraMsg &msg);
+
+protected:
+    void setupLattice();
+    void setupGround();
+    void setupWalls();
+    void setupWater();
+    void setupLight();
+    void loadImages();
+    void setupTextures();
+    void setupShader();
+
+    void updateGround();
+    void uploadWater();
+    void countGlBytes(size_t bytes);
+
+    int index(int i, int j) const;
+    bool isInBounds(int i, int j) const;
+    void realPosition(int i, int j, float& x, float& y) const;
+
+private:
+    const WaterSimulation& _simulation;
+    const int _WIDTH;
+    const int _HEIGHT;
+    const int _ARRAY_SIZE;
+    cellar::Vec3f _placement;
+
+    std::vector<cellar::Image> _textureImages;
+    std::vector<std::future<void>> _textureLoads;
+
+    std::vector<unsigned int, TrackingAllocator<unsigned int,
+                MemoryAccounting::ESubsystem::RENDERER>> _latticeIndices;
+
+    GLuint _groundTex;
+    media::GlVao _groundVao;
+    media::Material _groundMaterial;
+    unsigned int _groundRevision;
+
+    GLuint _wallsTex;
+    media::GlVao _wallsVao;
+    media::Material _wallsMaterial;
+
+    GLuint _waterTex;
+    media::GlVao _waterVao;
+    VertexArray _waterPositions;
+    VertexArray _waterNormals;
+    media::Material _waterMaterial;
+
+    media::PointLight3D _pointLight;
+    media::GlProgram _renderShader;
+
+    // Buffers and textures held by the GL, as allocated
+    size_t _glBytes;
+};
+
+
+
+// IMPLEMENTATION //
+inline const WaterRenderer::VertexArray& WaterRenderer::waterPositions() const
+{
+    return _waterPositions;
+}
+
+inline int WaterRenderer::index(int i, int j) const
+{
+    assert( isInBounds(i, j) );
+    return j*_WIDTH + i;
+}
+
+inline bool WaterRenderer::isInBounds(int i, int j) const
+{
+    return cellar::inRange(i, 0, _WIDTH-1) &&
+           cellar::inRange(j, 0, _HEIGHT-1);
+}
+
+inline void WaterRenderer::realPosition(int i, int j, float& x, float& y) const
+{
+    assert( isInBounds(i, j) );
+    x = i / static_cast<float>(_WIDTH);
+    y = j / static_cast<float>(_HEIGHT);
+}
+
+#endif // WATERRENDERER_H
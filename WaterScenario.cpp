@@ -0,0 +1,178 @@
+#include "WaterScenario.h"
+
+#include <cmath>
+
+#include <DataStructure/Vector.h>
+
+#include "TiledTerrain.h"
+
+using namespace std;
+using namespace cellar;
+
+
+WaterScenario::WaterScenario() :
+    ground(EGround::CHANNELS),
+    water(EWater::LINE_WAVE),
+    amplitudeScale(1.0f),
+    terrain()
+{
+}
+
+WaterScenario::WaterScenario(EGround ground, EWater water, float amplitudeScale) :
+    ground(ground),
+    water(water),
+    amplitudeScale(amplitudeScale),
+    terrain()
+{
+}
+
+std::vector<std::string> WaterScenario::names()
+{
+    vector<string> builtIns;
+    builtIns.push_back("line-wave");
+    builtIns.push_back("wave-slot");
+    builtIns.push_back("middle-drop");
+    builtIns.push_back("beam");
+    builtIns.push_back("parking");
+    return builtIns;
+}
+
+bool WaterScenario::byName(const std::string& name, WaterScenario& scenario)
+{
+    if(name == "line-wave")
+        scenario = WaterScenario(EGround::CHANNELS, EWater::LINE_WAVE);
+    else if(name == "wave-slot")
+        scenario = WaterScenario(EGround::CHANNELS, EWater::WAVE_SLOT);
+    else if(name == "middle-drop")
+        scenario = WaterScenario(EGround::CHANNELS, EWater::MIDDLE_DROP);
+    else if(name == "beam")
+        scenario = WaterScenario(EGround::BEAM, EWater::MIDDLE_DROP);
+    else if(name == "parking")
+        scenario = WaterScenario(EGround::PARKING, EWater::PARKING);
+    else
+        return false;
+
+    return true;
+}
+
+bool WaterScenario::waterByName(const std::string& name, EWater& water)
+{
+    if(name == "wave-slot")
+        water = EWater::WAVE_SLOT;
+    else if(name == "line-wave")
+        water = EWater::LINE_WAVE;
+    else if(name == "middle-drop")
+        water = EWater::MIDDLE_DROP;
+    else if(name == "parking")
+        water = EWater::PARKING;
+    else
+        return false;
+
+    return true;
+}
+
+std::string WaterScenario::waterName(EWater water)
+{
+    switch(water)
+    {
+    case EWater::WAVE_SLOT :   return "wave-slot";
+    case EWater::LINE_WAVE :   return "line-wave";
+    case EWater::MIDDLE_DROP : return "middle-drop";
+    case EWater::PARKING :     return "parking";
+    }
+
+    return "";
+}
+
+float WaterScenario::groundHeight(float x, float y) const
+{
+    if(terrain)
+        return terrain->groundHeight(x, y);
+
+    switch(ground)
+    {
+    case EGround::FLAT :
+        return 0.1f;
+
+    case EGround::BEAM :
+        if(Vec2f(x, y).distanceTo(0.5f, 0.75f) < 0.1f)
+            return 0.65;
+        return 0.1f;
+
+    case EGround::CHANNELS :
+        if(x < 0.45f || x > 0.55f)
+            return 0.1;
+        if(y < 0.38f || y > 0.62f)
+            return 0.55f;
+        if(y > 0.43f && y < 0.57f)
+            return 0.55f;
+        return 0.1f;
+
+    case EGround::PARKING :
+        if(x>0.3f && x<0.6f &&
+           y>0.2f)
+            return 0.8f;
+
+        if(x <= 0.3f)
+            return 0.4f;
+        if(x >= 0.6f)
+            return 0.1f;
+        return 0.7f-x;
+    }
+
+    return 0.0f;
+}
+
+float WaterScenario::waterHeight(float x, float y) const
+{
+    switch(water)
+    {
+    case EWater::WAVE_SLOT :
+    {
+        float length = 0.1f;
+        if(x < length && y>=0.4f && y<=0.6f)
+            return 0.55f + cos(x/length*PI)*0.15f*amplitudeScale;
+        return 0.4f; //+ SimplexNoise::noise2d(x*20, y*20) * 0.003;
+    }
+
+    case EWater::LINE_WAVE :
+    {
+        const float start = 0.0f;
+        const float length = 0.1f;
+        const float middle = 0.35f;
+        const float amplitude = 0.16f * amplitudeScale;
+
+        float distance = x;
+
+        if(distance < start)
+            return middle + amplitude;
+        if(distance < start + length)
+            return middle + cos(PI*(distance)/length)*amplitude;
+        else
+            return middle - amplitude;
+    }
+
+    case EWater::MIDDLE_DROP :
+    {
+        const float radius = 0.1f;
+        const float amplitude = 0.15f * amplitudeScale;
+        const float middle = 0.5f;
+        float distance = Vec2f(x, y).distanceTo(0.5f, 0.5f);
+        if(distance < radius)
+            return middle + cos(distance*PI/radius)*amplitude;
+        return middle-amplitude;
+    }
+
+    case EWater::PARKING :
+        if(x<=0.3f && y>=0.7f)
+            return (y-0.3f)*amplitudeScale;
+        return 0.0f;
+    }
+
+    return 0.0f;
+}
+
+float WaterScenario::waterVelocity(float, float) const
+{
+    return 0.0f;
+}
@@ -0,0 +1,39 @@
+#ifndef WATERSCENARIO_H
+#define WATERSCENARIO_H
+
+#include <string>
+#include <vector>
+#include <memory>
+
+class TiledTerrain;
+
+
+// Initial ground and water of the basin, in lattice normalized coordinates
+class WaterScenario
+{
+public:
+    enum class EGround {FLAT, BEAM, CHANNELS, PARKING};
+    enum class EWater {WAVE_SLOT, LINE_WAVE, MIDDLE_DROP, PARKING};
+
+    WaterScenario();
+    WaterScenario(EGround ground, EWater water, float amplitudeScale = 1.0f);
+
+    // Built-in scenarios
+    static std::vector<std::string> names();
+    static bool byName(const std::string& name, WaterScenario& scenario);
+    static bool waterByName(const std::string& name, EWater& water);
+    static std::string waterName(EWater water);
+
+    float groundHeight(float x, float y) const;
+    float waterHeight(float x, float y) const;
+    float waterVelocity(float x, float y) const;
+
+    EGround ground;
+    EWater water;
+    float amplitudeScale;
+
+    // Replaces the built-in ground when set
+    std::shared_ptr<TiledTerrain> terrain;
+};
+
+#endif // WATERSCENARIO_H
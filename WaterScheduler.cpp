@@ -0,0 +1,251 @@
+#include "WaterScheduler.h"
+
+#include <cmath>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+#include "WaterSolver.h"
+#include "WorkerPool.h"
+
+using namespace std;
+
+
+WaterScheduler::Listener::~Listener()
+{
+}
+
+WaterScheduler::WaterScheduler(WorkerPool& pool) :
+    _pool(pool),
+    _instances(),
+    _order(),
+    _handout(),
+    _cellBudget(0.0),
+    _bands(),
+    _tickCount(0),
+    _cellUpdates(0.0),
+    _seconds(0.0),
+    _tickTimes("Tick times")
+{
+}
+
+int WaterScheduler::add(WaterSolver& solver, const std::string& name,
+                        int priority, float stepRate, Listener* listener)
+{
+    Instance instance;
+    instance.solver = &solver;
+    instance.listener = listener;
+    instance.name = name;
+    instance.priority = priority;
+    instance.stepRate = stepRate;
+    instance.credit = 0.0f;
+    instance.steps = 0;
+    instance.waits = 0;
+    instance.age = 0;
+    instance.cells = 0.0;
+    _instances.push_back(instance);
+
+    _order.push_back(instanceCount() - 1);
+    setPriority(instanceCount() - 1, priority);
+    return instanceCount() - 1;
+}
+
+void WaterScheduler::setPriority(int instance, int priority)
+{
+    _instances[instance].priority = priority;
+
+    // Instances of the same priority keep the order they were added in
+    stable_sort(_order.begin(), _order.end(), [this](int a, int b) {
+        return _instances[a].priority > _instances[b].priority;});
+}
+
+void WaterScheduler::setStepRate(int instance, float stepRate)
+{
+    _instances[instance].stepRate = stepRate;
+}
+
+void WaterScheduler::setCellBudget(double cells)
+{
+    _cellBudget = cells;
+}
+
+void WaterScheduler::tick()
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    vector<int> granted;
+    int rounds = grantSteps(granted);
+
+    // A step reads the whole previous one, so solvers stepping more than
+    // once per tick do it over successive rounds
+    for(int r=0; r < rounds; ++r)
+        stepRound(granted, r);
+
+    double elapsed = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+    _seconds += elapsed;
+    _tickTimes.add(elapsed);
+    ++_tickCount;
+}
+
+int WaterScheduler::grantSteps(std::vector<int>& granted)
+{
+    granted.assign(_instances.size(), 0);
+
+    double remaining = _cellBudget > 0.0 ?
+        _cellBudget : numeric_limits<double>::infinity();
+    bool isFirstDue = true;
+    int rounds = 0;
+
+    // Priorities raised by the ticks spent waiting
+    _handout = _order;
+    stable_sort(_handout.begin(), _handout.end(), [this](int a, int b) {
+        return _instances[a].priority + _instances[a].age >
+               _instances[b].priority + _instances[b].age;});
+
+    for(size_t o=0; o < _handout.size(); ++o)
+    {
+        Instance& instance = _instances[_handout[o]];
+        if(instance.stepRate == 0.0f)
+            continue;
+
+        float backlog = max(instance.stepRate, 1.0f) * 2.0f;
+        instance.credit = min(instance.credit + instance.stepRate, backlog);
+
+        int due = static_cast<int>(instance.credit);
+        if(due == 0)
+            continue;
+
+        double cells = cellsPerStep(instance);
+        // The forced first step may overdraw the budget, which then stays
+        // empty for the rest of the tick
+        int steps = static_cast<int>(min(double(due), floor(remaining / cells)));
+        steps = max(steps, isFirstDue ? 1 : 0);
+        isFirstDue = false;
+
+        if(steps < due)
+            ++instance.waits;
+        instance.age = steps == 0 ? instance.age + 1 : 0;
+
+        remaining = max(remaining - steps * cells, 0.0);
+        instance.credit -= steps;
+        granted[_handout[o]] = steps;
+        rounds = max(rounds, steps);
+    }
+
+    return rounds;
+}
+
+void WaterScheduler::stepRound(const std::vector<int>& granted, int round)
+{
+    double roundCells = 0.0;
+    for(size_t i=0; i < _instances.size(); ++i)
+        if(granted[i] > round)
+            roundCells += cellsPerStep(_instances[i]);
+
+    for(size_t i=0; i < _instances.size(); ++i)
+        if(granted[i] > round && _instances[i].listener)
+            _instances[i].listener->beforeStep();
+
+    // Bands of about the same size whatever the solver, in priority order
+    // since the pool hands out chunks from the front
+    int participants = _pool.threadCount() + 1;
+    double bandCells = roundCells / (participants * _BANDS_PER_THREAD);
+
+    _bands.clear();
+    for(size_t o=0; o < _order.size(); ++o)
+    {
+        if(granted[_order[o]] <= round)
+            continue;
+
+        WaterSolver& solver = *_instances[_order[o]].solver;
+        int width = solver.ownedX1() - solver.ownedX0();
+        int rows = max(static_cast<int>(bandCells / width),
+                       max(_MIN_BAND_ROWS, 2 * solver.neighborsRadius()));
+
+        for(int j=solver.ownedY0(); j < solver.ownedY1(); j += rows)
+        {
+            Band band;
+            band.solver = &solver;
+            band.j0 = j;
+            band.j1 = min(j + rows, solver.ownedY1());
+            _bands.push_back(band);
+        }
+    }
+
+    _pool.parallelFor(0, static_cast<int>(_bands.size()), [this](int b0, int b1)
+    {
+        for(int b=b0; b < b1; ++b)
+        {
+            const Band& band = _bands[b];
+            band.solver->stepRegion(band.solver->ownedX0(), band.j0,
+                                    band.solver->ownedX1(), band.j1);
+        }
+    });
+
+    for(size_t i=0; i < _instances.size(); ++i)
+    {
+        if(granted[i] <= round)
+            continue;
+
+        Instance& instance = _instances[i];
+        instance.solver->swapBuffers();
+        ++instance.steps;
+        instance.cells += cellsPerStep(instance);
+        if(instance.listener)
+            instance.listener->afterStep();
+    }
+    _cellUpdates += roundCells;
+}
+
+double WaterScheduler::cellsPerStep(const Instance& instance) const
+{
+    const WaterSolver& solver = *instance.solver;
+    return double(solver.ownedX1() - solver.ownedX0()) *
+           (solver.ownedY1() - solver.ownedY0());
+}
+
+double WaterScheduler::cellUpdatesPerSecond() const
+{
+    return _seconds > 0.0 ? _cellUpdates / _seconds : 0.0;
+}
+
+void WaterScheduler::report(std::ostream& out) const
+{
+    out << "Scheduler: " << instanceCount() << " instances on "
+        << _pool.threadCount() + 1 << " thread(s), " << _tickCount
+        << " ticks, " << _cellUpdates << " cell updates in " << _seconds
+        << " s, " << cellUpdatesPerSecond() << " cell updates/s" << endl;
+
+    for(size_t o=0; o < _order.size(); ++o)
+    {
+        const Instance& instance = _instances[_order[o]];
+        const WaterSolver& solver = *instance.solver;
+        out << "  " << instance.name << ": "
+            << solver.ownedX1() - solver.ownedX0() << "x"
+            << solver.ownedY1() - solver.ownedY0()
+            << ", priority " << instance.priority
+            << ", rate " << instance.stepRate
+            << ", " << instance.steps << " steps, "
+            << instance.waits << " ticks waited, "
+            << (_cellUpdates > 0.0 ? instance.cells * 100.0 / _cellUpdates : 0.0)
+            << "% of the cells" << endl;
+    }
+
+    _tickTimes.report(out);
+}
+
+void WaterScheduler::clearStats()
+{
+    for(size_t i=0; i < _instances.size(); ++i)
+    {
+        _instances[i].steps = 0;
+        _instances[i].waits = 0;
+        _instances[i].cells = 0.0;
+    }
+
+    _tickCount = 0;
+    _cellUpdates = 0.0;
+    _seconds = 0.0;
+    _tickTimes.clear();
+}
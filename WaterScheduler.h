@@ -0,0 +1,152 @@
+#ifndef WATERSCHEDULER_H
+#define WATERSCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include "FrameTimeStats.h"
+
+class WaterSolver;
+class WorkerPool;
+
+
+// Steps many solvers, of any size, on one worker pool. Each tick cuts the
+// solvers that are due in bands of about the same number of cells and
+// hands them all to the pool at once, so a small basin does not leave
+// threads idle while a large one steps, and no basin needs its own threads.
+//
+// Step rates are in steps per tick : 0.5 steps every other tick, 2 steps
+// twice. Higher priorities are handed out first and, when the due steps
+// exceed the cell budget, the lowest priorities wait for a later tick.
+// Each tick an instance waits without a single step raises its priority by
+// one in the handout, until it steps again, so every instance with a step
+// rate eventually advances even when the top one uses the whole budget.
+// A waiting solver catches up on at most one tick of steps.
+class WaterScheduler
+{
+public:
+    // Told around each step of an instance, on the thread that ticks. A
+    // simulation applies its disturbances before and publishes after.
+    class Listener
+    {
+    public:
+        virtual ~Listener();
+
+        virtual void beforeStep() = 0;
+        virtual void afterStep() = 0;
+    };
+
+    WaterScheduler(WorkerPool& pool);
+
+    // Solvers and listeners are not owned and must outlive the scheduler
+    int add(WaterSolver& solver, const std::string& name,
+            int priority = 0, float stepRate = 1.0f,
+            Listener* listener = nullptr);
+
+    // A step rate of 0 pauses the instance
+    void setPriority(int instance, int priority);
+    void setStepRate(int instance, float stepRate);
+
+    // Cells stepped per tick at most, 0 for no limit. The first instance of
+    // the handout that is due always steps at least once.
+    void setCellBudget(double cells);
+
+    void tick();
+
+    int instanceCount() const;
+    const std::string& name(int instance) const;
+    int stepCount(int instance) const;
+    int waitCount(int instance) const;
+
+    // Aggregate throughput
+    int tickCount() const;
+    double cellUpdates() const;
+    double seconds() const;
+    double cellUpdatesPerSecond() const;
+
+    void report(std::ostream& out) const;
+    void clearStats();
+
+protected:
+    struct Instance
+    {
+        WaterSolver* solver;
+        Listener* listener;
+        std::string name;
+        int priority;
+        float stepRate;
+        float credit;
+        int steps;
+        int waits;
+        int age;
+        double cells;
+    };
+
+    struct Band
+    {
+        WaterSolver* solver;
+        int j0;
+        int j1;
+    };
+
+    int grantSteps(std::vector<int>& granted);
+    void stepRound(const std::vector<int>& granted, int round);
+    double cellsPerStep(const Instance& instance) const;
+
+private:
+    static const int _BANDS_PER_THREAD = 8;
+    static const int _MIN_BAND_ROWS = 8;
+
+    WorkerPool& _pool;
+    std::vector<Instance> _instances;
+    std::vector<int> _order;
+    std::vector<int> _handout;
+    double _cellBudget;
+
+    std::vector<Band> _bands;
+    int _tickCount;
+    double _cellUpdates;
+    double _seconds;
+    FrameTimeStats _tickTimes;
+};
+
+
+
+// IMPLEMENTATION //
+inline int WaterScheduler::instanceCount() const
+{
+    return static_cast<int>(_instances.size());
+}
+
+inline const std::string& WaterScheduler::name(int instance) const
+{
+    return _instances[instance].name;
+}
+
+inline int WaterScheduler::stepCount(int instance) const
+{
+    return _instances[instance].steps;
+}
+
+inline int WaterScheduler::waitCount(int instance) const
+{
+    return _instances[instance].waits;
+}
+
+inline int WaterScheduler::tickCount() const
+{
+    return _tickCount;
+}
+
+inline double WaterScheduler::cellUpdates() const
+{
+    return _cellUpdates;
+}
+
+inline double WaterScheduler::seconds() const
+{
+    return _seconds;
+}
+
+#endif // WATERSCHEDULER_H
@@ -0,0 +1,435 @@
+#include "WaterSimulation.h"
+
+#include <atomic>
+#include <iostream>
+#include <algorithm>
+
+#include "WaterStepTuner.h"
+#include "WorkerPool.h"
+
+using namespace std;
+
+
+const unsigned int WaterSimulation::_KEPT_GROUND_EDITS = 64;
+const unsigned int WaterSimulation::_SNAPSHOT_POOL_SIZE = 3;
+
+WaterSimulation::WaterSimulation(const WaterOptions& options) :
+    _STRETCHNESS(WaterOptions::STRETCHNESS),
+    _LOSSYNESS(WaterOptions::LOSSYNESS),
+    _WIDTH(options.width),
+    _HEIGHT(options.height),
+    _NEIGHBORS_RADIUS(WaterOptions::NEIGHBORS_RADIUS),
+    _ADAPTIVE_TIMESTEP(options.adaptiveTimestep),
+    _AUTOTUNE(options.autotune),
+    _PUBLISH_NAME(options.publishName),
+    _scenario(options.initialScenario()),
+    _solver(_WIDTH, _HEIGHT, _NEIGHBORS_RADIUS, _STRETCHNESS, _LOSSYNESS),
+    _stepper(),
+    _slicer(getWorkerPool()),
+    _disturber(),
+    _timestep(),
+    _applied(),
+    _disturbanceSeed(1),
+    _groundEdits(),
+    _groundRevision(0),
+    _isAdaptive(false),
+    _adaptiveGrid(_WIDTH, _HEIGHT, _STRETCHNESS, _LOSSYNESS),
+    _adaptiveHeights(),
+    _publisher(),
+    _scheduler(nullptr),
+    _scheduledInstance(-1),
+    _stepRate(0.0f),
+    _stepCount(0),
+    _snapshotReaders(0),
+    _snapshot(),
+    _snapshotPool(),
+    _snapshotGround(),
+    _snapshotGroundRevision(0)
+{
+    // The adaptive grid keeps its walls
+    _solver.setBoundaries(options.initialBoundaries());
+}
+
+void WaterSimulation::schedule(WaterScheduler& scheduler, const std::string& name,
+                               int priority, float stepRate)
+{
+    _scheduler = &scheduler;
+    _stepRate = stepRate;
+    _scheduledInstance = scheduler.add(_solver, name, priority, stepRate, this);
+}
+
+void WaterSimulation::beforeStep()
+{
+    applyDisturbances(_disturber.drain());
+}
+
+void WaterSimulation::afterStep()
+{
+    publish();
+}
+
+void WaterSimulation::reset()
+{
+    // Tuned once, then the stepper places the fields as it fills them
+    bool isTuned = false;
+    if(_AUTOTUNE && !_stepper && !_scheduler)
+    {
+        _stepper.reset(new WaterStepper(WaterStepTuner().tune(_solver, _scenario)));
+        isTuned = true;
+    }
+
+    if(_stepper)
+        _stepper->setupScenario(_solver, _scenario);
+    else
+        _solver.setupScenario(_scenario);
+    _slicer.restart();
+    _slicer.clearStats();
+
+    if(isTuned)
+        _stepper->reportPlacement(_solver);
+
+    if(_ADAPTIVE_TIMESTEP && !_scheduler)
+    {
+        _solver.setBoundTracked(true);
+        _timestep.reset(new WaterTimestep(_solver));
+    }
+    _disturber.reset();
+    _applied.clear();
+    _disturbanceSeed = 1;
+
+    if(_isAdaptive)
+    {
+        _isAdaptive = false;
+        toggleAdaptive();
+    }
+
+    LatticeRegion lattice = {0, 0, _WIDTH, _HEIGHT};
+    recordGroundEdit(lattice);
+
+    // Ground is written whole when the segment is created, then by edits
+    if(!_PUBLISH_NAME.empty() && !_publisher)
+    {
+        _publisher.reset(new SharedHeightPublisher(
+            _PUBLISH_NAME, _WIDTH, _HEIGHT, _solver.groundHeights()));
+        cout << "Publishing the surface as " << _PUBLISH_NAME << endl;
+    }
+
+    _stepCount = 0;
+    publishSnapshot();
+}
+
+void WaterSimulation::step()
+{
+    if(_scheduler && !_isAdaptive)
+        return;
+
+    if(_isAdaptive)
+        stepAdaptive();
+    else if(_timestep)
+        stepTimed(nullptr);
+    else
+        stepLattice(_disturber.drain());
+
+    publish();
+}
+
+bool WaterSimulation::stepSliced(double budget)
+{
+    // Options refuse a frame budget with the adaptive timestep or the
+    // basins, the adaptive grid steps whole and says so when toggled
+    if(_isAdaptive || _timestep || _scheduler)
+    {
+        step();
+        return true;
+    }
+
+    _applied.clear();
+    if(!_slicer.isStepping())
+        applyDisturbances(_disturber.drain());
+
+    if(!_slicer.advance(_solver, budget))
+        return false;
+
+    publish();
+    return true;
+}
+
+void WaterSimulation::replayStep(const std::vector<WaterDisturbance>& disturbances)
+{
+    // Commands posted while replaying are not part of the session
+    _disturber.drain();
+
+    if(_isAdaptive)
+        stepAdaptive();
+    else if(_timestep)
+        stepTimed(&disturbances);
+    else
+        stepLattice(disturbances);
+
+    publish();
+}
+
+void WaterSimulation::publish()
+{
+    ++_stepCount;
+    publishSnapshot();
+
+    if(_publisher)
+        _publisher->publish(waterHeights());
+}
+
+void WaterSimulation::attachSnapshotReader()
+{
+    if(_snapshotReaders++ == 0)
+        publishSnapshot();
+}
+
+void WaterSimulation::detachSnapshotReader()
+{
+    if(--_snapshotReaders != 0)
+        return;
+
+    // Readers that still hold a snapshot keep it alive
+    atomic_store(&_snapshot, shared_ptr<const WaterSnapshot>());
+    _snapshotPool.clear();
+    _snapshotGround.reset();
+}
+
+void WaterSimulation::publishSnapshot()
+{
+    if(_snapshotReaders == 0)
+        return;
+
+    // Readers keep the snapshot they took for as long as they need it. A
+    // pooled snapshot only the pool holds is neither current nor read, and
+    // is filled again
+    shared_ptr<WaterSnapshot> next;
+    for(size_t s=0; s < _snapshotPool.size() && !next; ++s)
+    {
+        if(_snapshotPool[s].use_count() == 1)
+            next = _snapshotPool[s];
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    if(!next)
+    {
+        next = make_shared<WaterSnapshot>();
+        if(_snapshotPool.size() < _SNAPSHOT_POOL_SIZE)
+            _snapshotPool.push_back(next);
+    }
+
+    // The ground is only copied when it was edited
+    if(!_snapshotGround || _snapshotGroundRevision != _groundRevision)
+    {
+        _snapshotGround = make_shared<const WaterSnapshot::Array>(
+            _solver.groundHeights().begin(), _solver.groundHeights().end());
+        _snapshotGroundRevision = _groundRevision;
+    }
+
+    next->width = _WIDTH;
+    next->height = _HEIGHT;
+    next->stepCount = _stepCount;
+    next->groundRevision = _groundRevision;
+    next->groundHeights = _snapshotGround;
+    next->waterHeights.assign(waterHeights().begin(), waterHeights().end());
+    if(_isAdaptive)
+        next->velocities.assign(_WIDTH * _HEIGHT, 0.0f);
+    else
+        next->velocities.assign(_solver.velocities().begin(),
+                                _solver.velocities().end());
+
+    atomic_store(&_snapshot, shared_ptr<const WaterSnapshot>(next));
+}
+
+std::shared_ptr<const WaterSnapshot> WaterSimulation::snapshot() const
+{
+    return atomic_load(&_snapshot);
+}
+
+void WaterSimulation::stepLattice(const std::vector<WaterDisturbance>& disturbances)
+{
+    applyDisturbances(disturbances);
+    stepSolver();
+}
+
+void WaterSimulation::applyDisturbances(const std::vector<WaterDisturbance>& disturbances)
+{
+    _applied = disturbances;
+    _disturber.apply(_solver, _applied);
+    for(size_t e=0; e < _disturber.groundEdits().size(); ++e)
+        recordGroundEdit(_disturber.groundEdits()[e]);
+}
+
+void WaterSimulation::recordGroundEdit(const LatticeRegion& region)
+{
+    if(_publisher)
+        _publisher->publishGround(_solver.groundHeights(), region);
+
+    if(_groundEdits.size() == _KEPT_GROUND_EDITS)
+        _groundEdits.erase(_groundEdits.begin());
+    _groundEdits.push_back(region);
+    ++_groundRevision;
+}
+
+bool WaterSimulation::groundEditsSince(unsigned int revision,
+                                       std::vector<LatticeRegion>& regions) const
+{
+    unsigned int behind = _groundRevision - revision;
+    if(behind > _groundEdits.size())
+        return false;
+
+    regions.assign(_groundEdits.end() - behind, _groundEdits.end());
+    return true;
+}
+
+void WaterSimulation::stepSolver()
+{
+    if(_stepper)
+        _stepper->step(_solver);
+    else
+        _solver.step();
+}
+
+void WaterSimulation::stepTimed(const std::vector<WaterDisturbance>* replayed)
+{
+    _timestep->addTime(1.0f);
+
+    // Frames without a step leave the commands in the queue
+    float scale = _timestep->nextScale(_solver);
+    if(scale == 0.0f)
+    {
+        _applied.clear();
+        return;
+    }
+
+    _solver.setTimeScale(scale);
+    stepLattice(replayed != nullptr ? *replayed : _disturber.drain());
+
+    // Commands land on the first substep, emitters pour on every one
+    vector<WaterDisturbance> none;
+    while((scale = _timestep->nextScale(_solver)) > 0.0f)
+    {
+        _solver.setTimeScale(scale);
+        _disturber.apply(_solver, none);
+        stepSolver();
+    }
+}
+
+void WaterSimulation::stepAdaptive()
+{
+    // Disturbances wait in the queue for the uniform lattice
+    _applied.clear();
+    _adaptiveGrid.step();
+    _adaptiveGrid.resample(_adaptiveHeights);
+}
+
+void WaterSimulation::toggleAdaptive()
+{
+    _isAdaptive = !_isAdaptive;
+    _slicer.restart();
+
+    // The scheduler leaves the lattice alone while the adaptive grid runs
+    if(_scheduler)
+        _scheduler->setStepRate(_scheduledInstance, _isAdaptive ? 0.0f : _stepRate);
+
+    if(_isAdaptive)
+    {
+        _adaptiveGrid.setup(_solver.groundHeights(), _solver.waterHeights());
+        _adaptiveGrid.resample(_adaptiveHeights);
+        cout << "Adaptive grid: " << _adaptiveGrid.leafCount() << " cells" << endl;
+    }
+    else
+    {
+        // Leaves carry momentum on their faces, the lattice restarts at rest
+        _solver.waterHeights() = _adaptiveHeights;
+        fill(_solver.velocities().begin(), _solver.velocities().end(), 0.0f);
+        cout << "Uniform lattice: " << _WIDTH * _HEIGHT << " cells" << endl;
+    }
+}
+
+bool WaterSimulation::keyPress(char key)
+{
+    if(key == 'Q')
+    {
+        toggleAdaptive();
+    }
+    else if(key == 'F')
+    {
+        float x = 0.2f + 0.6f * (_disturbanceSeed % 97) / 97.0f;
+        float y = 0.2f + 0.6f * (_disturbanceSeed % 89) / 89.0f;
+        postDisturbance(WaterDisturbance::drop(x, y, 0.05f, 0.1f));
+    }
+    else if(key == 'R')
+    {
+        postDisturbance(WaterDisturbance::rain(0.5f, 0.5f, 0.4f, 0.03f,
+                                               600, _disturbanceSeed));
+    }
+    else if(key == 'I')
+    {
+        postDisturbance(WaterDisturbance::source(0.05f, 0.5f, 0.04f, 0.002f));
+    }
+    else if(key == 'O')
+    {
+        postDisturbance(WaterDisturbance::sink(0.95f, 0.5f, 0.04f, 0.002f));
+    }
+    else if(key == 'C')
+    {
+        postDisturbance(WaterDisturbance::clear());
+    }
+    else if(key == 'G')
+    {
+        postDisturbance(WaterDisturbance::ground(0.5f, 0.5f, 0.06f, 0.1f));
+    }
+    else if(key == 'B')
+    {
+        float x = 0.2f + 0.6f * (_disturbanceSeed % 83) / 83.0f;
+        float y = 0.2f + 0.6f * (_disturbanceSeed % 79) / 79.0f;
+        postDisturbance(WaterDisturbance::ground(x, y, 0.04f, 0.55f));
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void WaterSimulation::postDisturbance(const WaterDisturbance& disturbance)
+{
+    _disturbanceSeed = _disturbanceSeed * 1103515245u + 12345u;
+
+    if(!_disturber.queue().push(disturbance))
+        cout << "Disturbance queue is full, command dropped" << endl;
+    else if(_isAdaptive)
+        cout << "Disturbances wait for the uniform lattice (Q)" << endl;
+}
+
+int WaterSimulation::cellCount() const
+{
+    if(_isAdaptive)
+        return _adaptiveGrid.leafCount();
+    return _WIDTH * _HEIGHT;
+}
+
+const FieldArray& WaterSimulation::waterHeights() const
+{
+    if(_isAdaptive)
+        return _adaptiveHeights;
+    return _solver.waterHeights();
+}
+
+unsigned int WaterSimulation::checksum() const
+{
+    // FNV-1a over the bits of the surface
+    const FieldArray& heights = waterHeights();
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(heights.data());
+    size_t size = heights.size() * sizeof(float);
+
+    unsigned int hash = 2166136261u;
+    for(size_t b=0; b < size; ++b)
+    {
+        hash ^= bytes[b];
+        hash *= 16777619u;
+    }
+    return hash;
+}
@@ -0,0 +1,200 @@
+#ifndef WATERSIMULATION_H
+#define WATERSIMULATION_H
+
+#include <vector>
+#include <memory>
+
+#include "AdaptiveWaterGrid.h"
+#include "SharedHeightPublisher.h"
+#include "WaterDisturber.h"
+#include "WaterOptions.h"
+#include "WaterProbe.h"
+#include "WaterScenario.h"
+#include "WaterScheduler.h"
+#include "WaterSolver.h"
+#include "WaterStepper.h"
+#include "WaterStepSlicer.h"
+#include "WaterTimestep.h"
+
+
+// Interactive simulation state, without any rendering. Steps either the
+// uniform lattice or the adaptive grid and applies the disturbances, so the
+// windowed character and the headless runs share the same stepping.
+//
+// A simulation may hand its lattice to a scheduler shared with others.
+// The scheduler's ticks then take its steps, step() only steps the
+// adaptive grid, and the lattice takes nominal steps.
+class WaterSimulation : private WaterScheduler::Listener
+{
+public:
+    WaterSimulation(const WaterOptions& options);
+
+    // Before the first reset
+    void schedule(WaterScheduler& scheduler, const std::string& name,
+                  int priority, float stepRate);
+    bool isScheduled() const;
+
+    void reset();
+    void step();
+    void toggleAdaptive();
+
+    // Spreads a step of the lattice over frames : steps tiles for about
+    // budget seconds, true when a step completed. Commands land when a step
+    // starts. The adaptive grid and timestep still step whole.
+    bool stepSliced(double budget);
+    const WaterStepSlicer& slicer() const;
+
+    // Q adaptive grid, F drop, R rain, I inflow, O drain, C clear, G breach
+    // in the middle of the ground, B mound
+    bool keyPress(char key);
+
+    // Applies the given commands instead of the queued ones
+    void replayStep(const std::vector<WaterDisturbance>& disturbances);
+
+    int width() const;
+    int height() const;
+    bool isAdaptive() const;
+    int cellCount() const;
+    const WaterScenario& scenario() const;
+    const WaterBoundaries& boundaries() const;
+
+    // Thread safe, commands are applied at the start of the next step
+    DisturbanceQueue& disturbances();
+    const std::vector<WaterDisturbance>& appliedDisturbances() const;
+
+    // Current surface, in lattice layout
+    const FieldArray& waterHeights() const;
+    const FieldArray& groundHeights() const;
+    unsigned int checksum() const;
+
+    // Counts the edits of the ground, a reset rewrites the whole lattice.
+    // The regions edited after a revision are kept for a while, false when
+    // they are gone and the whole ground must be read again.
+    unsigned int groundRevision() const;
+    bool groundEditsSince(unsigned int revision,
+                          std::vector<LatticeRegion>& regions) const;
+
+    // Snapshots are only taken while a reader is attached. Attach before
+    // the reader's thread starts and detach after it stopped, from the
+    // thread that steps.
+    void attachSnapshotReader();
+    void detachSnapshotReader();
+
+    // Surface of the last completed step, safe to read from any thread
+    std::shared_ptr<const WaterSnapshot> snapshot() const;
+
+protected:
+    void stepSolver();
+    void stepLattice(const std::vector<WaterDisturbance>& disturbances);
+    void applyDisturbances(const std::vector<WaterDisturbance>& disturbances);
+    void stepTimed(const std::vector<WaterDisturbance>* replayed);
+    void stepAdaptive();
+    void postDisturbance(const WaterDisturbance& disturbance);
+    void recordGroundEdit(const LatticeRegion& region);
+
+    virtual void beforeStep();
+    virtual void afterStep();
+    void publish();
+    void publishSnapshot();
+
+private:
+    static const unsigned int _KEPT_GROUND_EDITS;
+    static const unsigned int _SNAPSHOT_POOL_SIZE;
+
+    const float _STRETCHNESS;
+    const float _LOSSYNESS;
+    const int _WIDTH;
+    const int _HEIGHT;
+    const int _NEIGHBORS_RADIUS;
+    const bool _ADAPTIVE_TIMESTEP;
+    const bool _AUTOTUNE;
+    const std::string _PUBLISH_NAME;
+
+    WaterScenario _scenario;
+    WaterSolver _solver;
+    std::unique_ptr<WaterStepper> _stepper;
+    WaterStepSlicer _slicer;
+    WaterDisturber _disturber;
+    std::unique_ptr<WaterTimestep> _timestep;
+    std::vector<WaterDisturbance> _applied;
+    unsigned int _disturbanceSeed;
+    std::vector<LatticeRegion> _groundEdits;
+    unsigned int _groundRevision;
+
+    bool _isAdaptive;
+    AdaptiveWaterGrid _adaptiveGrid;
+    FieldArray _adaptiveHeights;
+
+    std::unique_ptr<SharedHeightPublisher> _publisher;
+
+    WaterScheduler* _scheduler;
+    int _scheduledInstance;
+    float _stepRate;
+
+    unsigned int _stepCount;
+    int _snapshotReaders;
+    std::shared_ptr<const WaterSnapshot> _snapshot;
+    std::vector<std::shared_ptr<WaterSnapshot>> _snapshotPool;
+    std::shared_ptr<const WaterSnapshot::Array> _snapshotGround;
+    unsigned int _snapshotGroundRevision;
+};
+
+
+
+// IMPLEMENTATION //
+inline int WaterSimulation::width() const
+{
+    return _WIDTH;
+}
+
+inline int WaterSimulation::height() const
+{
+    return _HEIGHT;
+}
+
+inline bool WaterSimulation::isScheduled() const
+{
+    return _scheduler != nullptr;
+}
+
+inline bool WaterSimulation::isAdaptive() const
+{
+    return _isAdaptive;
+}
+
+inline const WaterScenario& WaterSimulation::scenario() const
+{
+    return _scenario;
+}
+
+inline const WaterBoundaries& WaterSimulation::boundaries() const
+{
+    return _solver.boundaries();
+}
+
+inline const WaterStepSlicer& WaterSimulation::slicer() const
+{
+    return _slicer;
+}
+
+inline DisturbanceQueue& WaterSimulation::disturbances()
+{
+    return _disturber.queue();
+}
+
+inline const std::vector<WaterDisturbance>& WaterSimulation::appliedDisturbances() const
+{
+    return _applied;
+}
+
+inline const FieldArray& WaterSimulation::groundHeights() const
+{
+    return _solver.groundHeights();
+}
+
+inline unsigned int WaterSimulation::groundRevision() const
+{
+    return _groundRevision;
+}
+
+#endif // WATERSIMULATION_H
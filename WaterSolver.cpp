@@ -0,0 +1,893 @@
+#include "WaterSolver.h"
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include <DataStructure/Vector.h>
+
+#include "WaterScenario.h"
+
+using namespace std;
+using namespace cellar;
+
+
+namespace
+{
+    // Working memory of a step on the calling thread. It only grows, so a
+    // thread allocates it once for the largest stencil and region it steps.
+    struct StepScratch
+    {
+        vector<float> taps;
+        vector<int> neighbors;
+
+        vector<float> mean;
+        vector<float> lowest;
+        vector<float> highest;
+        vector<float> highestGround;
+        vector<float> shallowest;
+        vector<float> line;
+        vector<float> fromStart;
+        vector<float> fromEnd;
+        vector<double> sums;
+    };
+
+    StepScratch& stepScratch(size_t tapCount)
+    {
+        thread_local StepScratch scratch;
+        if(scratch.neighbors.size() < tapCount)
+        {
+            scratch.taps.resize(2 * tapCount);
+            scratch.neighbors.resize(tapCount);
+        }
+        return scratch;
+    }
+
+    // Weights along one axis of three box filters applied in a row
+    vector<float> boxKernel(const int boxRadii[3])
+    {
+        vector<float> kernel(1, 1.0f);
+        for(int b=0; b < 3; ++b)
+        {
+            int width = 2 * boxRadii[b] + 1;
+            vector<float> wider(kernel.size() + width - 1, 0.0f);
+            for(size_t k=0; k < kernel.size(); ++k)
+                for(int d=0; d < width; ++d)
+                    wider[k + d] += kernel[k] / width;
+            kernel.swap(wider);
+        }
+        return kernel;
+    }
+
+    // Taps of the product of a kernel along both axes, returns their total
+    float productTaps(const vector<float>& kernel, int rowStride,
+                      vector<StencilTap>& stencil)
+    {
+        int support = static_cast<int>(kernel.size()) / 2;
+        stencil.clear();
+
+        float totalContribution = 0.0f;
+        for(int dj=-support; dj <= support; ++dj)
+        {
+            for(int di=-support; di <= support; ++di)
+            {
+                // Current node
+                if(di == 0 && dj == 0)
+                    continue;
+
+                StencilTap tap;
+                tap.di = di;
+                tap.dj = dj;
+                tap.offset = dj * rowStride + di;
+                tap.baseContribution = kernel[support + di] * kernel[support + dj];
+                stencil.push_back(tap);
+
+                totalContribution += tap.baseContribution;
+            }
+        }
+
+        return totalContribution;
+    }
+
+    // Second moment along an axis of the neighbor weights, center excluded
+    float spread(const vector<StencilTap>& stencil)
+    {
+        float moment = 0.0f;
+        float total = 0.0f;
+        for(size_t t=0; t < stencil.size(); ++t)
+        {
+            moment += stencil[t].baseContribution * stencil[t].di * stencil[t].di;
+            total += stencil[t].baseContribution;
+        }
+        return moment / total;
+    }
+
+    // Sums of the 2b+1 values centered on each value over 2b+1, along the
+    // rows then along the columns. Values past the ends count as zeros.
+    void boxRows(float* values, int w, int h, int b, vector<float>& line)
+    {
+        const double scale = 1.0 / (2 * b + 1);
+        for(int r=0; r < h; ++r)
+        {
+            float* row = values + r * w;
+            copy(row, row + w, line.begin());
+
+            double sum = 0.0;
+            for(int k=0; k <= b && k < w; ++k)
+                sum += line[k];
+
+            for(int k=0; k < w; ++k)
+            {
+                row[k] = static_cast<float>(sum * scale);
+                if(k + b + 1 < w)
+                    sum += line[k + b + 1];
+                if(k - b >= 0)
+                    sum -= line[k - b];
+            }
+        }
+    }
+
+    void boxColumns(float* values, int w, int h, int b,
+                    vector<double>& sums, vector<float>& result)
+    {
+        const double scale = 1.0 / (2 * b + 1);
+        fill(sums.begin(), sums.begin() + w, 0.0);
+        for(int k=0; k <= b && k < h; ++k)
+        {
+            const float* row = values + k * w;
+            for(int q=0; q < w; ++q)
+                sums[q] += row[q];
+        }
+
+        for(int r=0; r < h; ++r)
+        {
+            float* out = result.data() + r * w;
+            for(int q=0; q < w; ++q)
+                out[q] = static_cast<float>(sums[q] * scale);
+
+            if(r + b + 1 < h)
+            {
+                const float* entering = values + (r + b + 1) * w;
+                for(int q=0; q < w; ++q)
+                    sums[q] += entering[q];
+            }
+            if(r - b >= 0)
+            {
+                const float* leaving = values + (r - b) * w;
+                for(int q=0; q < w; ++q)
+                    sums[q] -= leaving[q];
+            }
+        }
+
+        copy(result.begin(), result.begin() + w * h, values);
+    }
+
+    // Share of the kernel within the lattice along an axis, walls leave out
+    // the rest. Goes through the same passes as the heights so that a flat
+    // surface stays flat.
+    vector<float> kernelCover(int size, const int boxRadii[3])
+    {
+        int support = boxRadii[0] + boxRadii[1] + boxRadii[2];
+        vector<float> cover(size + 2 * support, 0.0f);
+        fill(cover.begin() + support, cover.begin() + support + size, 1.0f);
+
+        vector<float> line(cover.size());
+        for(int b=0; b < 3; ++b)
+        {
+            if(boxRadii[b] != 0)
+                boxRows(cover.data(), static_cast<int>(cover.size()), 1,
+                        boxRadii[b], line);
+        }
+
+        return vector<float>(cover.begin() + support, cover.begin() + support + size);
+    }
+
+    // Best of the values within r of each value, along the rows then along
+    // the columns. Runs of best values from the start and from the end of
+    // blocks of 2r+1 values answer any window with two lookups. Windows
+    // clipped by the ends may be answered over more values.
+    template<typename Better>
+    void boundRows(float* values, int w, int h, int r,
+                   vector<float>& fromStart, vector<float>& fromEnd,
+                   Better better)
+    {
+        const int L = 2 * r + 1;
+        for(int q=0; q < h; ++q)
+        {
+            float* row = values + q * w;
+            for(int k=0; k < w; ++k)
+                fromStart[k] = k % L == 0 ? row[k] : better(fromStart[k - 1], row[k]);
+            for(int k=w-1; k >= 0; --k)
+                fromEnd[k] = (k % L == L - 1 || k == w - 1) ?
+                    row[k] : better(fromEnd[k + 1], row[k]);
+
+            for(int k=0; k < w; ++k)
+                row[k] = better(fromEnd[max(k - r, 0)], fromStart[min(k + r, w - 1)]);
+        }
+    }
+
+    template<typename Better>
+    void boundColumns(float* values, int w, int h, int r,
+                      vector<float>& fromStart, vector<float>& fromEnd,
+                      Better better)
+    {
+        const int L = 2 * r + 1;
+        for(int k=0; k < h; ++k)
+        {
+            const float* row = values + k * w;
+            float* start = fromStart.data() + k * w;
+            if(k % L == 0)
+                copy(row, row + w, start);
+            else
+                for(int q=0; q < w; ++q)
+                    start[q] = better(start[q - w], row[q]);
+        }
+        for(int k=h-1; k >= 0; --k)
+        {
+            const float* row = values + k * w;
+            float* end = fromEnd.data() + k * w;
+            if(k % L == L - 1 || k == h - 1)
+                copy(row, row + w, end);
+            else
+                for(int q=0; q < w; ++q)
+                    end[q] = better(end[q + w], row[q]);
+        }
+
+        for(int k=0; k < h; ++k)
+        {
+            const float* end = fromEnd.data() + max(k - r, 0) * w;
+            const float* start = fromStart.data() + min(k + r, h - 1) * w;
+            float* row = values + k * w;
+            for(int q=0; q < w; ++q)
+                row[q] = better(end[q], start[q]);
+        }
+    }
+
+    struct Lower
+    {
+        float operator()(float a, float b) const {return min(a, b);}
+    };
+
+    struct Higher
+    {
+        float operator()(float a, float b) const {return max(a, b);}
+    };
+}
+
+
+WaterSolver::WaterSolver(int width, int height, int neighborsRadius,
+                         float stretchness, float lossyness) :
+    WaterSolver(width, height, neighborsRadius, stretchness, lossyness,
+                0, 0, width, height)
+{
+}
+
+WaterSolver::WaterSolver(int width, int height, int neighborsRadius,
+                         float stretchness, float lossyness,
+                         int i0, int j0, int i1, int j1) :
+    _WIDTH(width),
+    _HEIGHT(height),
+    _NEIGHBORS_RADIUS(neighborsRadius),
+    _STRETCHNESS(stretchness),
+    _LOSSYNESS(lossyness),
+    _ownedX0(0), _ownedY0(0),
+    _ownedX1(0), _ownedY1(0),
+    _storageX0(0), _storageY0(0),
+    _storageWidth(0), _storageHeight(0),
+    _stencilType(EStencil::INVERSE_SQUARE),
+    _stencil(),
+    _interiorContribution(0.0f),
+    _boxRadii(),
+    _centerWeight(0.0f),
+    _largestTap(0.0f),
+    _timeScale(1.0f),
+    _time(0.0f),
+    _isBoundTracked(false),
+    _velocityBound(0.0f),
+    _gradientBound(0.0f),
+    _nextVelocityBound(0.0f),
+    _nextGradientBound(0.0f),
+    _boundaries(),
+    _spongeRamp(),
+    _restLevels(),
+    _current(0),
+    _groundHeights(),
+    _velocities()
+{
+    setupDomain(i0, j0, i1, j1);
+}
+
+void WaterSolver::setupDomain(int i0, int j0, int i1, int j1)
+{
+    placeDomain(i0, j0, i1, j1);
+
+    // Fresh arrays, left untouched
+    int storageSize = _storageWidth * _storageHeight;
+    FieldArray(storageSize).swap(_waterHeights[0]);
+    FieldArray(storageSize).swap(_waterHeights[1]);
+    FieldArray(storageSize).swap(_groundHeights);
+    FieldArray(storageSize).swap(_velocities);
+    _current = 0;
+
+    setupStencil();
+    setupSponge();
+}
+
+void WaterSolver::moveDomain(int i0, int j0, int i1, int j1)
+{
+    int storageWidth = _storageWidth;
+    placeDomain(i0, j0, i1, j1);
+
+    // Arrays only grow, the taps follow the row stride
+    int storageSize = _storageWidth * _storageHeight;
+    _waterHeights[0].resize(storageSize);
+    _waterHeights[1].resize(storageSize);
+    _groundHeights.resize(storageSize);
+    _velocities.resize(storageSize);
+    _current = 0;
+
+    if(_storageWidth != storageWidth)
+        setupStencil();
+    setupSponge();
+}
+
+void WaterSolver::placeDomain(int i0, int j0, int i1, int j1)
+{
+    assert( 0 <= i0 && i0 < i1 && i1 <= _WIDTH );
+    assert( 0 <= j0 && j0 < j1 && j1 <= _HEIGHT );
+
+    _ownedX0 = i0;
+    _ownedY0 = j0;
+    _ownedX1 = i1;
+    _ownedY1 = j1;
+
+    _storageX0 = max(i0 - _NEIGHBORS_RADIUS, 0);
+    _storageY0 = max(j0 - _NEIGHBORS_RADIUS, 0);
+    _storageWidth  = min(i1 + _NEIGHBORS_RADIUS, _WIDTH)  - _storageX0;
+    _storageHeight = min(j1 + _NEIGHBORS_RADIUS, _HEIGHT) - _storageY0;
+}
+
+void WaterSolver::setStencil(EStencil stencil)
+{
+    _stencilType = stencil;
+    setupStencil();
+}
+
+void WaterSolver::setupStencil()
+{
+    vector<StencilTap> taps;
+    if(_stencilType == EStencil::INVERSE_SQUARE)
+    {
+        _interiorContribution = buildStencil(_NEIGHBORS_RADIUS, _storageWidth, taps);
+        _stencil.assign(taps.begin(), taps.end());
+        return;
+    }
+
+    _interiorContribution = buildSeparableStencil(_NEIGHBORS_RADIUS, _storageWidth,
+                                                  taps, _boxRadii);
+    _stencil.assign(taps.begin(), taps.end());
+
+    vector<float> kernel = boxKernel(_boxRadii);
+    int support = static_cast<int>(kernel.size()) / 2;
+    _centerWeight = kernel[support] * kernel[support];
+    _largestTap = kernel[support] * kernel[support + 1];
+    _coverX = kernelCover(_WIDTH, _boxRadii);
+    _coverY = kernelCover(_HEIGHT, _boxRadii);
+}
+
+float WaterSolver::buildStencil(int neighborsRadius, int rowStride,
+                                std::vector<StencilTap>& stencil)
+{
+    stencil.clear();
+
+    float totalContribution = 0.0f;
+    for(int nj = -neighborsRadius; nj <= neighborsRadius; ++nj)
+    {
+        for(int ni = -neighborsRadius; ni <= neighborsRadius; ++ni)
+        {
+            // Current node
+            if(ni == 0 && nj == 0)
+                continue;
+
+            // Is near enough
+            float length2 = static_cast<float>(ni*ni + nj*nj);
+            if(sqrt(length2) > neighborsRadius)
+                continue;
+
+            StencilTap tap;
+            tap.di = ni;
+            tap.dj = nj;
+            tap.offset = nj * rowStride + ni;
+            tap.baseContribution = 1.0f / length2;
+            stencil.push_back(tap);
+
+            totalContribution += tap.baseContribution;
+        }
+    }
+
+    return 1.0f / totalContribution;
+}
+
+float WaterSolver::buildSeparableStencil(int neighborsRadius, int rowStride,
+                                        std::vector<StencilTap>& stencil,
+                                        int boxRadii[3])
+{
+    // Boxes of equal or consecutive sizes within the radius, the closest
+    // to the spread of the inverse square weights wins
+    vector<StencilTap> inverseSquare;
+    buildStencil(neighborsRadius, rowStride, inverseSquare);
+    float target = spread(inverseSquare);
+
+    float bestGap = -1.0f;
+    for(int b=0; 3 * b <= neighborsRadius; ++b)
+    {
+        for(int larger=0; larger < 3; ++larger)
+        {
+            int radii[3] = {b, b + (larger >= 2 ? 1 : 0), b + (larger >= 1 ? 1 : 0)};
+            if(radii[2] == 0 || radii[0] + radii[1] + radii[2] > neighborsRadius)
+                continue;
+
+            productTaps(boxKernel(radii), rowStride, stencil);
+            float gap = fabs(spread(stencil) - target);
+            if(bestGap < 0.0f || gap < bestGap)
+            {
+                bestGap = gap;
+                copy(radii, radii + 3, boxRadii);
+            }
+        }
+    }
+
+    return 1.0f / productTaps(boxKernel(boxRadii), rowStride, stencil);
+}
+
+void WaterSolver::setupScenario(const WaterScenario& scenario)
+{
+    fillScenario(scenario, _storageY0, _storageY0 + _storageHeight);
+    startScenario();
+}
+
+void WaterSolver::fillScenario(const WaterScenario& scenario, int j0, int j1)
+{
+    for(int j=j0; j < j1; ++j)
+    {
+        for(int i=_storageX0; i < _storageX0 + _storageWidth; ++i)
+        {
+            float x = i / static_cast<float>(_WIDTH);
+            float y = j / static_cast<float>(_HEIGHT);
+            int s = storageIndex(i, j);
+
+            _groundHeights[s] = scenario.groundHeight(x, y);
+            _waterHeights[0][s] = max(scenario.waterHeight(x, y),
+                                      _groundHeights[s]);
+            _waterHeights[1][s] = _waterHeights[0][s];
+            _velocities[s] = scenario.waterVelocity(x, y);
+        }
+    }
+}
+
+void WaterSolver::startScenario()
+{
+    _current = 0;
+    _time = 0.0f;
+    if(_boundaries.hasInflow() || _boundaries.hasSponge())
+        _restLevels = _waterHeights[0];
+
+    if(_isBoundTracked)
+        setBoundTracked(true);
+}
+
+void WaterSolver::setBoundTracked(bool tracked)
+{
+    // The surface that is already there is gathered whole, once
+    _isBoundTracked = tracked;
+    _velocityBound = 0.0f;
+    _gradientBound = 0.0f;
+    if(tracked)
+    {
+        gatherBounds(_waterHeights[_current].data(), _ownedX0, _ownedY0,
+                     _ownedX1, _ownedY1, _velocityBound, _gradientBound);
+    }
+}
+
+void WaterSolver::editGround(const LatticeRegion& region, const float* heights)
+{
+    int i0 = max(region.i0, _storageX0);
+    int j0 = max(region.j0, _storageY0);
+    int i1 = min(region.i1, _storageX0 + _storageWidth);
+    int j1 = min(region.j1, _storageY0 + _storageHeight);
+    int rowSize = region.i1 - region.i0;
+
+    // Inflows and sponges pull the water back to the same depth as before
+    FieldArray& water = _waterHeights[_current];
+    bool hasRestLevels = !_restLevels.empty();
+    for(int j=j0; j < j1; ++j)
+    {
+        const float* row = heights + (j - region.j0) * rowSize - region.i0;
+        for(int i=i0; i < i1; ++i)
+        {
+            int s = storageIndex(i, j);
+            float depth = max(water[s] - _groundHeights[s], 0.0f);
+            if(hasRestLevels)
+                _restLevels[s] = row[i] + max(_restLevels[s] - _groundHeights[s], 0.0f);
+            _groundHeights[s] = row[i];
+            water[s] = row[i] + depth;
+        }
+    }
+}
+
+void WaterSolver::setBoundaries(const WaterBoundaries& boundaries)
+{
+    assert( !(boundaries.isWrappedX() || boundaries.isWrappedY()) ||
+            (_storageWidth == _WIDTH && _storageHeight == _HEIGHT) );
+
+    _boundaries = boundaries;
+    setupSponge();
+
+    _restLevels.clear();
+    if(_boundaries.hasInflow() || _boundaries.hasSponge())
+        _restLevels = _waterHeights[_current];
+}
+
+void WaterSolver::setupSponge()
+{
+    _spongeRamp.clear();
+    if(!_boundaries.hasSponge())
+        return;
+
+    // Quadratic ramp, zero where the layer begins and one at the edge
+    _spongeRamp.assign(_storageWidth * _storageHeight, 0.0f);
+    int width = _boundaries.spongeWidth;
+    for(int j=_storageY0; j < _storageY0 + _storageHeight; ++j)
+    {
+        for(int i=_storageX0; i < _storageX0 + _storageWidth; ++i)
+        {
+            int distances[WaterBoundaries::EDGE_COUNT] = {
+                i, _WIDTH - 1 - i, j, _HEIGHT - 1 - j};
+
+            float ramp = 0.0f;
+            for(int e=0; e < WaterBoundaries::EDGE_COUNT; ++e)
+            {
+                if(_boundaries.edges[e] != WaterBoundaries::EBoundary::SPONGE ||
+                   distances[e] >= width)
+                    continue;
+
+                float depth = (width - distances[e]) / float(width);
+                ramp = max(ramp, depth * depth);
+            }
+
+            _spongeRamp[storageIndex(i, j)] = ramp;
+        }
+    }
+}
+
+bool WaterSolver::isInflow(int i, int j) const
+{
+    typedef WaterBoundaries::EBoundary EBoundary;
+    const EBoundary* edges = _boundaries.edges;
+    return (i == 0           && edges[WaterBoundaries::LEFT]   == EBoundary::INFLOW) ||
+           (i == _WIDTH - 1  && edges[WaterBoundaries::RIGHT]  == EBoundary::INFLOW) ||
+           (j == 0           && edges[WaterBoundaries::BOTTOM] == EBoundary::INFLOW) ||
+           (j == _HEIGHT - 1 && edges[WaterBoundaries::TOP]    == EBoundary::INFLOW);
+}
+
+void WaterSolver::step()
+{
+    stepRegion(_ownedX0, _ownedY0, _ownedX1, _ownedY1);
+    swapBuffers();
+}
+
+void WaterSolver::stepRegion(int i0, int j0, int i1, int j1)
+{
+    assert( _ownedX0 <= i0 && i1 <= _ownedX1 );
+    assert( _ownedY0 <= j0 && j1 <= _ownedY1 );
+
+    const float* heights = _waterHeights[_current].data();
+    float velocity = 0.0f;
+    float gradient = 0.0f;
+
+    if(_stencilType == EStencil::SEPARABLE)
+    {
+        stepSeparable(i0, j0, i1, j1);
+        if(_isBoundTracked)
+            gatherBounds(heights, i0, j0, i1, j1, velocity, gradient);
+    }
+    else
+    {
+        StepScratch& scratch = stepScratch(_stencil.size());
+        int* neighbors = scratch.neighbors.data();
+        float* overNeighbor = scratch.taps.data();
+        float* contribution = scratch.taps.data() + _stencil.size();
+
+        // Rows are gathered while they are still in the cache
+        for(int j=j0; j < j1; ++j)
+        {
+            for(int i=i0; i < i1; ++i)
+                exchange(i, j, isInterior(i, j), neighbors,
+                         overNeighbor, contribution);
+            if(_isBoundTracked)
+                gatherBounds(heights, i0, j, i1, j + 1, velocity, gradient);
+        }
+    }
+
+    if(_isBoundTracked)
+    {
+        raise(_nextVelocityBound, velocity);
+        raise(_nextGradientBound, gradient);
+    }
+}
+
+void WaterSolver::swapBuffers()
+{
+    _current = 1 - _current;
+    _time += _timeScale;
+
+    if(_isBoundTracked)
+    {
+        _velocityBound = _nextVelocityBound.exchange(0.0f, memory_order_relaxed);
+        _gradientBound = _nextGradientBound.exchange(0.0f, memory_order_relaxed);
+    }
+}
+
+void WaterSolver::gatherBounds(const float* heights, int i0, int j0, int i1, int j1,
+                               float& velocity, float& gradient) const
+{
+    // Pairs reach below and left into the heights all regions read, shores
+    // are left out, water resting against a wall does not move
+    const float* ground = _groundHeights.data();
+    for(int j=j0; j < j1; ++j)
+    {
+        for(int i=i0; i < i1; ++i)
+        {
+            int c = storageIndex(i, j);
+            velocity = max(velocity, fabs(_velocities[c]));
+            if(heights[c] <= ground[c])
+                continue;
+
+            if(i > _ownedX0 && heights[c - 1] > ground[c - 1])
+                gradient = max(gradient, fabs(heights[c] - heights[c - 1]));
+            if(j > _ownedY0 && heights[c - _storageWidth] > ground[c - _storageWidth])
+                gradient = max(gradient, fabs(heights[c] - heights[c - _storageWidth]));
+        }
+    }
+}
+
+void WaterSolver::raise(std::atomic<float>& bound, float value)
+{
+    float highest = bound.load(memory_order_relaxed);
+    while(value > highest &&
+          !bound.compare_exchange_weak(highest, value, memory_order_relaxed))
+        continue;
+}
+
+void WaterSolver::exchange(int i, int j, bool interior, int* neighbors,
+                           float* overNeighbor, float* contribution)
+{
+    const float* heights = _waterHeights[_current].data();
+    const float* ground = _groundHeights.data();
+    int tapCount = static_cast<int>(_stencil.size());
+    int c = storageIndex(i, j);
+
+    // Off bounds neighbors do not contribute, periodic ones wrap
+    if(interior)
+    {
+        for(int t=0; t < tapCount; ++t)
+        {
+            contribution[t] = _stencil[t].baseContribution * _interiorContribution;
+            neighbors[t] = c + _stencil[t].offset;
+        }
+    }
+    else
+    {
+        if(isInflow(i, j))
+        {
+            float wave = _boundaries.inflowAmplitude *
+                         sin(2.0f * PI * _time / _boundaries.inflowPeriod);
+            float level = max(_restLevels[c] + wave, ground[c]);
+            _waterHeights[1 - _current][c] = level;
+            _velocities[c] = (level - heights[c]) / _timeScale;
+            return;
+        }
+
+        float totalContribution = 0.0f;
+        for(int t=0; t < tapCount; ++t)
+        {
+            const StencilTap& tap = _stencil[t];
+            int ni = i + tap.di;
+            int nj = j + tap.dj;
+            if(_boundaries.isWrappedX())
+                ni = (ni + _WIDTH) % _WIDTH;
+            if(_boundaries.isWrappedY())
+                nj = (nj + _HEIGHT) % _HEIGHT;
+
+            bool inBounds = isInBounds(ni, nj);
+            contribution[t] = inBounds ? tap.baseContribution : 0.0f;
+            neighbors[t] = inBounds ? storageIndex(ni, nj) : c;
+            totalContribution += contribution[t];
+        }
+        for(int t=0; t < tapCount; ++t)
+            contribution[t] /= totalContribution;
+    }
+
+    float h = heights[c];
+    float g = ground[c];
+    float over = max(h - g, 0.0f);
+    bool isOnFloor = h <= g;
+
+    float dzMean = 0.0f;
+    float totContrib = 0.0f;
+    for(int t=0; t < tapCount; ++t)
+    {
+        overNeighbor[t] = -1.0f;
+        if(contribution[t] == 0.0f)
+            continue;
+
+        int n = neighbors[t];
+        float hn = heights[n];
+        float gn = ground[n];
+        float overN = max(hn - gn, 0.0f);
+
+        float dz = hn - h;
+        dzMean += min(max(dz, -over), overN) * contribution[t];
+
+        bool isExchangePermitted = (dz != 0.0f) &&
+                                  !(dz < 0.0f && isOnFloor) &&
+                                  !(dz > 0.0f && hn <= gn);
+        if(isExchangePermitted)
+        {
+            overNeighbor[t] = overN;
+            totContrib += contribution[t];
+        }
+    }
+
+    float* next = _waterHeights[1 - _current].data();
+
+    if(totContrib == 0.0f)
+    {
+        next[c] = h;
+        _velocities[c] = 0.0f;
+        return;
+    }
+
+    float velocity = _velocities[c];
+    float lossyness = _spongeRamp.empty() ? _LOSSYNESS :
+        _LOSSYNESS + _spongeRamp[c] * _boundaries.spongeDamping;
+    float acc = ((dzMean * _STRETCHNESS) - (velocity * lossyness)) * _timeScale;
+    float maxWaterMoved = max((velocity + acc) * _timeScale, -over);
+
+    float waterMoved = 0.0f;
+    for(int t=0; t < tapCount; ++t)
+    {
+        if(overNeighbor[t] < 0.0f)
+            continue;
+
+        waterMoved += min(maxWaterMoved * contribution[t] / totContrib,
+                          overNeighbor[t]);
+    }
+
+    next[c] = max(h + waterMoved, g);
+    _velocities[c] = waterMoved / _timeScale;
+
+    // The layer also lets go of the water the waves bring in
+    if(!_spongeRamp.empty() && _spongeRamp[c] > 0.0f)
+    {
+        float relax = _spongeRamp[c] * _boundaries.spongeRelaxation * _timeScale;
+        relax = min(relax, 1.0f);
+        next[c] = max(next[c] - (next[c] - _restLevels[c]) * relax, g);
+    }
+}
+
+void WaterSolver::stepSeparable(int i0, int j0, int i1, int j1)
+{
+    // Window of the kernel around the region. Cells past the lattice hold
+    // no water and bound nothing, the passes of the kernel go through them
+    // so that walls cut it the same way they cut the taps.
+    const int S = _boxRadii[0] + _boxRadii[1] + _boxRadii[2];
+    const int x0 = i0 - S;
+    const int y0 = j0 - S;
+    const int w = i1 - i0 + 2 * S;
+    const int h = j1 - j0 + 2 * S;
+    const float far = numeric_limits<float>::max();
+
+    const float* heights = _waterHeights[_current].data();
+    const float* ground = _groundHeights.data();
+
+    StepScratch& scratch = stepScratch(_stencil.size());
+    vector<float>& mean = scratch.mean;
+    vector<float>& lowest = scratch.lowest;
+    vector<float>& highest = scratch.highest;
+    vector<float>& highestGround = scratch.highestGround;
+    vector<float>& shallowest = scratch.shallowest;
+    mean.assign(w * h, 0.0f);
+    lowest.assign(w * h, far);
+    highest.assign(w * h, -far);
+    highestGround.assign(w * h, -far);
+    shallowest.assign(w * h, far);
+    for(int r=max(-y0, 0); r < min(_HEIGHT - y0, h); ++r)
+    {
+        for(int q=max(-x0, 0); q < min(_WIDTH - x0, w); ++q)
+        {
+            int c = storageIndex(x0 + q, y0 + r);
+            int k = r * w + q;
+            mean[k] = lowest[k] = highest[k] = heights[c];
+            highestGround[k] = ground[c];
+            shallowest[k] = heights[c] - ground[c];
+        }
+    }
+
+    // Kernel means and window bounds, along the rows then the columns
+    vector<float>& line = scratch.line;
+    vector<float>& fromStart = scratch.fromStart;
+    vector<float>& fromEnd = scratch.fromEnd;
+    vector<double>& sums = scratch.sums;
+    line.resize(max(line.size(), size_t(w)));
+    fromStart.resize(max(fromStart.size(), size_t(w * h)));
+    fromEnd.resize(max(fromEnd.size(), size_t(w * h)));
+    sums.resize(max(sums.size(), size_t(w)));
+    for(int b=0; b < 3; ++b)
+    {
+        if(_boxRadii[b] == 0)
+            continue;
+        boxRows(mean.data(), w, h, _boxRadii[b], line);
+        boxColumns(mean.data(), w, h, _boxRadii[b], sums, fromStart);
+    }
+
+    boundRows(lowest.data(), w, h, S, fromStart, fromEnd, Lower());
+    boundColumns(lowest.data(), w, h, S, fromStart, fromEnd, Lower());
+    boundRows(highest.data(), w, h, S, fromStart, fromEnd, Higher());
+    boundColumns(highest.data(), w, h, S, fromStart, fromEnd, Higher());
+    boundRows(highestGround.data(), w, h, S, fromStart, fromEnd, Higher());
+    boundColumns(highestGround.data(), w, h, S, fromStart, fromEnd, Higher());
+    boundRows(shallowest.data(), w, h, S, fromStart, fromEnd, Lower());
+    boundColumns(shallowest.data(), w, h, S, fromStart, fromEnd, Lower());
+
+    int* neighbors = scratch.neighbors.data();
+    float* overNeighbor = scratch.taps.data();
+    float* contribution = scratch.taps.data() + _stencil.size();
+    float* next = _waterHeights[1 - _current].data();
+
+    bool isWrapped = _boundaries.isWrappedX() || _boundaries.isWrappedY();
+    for(int j=j0; j < j1; ++j)
+    {
+        for(int i=i0; i < i1; ++i)
+        {
+            int c = storageIndex(i, j);
+            int k = (j - y0) * w + (i - x0);
+            bool interior = isInterior(i, j);
+
+            // The whole window is under water, no neighbor clamps the
+            // height differences, which then sum to the kernel mean. Walls
+            // cut the kernel, wrapped and driven edges go by the taps.
+            float hc = heights[c];
+            float g = ground[c];
+            if((interior || (!isWrapped && !isInflow(i, j))) &&
+               shallowest[k] > 0.0f &&
+               highestGround[k] <= hc && lowest[k] >= g &&
+               (_spongeRamp.empty() || _spongeRamp[c] == 0.0f))
+            {
+                if(lowest[k] == highest[k])
+                {
+                    next[c] = hc;
+                    _velocities[c] = 0.0f;
+                    continue;
+                }
+
+                float cover = _coverX[i] * _coverY[j];
+                float neighborWeight = cover - _centerWeight;
+                float dzMean = (mean[k] - cover * hc) / neighborWeight;
+                float velocity = _velocities[c];
+                float acc = ((dzMean * _STRETCHNESS) - (velocity * _LOSSYNESS)) * _timeScale;
+                float waterMoved = max((velocity + acc) * _timeScale, -(hc - g));
+
+                // Nor does any neighbor run short of the water it gives
+                if(waterMoved * _largestTap <= shallowest[k] * neighborWeight)
+                {
+                    next[c] = max(hc + waterMoved, g);
+                    _velocities[c] = waterMoved / _timeScale;
+                    continue;
+                }
+            }
+
+            exchange(i, j, interior, neighbors, overNeighbor, contribution);
+        }
+    }
+}
@@ -0,0 +1,372 @@
+#ifndef WATERSOLVER_H
+#define WATERSOLVER_H
+
+#include <vector>
+#include <atomic>
+
+#include <cassert>
+
+#include "FieldAllocator.h"
+#include "MemoryAccounting.h"
+#include "WaterBoundaries.h"
+
+class WaterScenario;
+
+
+struct StencilTap
+{
+    int di;
+    int dj;
+    int offset;
+    float baseContribution;
+};
+
+// Rectangle of lattice cells, ends excluded
+struct LatticeRegion
+{
+    int i0;
+    int j0;
+    int i1;
+    int j1;
+};
+
+// Taps of a solver, counted in the memory accounting
+typedef std::vector<StencilTap, TrackingAllocator<StencilTap,
+                    MemoryAccounting::ESubsystem::SOLVER>> StencilArray;
+
+
+// Neighbor exchange solver of the lattice, without any rendering.
+//
+// Heights are double buffered : a step reads the current buffer and writes
+// the next one, so the result of a cell does not depend on the order in
+// which cells are visited. Any rectangle of cells can be stepped on its own
+// as long as the heights within the neighbors radius are up to date.
+//
+// The solver may own only a rectangle of the lattice. Its storage then
+// covers the owned cells plus a halo of neighbors radius cells.
+//
+// Fields hold no values until the scenario is set up. Their pages are
+// first touched there, by whichever threads fill the rows.
+class WaterSolver
+{
+public:
+    // Weights of the neighbors. Inverse square weights cover a disk and go
+    // tap by tap. Separable weights are the product along both axes of
+    // three box filters, sized to spread as far as the inverse square
+    // weights of the same radius. The SEPARABLE stencil evaluates the cells
+    // of wet interiors with running sums and windowed bounds, at a cost
+    // that does not grow with the radius, and falls back to the taps near
+    // shores, sponges and edges. SEPARABLE_TAPS goes tap by tap everywhere.
+    enum class EStencil {INVERSE_SQUARE, SEPARABLE, SEPARABLE_TAPS};
+
+    WaterSolver(int width, int height, int neighborsRadius,
+                float stretchness, float lossyness);
+
+    // Owns only the given rectangle, the whole lattice is never allocated
+    WaterSolver(int width, int height, int neighborsRadius,
+                float stretchness, float lossyness,
+                int i0, int j0, int i1, int j1);
+
+    void setupDomain(int i0, int j0, int i1, int j1);
+    void setupScenario(const WaterScenario& scenario);
+
+    // Owns another rectangle and keeps the storage it already has when it
+    // fits. Fields hold stale values until they are filled again.
+    void moveDomain(int i0, int j0, int i1, int j1);
+
+    // Inverse square weights by default
+    void setStencil(EStencil stencil);
+    EStencil stencilType() const;
+
+    // Same as setupScenario, for callers that split the filling : fill
+    // each range of storage rows, then start the scenario
+    void fillScenario(const WaterScenario& scenario, int j0, int j1);
+    void startScenario();
+
+    // Sets the ground of the cells of a region, clipped to the storage.
+    // Heights are given row by row over the whole region. Water keeps its
+    // depth over the new ground, so the volume does not change, and so do
+    // the rest levels of inflows and sponges. Weights and wet cells are
+    // found again each step, nothing else follows the ground.
+    void editGround(const LatticeRegion& region, const float* heights);
+
+    // Edges are walls by default. Periodic edges need the whole lattice.
+    void setBoundaries(const WaterBoundaries& boundaries);
+    const WaterBoundaries& boundaries() const;
+
+    void step();
+    void stepRegion(int i0, int j0, int i1, int j1);
+    void swapBuffers();
+
+    // Length of the next steps, in nominal steps. Velocities stay in water
+    // moved per nominal step, so a scale of 1 is the original update.
+    void setTimeScale(float scale);
+    float timeScale() const;
+
+    // Fastest cell of the current surface and steepest height difference
+    // between wet neighbors of the surface the last step started from, when
+    // tracked. Regions gather them as they step, the same whatever the
+    // regions.
+    void setBoundTracked(bool tracked);
+    float velocityBound() const;
+    float gradientBound() const;
+
+    int width() const;
+    int height() const;
+    int neighborsRadius() const;
+    float stretchness() const;
+    float lossyness() const;
+
+    int ownedX0() const;
+    int ownedY0() const;
+    int ownedX1() const;
+    int ownedY1() const;
+
+    int storageX0() const;
+    int storageY0() const;
+    int storageWidth() const;
+    int storageHeight() const;
+    int storageIndex(int i, int j) const;
+    bool isInBounds(int i, int j) const;
+    bool isInterior(int i, int j) const;
+
+    float waterHeight(int i, int j) const;
+    float groundHeight(int i, int j) const;
+    float velocity(int i, int j) const;
+
+    // Current buffers, in storage layout
+    FieldArray& waterHeights();
+    const FieldArray& waterHeights() const;
+    FieldArray& groundHeights();
+    const FieldArray& groundHeights() const;
+    FieldArray& velocities();
+    const FieldArray& velocities() const;
+
+    const StencilArray& stencil() const;
+
+    // Returns the normalization of the taps when none is off bounds
+    static float buildStencil(int neighborsRadius, int rowStride,
+                              std::vector<StencilTap>& stencil);
+    static float buildSeparableStencil(int neighborsRadius, int rowStride,
+                                       std::vector<StencilTap>& stencil,
+                                       int boxRadii[3]);
+
+protected:
+    void placeDomain(int i0, int j0, int i1, int j1);
+    void setupStencil();
+    void setupSponge();
+    bool isInflow(int i, int j) const;
+    void exchange(int i, int j, bool interior, int* neighbors,
+                  float* overNeighbor, float* contribution);
+    void stepSeparable(int i0, int j0, int i1, int j1);
+    void gatherBounds(const float* heights, int i0, int j0, int i1, int j1,
+                      float& velocity, float& gradient) const;
+    static void raise(std::atomic<float>& bound, float value);
+
+private:
+    const int _WIDTH;
+    const int _HEIGHT;
+    const int _NEIGHBORS_RADIUS;
+    const float _STRETCHNESS;
+    const float _LOSSYNESS;
+
+    int _ownedX0, _ownedY0;
+    int _ownedX1, _ownedY1;
+    int _storageX0, _storageY0;
+    int _storageWidth, _storageHeight;
+
+    EStencil _stencilType;
+    StencilArray _stencil;
+    float _interiorContribution;
+    int _boxRadii[3];
+    float _centerWeight;
+    float _largestTap;
+    std::vector<float> _coverX;
+    std::vector<float> _coverY;
+    float _timeScale;
+    float _time;
+
+    bool _isBoundTracked;
+    float _velocityBound;
+    float _gradientBound;
+    std::atomic<float> _nextVelocityBound;
+    std::atomic<float> _nextGradientBound;
+
+    WaterBoundaries _boundaries;
+    FieldArray _spongeRamp;
+    FieldArray _restLevels;
+
+    int _current;
+    FieldArray _waterHeights[2];
+    FieldArray _groundHeights;
+    FieldArray _velocities;
+};
+
+
+
+// IMPLEMENTATION //
+inline WaterSolver::EStencil WaterSolver::stencilType() const
+{
+    return _stencilType;
+}
+
+inline const WaterBoundaries& WaterSolver::boundaries() const
+{
+    return _boundaries;
+}
+
+inline int WaterSolver::width() const
+{
+    return _WIDTH;
+}
+
+inline int WaterSolver::height() const
+{
+    return _HEIGHT;
+}
+
+inline int WaterSolver::neighborsRadius() const
+{
+    return _NEIGHBORS_RADIUS;
+}
+
+inline float WaterSolver::stretchness() const
+{
+    return _STRETCHNESS;
+}
+
+inline float WaterSolver::lossyness() const
+{
+    return _LOSSYNESS;
+}
+
+inline void WaterSolver::setTimeScale(float scale)
+{
+    assert( scale > 0.0f );
+    _timeScale = scale;
+}
+
+inline float WaterSolver::timeScale() const
+{
+    return _timeScale;
+}
+
+inline float WaterSolver::velocityBound() const
+{
+    return _velocityBound;
+}
+
+inline float WaterSolver::gradientBound() const
+{
+    return _gradientBound;
+}
+
+inline int WaterSolver::ownedX0() const
+{
+    return _ownedX0;
+}
+
+inline int WaterSolver::ownedY0() const
+{
+    return _ownedY0;
+}
+
+inline int WaterSolver::ownedX1() const
+{
+    return _ownedX1;
+}
+
+inline int WaterSolver::ownedY1() const
+{
+    return _ownedY1;
+}
+
+inline int WaterSolver::storageX0() const
+{
+    return _storageX0;
+}
+
+inline int WaterSolver::storageY0() const
+{
+    return _storageY0;
+}
+
+inline int WaterSolver::storageWidth() const
+{
+    return _storageWidth;
+}
+
+inline int WaterSolver::storageHeight() const
+{
+    return _storageHeight;
+}
+
+inline int WaterSolver::storageIndex(int i, int j) const
+{
+    assert( isInBounds(i, j) );
+    return (j - _storageY0) * _storageWidth + (i - _storageX0);
+}
+
+inline bool WaterSolver::isInBounds(int i, int j) const
+{
+    return 0 <= i && i < _WIDTH &&
+           0 <= j && j < _HEIGHT;
+}
+
+inline bool WaterSolver::isInterior(int i, int j) const
+{
+    return _NEIGHBORS_RADIUS <= i && i < _WIDTH  - _NEIGHBORS_RADIUS &&
+           _NEIGHBORS_RADIUS <= j && j < _HEIGHT - _NEIGHBORS_RADIUS;
+}
+
+inline float WaterSolver::waterHeight(int i, int j) const
+{
+    return _waterHeights[_current][storageIndex(i, j)];
+}
+
+inline float WaterSolver::groundHeight(int i, int j) const
+{
+    return _groundHeights[storageIndex(i, j)];
+}
+
+inline float WaterSolver::velocity(int i, int j) const
+{
+    return _velocities[storageIndex(i, j)];
+}
+
+inline FieldArray& WaterSolver::waterHeights()
+{
+    return _waterHeights[_current];
+}
+
+inline const FieldArray& WaterSolver::waterHeights() const
+{
+    return _waterHeights[_current];
+}
+
+inline FieldArray& WaterSolver::groundHeights()
+{
+    return _groundHeights;
+}
+
+inline const FieldArray& WaterSolver::groundHeights() const
+{
+    return _groundHeights;
+}
+
+inline FieldArray& WaterSolver::velocities()
+{
+    return _velocities;
+}
+
+inline const FieldArray& WaterSolver::velocities() const
+{
+    return _velocities;
+}
+
+inline const StencilArray& WaterSolver::stencil() const
+{
+    return _stencil;
+}
+
+#endif // WATERSOLVER_H
@@ -0,0 +1,118 @@
+#include "WaterStepSlicer.h"
+
+#include <algorithm>
+
+#include "WaterSolver.h"
+#include "WorkerPool.h"
+
+using namespace std;
+
+
+WaterStepSlicer::WaterStepSlicer(WorkerPool& pool, int tileSize) :
+    _pool(pool),
+    _TILE_SIZE(tileSize),
+    _nextTile(0),
+    _secondsPerTile(0.0),
+    _completedSteps(0),
+    _overrunCount(0),
+    _statsStart(Clock::now()),
+    _windowStart(_statsStart),
+    _windowSteps(0),
+    _stepsPerSecond(0.0),
+    _sliceTimes("Slice times")
+{
+}
+
+bool WaterStepSlicer::advance(WaterSolver& solver, double budget)
+{
+    const Clock::time_point start = Clock::now();
+    const int x0 = solver.ownedX0();
+    const int y0 = solver.ownedY0();
+    const int x1 = solver.ownedX1();
+    const int y1 = solver.ownedY1();
+    const int tilesX = (x1 - x0 + _TILE_SIZE - 1) / _TILE_SIZE;
+    const int tilesY = (y1 - y0 + _TILE_SIZE - 1) / _TILE_SIZE;
+    const int tileCount = tilesX * tilesY;
+
+    // A few tiles per thread in a batch, so the clock is read often enough
+    const int BATCH = 2 * (_pool.threadCount() + 1);
+
+    bool isCompleted = false;
+    double elapsed = 0.0;
+    do
+    {
+        int begin = _nextTile;
+        int end = min(begin + BATCH, tileCount);
+        _pool.parallelFor(begin, end, [&](int t0, int t1)
+        {
+            for(int t=t0; t < t1; ++t)
+            {
+                int ti = x0 + (t % tilesX) * _TILE_SIZE;
+                int tj = y0 + (t / tilesX) * _TILE_SIZE;
+                solver.stepRegion(ti, tj, min(ti + _TILE_SIZE, x1),
+                                  min(tj + _TILE_SIZE, y1));
+            }
+        });
+
+        double before = elapsed;
+        elapsed = chrono::duration<double>(Clock::now() - start).count();
+        double perTile = (elapsed - before) / (end - begin);
+        _secondsPerTile = _secondsPerTile == 0.0 ?
+            perTile : 0.8 * _secondsPerTile + 0.2 * perTile;
+
+        _nextTile = end;
+        if(_nextTile == tileCount)
+        {
+            solver.swapBuffers();
+            _nextTile = 0;
+            isCompleted = true;
+            break;
+        }
+    }
+    while(elapsed + _secondsPerTile * min(BATCH, tileCount - _nextTile) <= budget);
+
+    Clock::time_point now = Clock::now();
+    double seconds = chrono::duration<double>(now - start).count();
+    _sliceTimes.add(seconds);
+    if(seconds > budget)
+        ++_overrunCount;
+
+    if(isCompleted)
+    {
+        ++_completedSteps;
+        ++_windowSteps;
+    }
+
+    double window = chrono::duration<double>(now - _windowStart).count();
+    if(window >= 1.0)
+    {
+        _stepsPerSecond = _windowSteps / window;
+        _windowSteps = 0;
+        _windowStart = now;
+    }
+
+    return isCompleted;
+}
+
+void WaterStepSlicer::report(std::ostream& out) const
+{
+    double seconds = chrono::duration<double>(Clock::now() - _statsStart).count();
+    int slices = sliceCount();
+    out << "Sliced stepping: " << _completedSteps << " steps in "
+        << seconds << " s, " << (seconds > 0.0 ? _completedSteps / seconds : 0.0)
+        << " steps/s, " << (_completedSteps > 0 ? double(slices) / _completedSteps : 0.0)
+        << " slices per step, " << _overrunCount << " of " << slices
+        << " slices over budget" << endl;
+    _sliceTimes.report(out);
+}
+
+void WaterStepSlicer::clearStats()
+{
+    _completedSteps = 0;
+    _overrunCount = 0;
+    _statsStart = Clock::now();
+    _windowStart = _statsStart;
+    _windowSteps = 0;
+    _stepsPerSecond = 0.0;
+    _sliceTimes.clear();
+}
@@ -0,0 +1,95 @@
+#ifndef WATERSTEPSLICER_H
+#define WATERSTEPSLICER_H
+
+#include <chrono>
+#include <ostream>
+
+#include "FrameTimeStats.h"
+
+class WaterSolver;
+class WorkerPool;
+
+
+// Spreads the steps of a solver over as many calls as they need. Each call
+// steps tiles on the worker pool, a batch at a time, until its time budget
+// is spent, and the next call resumes with the following tile. Buffers are
+// swapped after the last tile, so the current heights stay those of the
+// last completed step while a step is under way.
+//
+// A call steps at least one batch, so the lattice always moves on. A batch
+// is not started when the time its tiles took so far says it would not fit,
+// and a call that still goes over its budget counts as an overrun.
+class WaterStepSlicer
+{
+public:
+    WaterStepSlicer(WorkerPool& pool, int tileSize = 64);
+
+    // Steps tiles for about budget seconds, true when a step completed
+    bool advance(WaterSolver& solver, double budget);
+
+    // Drops the tiles of a step under way, they only wrote the next buffer
+    void restart();
+    bool isStepping() const;
+
+    int completedSteps() const;
+    int overrunCount() const;
+    int sliceCount() const;
+
+    // Completed steps over the last whole second
+    double stepsPerSecond() const;
+
+    void report(std::ostream& out) const;
+    void clearStats();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    WorkerPool& _pool;
+    const int _TILE_SIZE;
+
+    int _nextTile;
+    double _secondsPerTile;
+
+    int _completedSteps;
+    int _overrunCount;
+    Clock::time_point _statsStart;
+    Clock::time_point _windowStart;
+    int _windowSteps;
+    double _stepsPerSecond;
+    FrameTimeStats _sliceTimes;
+};
+
+
+
+// IMPLEMENTATION //
+inline void WaterStepSlicer::restart()
+{
+    _nextTile = 0;
+}
+
+inline bool WaterStepSlicer::isStepping() const
+{
+    return _nextTile != 0;
+}
+
+inline int WaterStepSlicer::completedSteps() const
+{
+    return _completedSteps;
+}
+
+inline int WaterStepSlicer::overrunCount() const
+{
+    return _overrunCount;
+}
+
+inline int WaterStepSlicer::sliceCount() const
+{
+    return _sliceTimes.count();
+}
+
+inline double WaterStepSlicer::stepsPerSecond() const
+{
+    return _stepsPerSecond;
+}
+
+#endif // WATERSTEPSLICER_H
@@ -0,0 +1,201 @@
+#include "WaterStepTuner.h"
+
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+#include <sys/stat.h>
+
+#include "WaterSolver.h"
+
+using namespace std;
+
+
+WaterStepTuner::WaterStepTuner() :
+    _BUDGET_SECONDS(2.0),
+    _MIN_STEPS(2)
+{
+}
+
+WaterStepConfig WaterStepTuner::tune(const WaterSolver& solver,
+                                     const WaterScenario& scenario)
+{
+    string key = cacheKey(solver);
+
+    WaterStepConfig best;
+    if(readCache(key, best))
+    {
+        cout << "Step configuration from the cache: " << best.name() << endl;
+        return best;
+    }
+
+    // Large lattices overrun the budget by the steps each candidate needs
+    vector<WaterStepConfig> configs = candidates(solver);
+    double slice = _BUDGET_SECONDS / configs.size();
+    double bestTime = 0.0;
+    for(size_t c=0; c < configs.size(); ++c)
+    {
+        double time = timeStep(solver, scenario, configs[c], slice);
+        cout << "  " << configs[c].name() << ": " << time * 1000.0
+             << " ms per step" << endl;
+
+        if(c == 0 || time < bestTime)
+        {
+            best = configs[c];
+            bestTime = time;
+        }
+    }
+
+    cout << "Step configuration tuned for " << key << ": " << best.name() << endl;
+    writeCache(key, best);
+    return best;
+}
+
+std::vector<WaterStepConfig> WaterStepTuner::candidates(const WaterSolver& solver) const
+{
+    int cores = max(static_cast<int>(thread::hardware_concurrency()), 1);
+    vector<int> threadCounts;
+    for(int t=1; t < cores; t *= 2)
+        threadCounts.push_back(t);
+    threadCounts.push_back(cores);
+
+    int extent = max(solver.width(), solver.height());
+    const int TILE_SIZES[] = {0, 32, 64, 128, 256};
+
+    vector<WaterStepConfig> configs;
+    for(size_t t=0; t < threadCounts.size(); ++t)
+    {
+        for(int tileSize : TILE_SIZES)
+        {
+            if(tileSize < extent)
+                configs.push_back(WaterStepConfig(threadCounts[t], tileSize));
+        }
+    }
+    return configs;
+}
+
+double WaterStepTuner::timeStep(const WaterSolver& solver,
+                                const WaterScenario& scenario,
+                                const WaterStepConfig& config,
+                                double budget) const
+{
+    // Fields are placed by the candidate as they would be for real
+    WaterSolver copy(solver.width(), solver.height(), solver.neighborsRadius(),
+                     solver.stretchness(), solver.lossyness());
+    copy.setBoundaries(solver.boundaries());
+    WaterStepper stepper(config);
+    stepper.setupScenario(copy, scenario);
+    stepper.step(copy);
+
+    int stepCount = 0;
+    double seconds = 0.0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    while(stepCount < _MIN_STEPS || seconds < budget)
+    {
+        stepper.step(copy);
+        ++stepCount;
+        seconds = chrono::duration<double>(
+            chrono::steady_clock::now() - start).count();
+    }
+
+    return seconds / stepCount;
+}
+
+std::string WaterStepTuner::cpuModel()
+{
+    ifstream cpuInfo("/proc/cpuinfo");
+    string line;
+    while(getline(cpuInfo, line))
+    {
+        if(line.compare(0, 10, "model name") != 0)
+            continue;
+
+        size_t value = line.find(':');
+        if(value != string::npos)
+        {
+            value = line.find_first_not_of(' ', value + 1);
+            if(value != string::npos)
+                return line.substr(value);
+        }
+    }
+
+    return "unknown cpu";
+}
+
+std::string WaterStepTuner::cacheFileName()
+{
+    string directory;
+    if(const char* cache = getenv("XDG_CACHE_HOME"))
+        directory = cache;
+    else if(const char* home = getenv("HOME"))
+        directory = string(home) + "/.cache";
+    else
+        return "water-surface-tuning.txt";
+
+    mkdir(directory.c_str(), 0755);
+    return directory + "/water-surface-tuning.txt";
+}
+
+std::string WaterStepTuner::cacheKey(const WaterSolver& solver) const
+{
+    ostringstream key;
+    key << cpuModel() << ", " << solver.width() << "x" << solver.height()
+        << ", radius " << solver.neighborsRadius();
+    return key.str();
+}
+
+bool WaterStepTuner::readCache(const std::string& key, WaterStepConfig& config) const
+{
+    // One choice per line : key, thread count and tile size, tab separated
+    ifstream file(cacheFileName().c_str());
+    string line;
+    while(getline(file, line))
+    {
+        size_t tab = line.find('\t');
+        if(tab == string::npos || line.substr(0, tab) != key)
+            continue;
+
+        istringstream values(line.substr(tab + 1));
+        WaterStepConfig cached;
+        if(values >> cached.threadCount >> cached.tileSize &&
+           cached.threadCount > 0 && cached.tileSize >= 0)
+        {
+            config = cached;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WaterStepTuner::writeCache(const std::string& key,
+                                const WaterStepConfig& config) const
+{
+    string fileName = cacheFileName();
+
+    vector<string> lines;
+    {
+        ifstream file(fileName.c_str());
+        string line;
+        while(getline(file, line))
+        {
+            if(line.compare(0, key.size() + 1, key + '\t') != 0)
+                lines.push_back(line);
+        }
+    }
+
+    ostringstream entry;
+    entry << key << '\t' << config.threadCount << '\t' << config.tileSize;
+    lines.push_back(entry.str());
+
+    ofstream file(fileName.c_str());
+    for(size_t l=0; l < lines.size(); ++l)
+        file << lines[l] << '\n';
+
+    if(!file)
+        cerr << "Could not cache the step configuration in " << fileName << endl;
+}
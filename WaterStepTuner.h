@@ -0,0 +1,43 @@
+#ifndef WATERSTEPTUNER_H
+#define WATERSTEPTUNER_H
+
+#include <string>
+#include <vector>
+
+#include "WaterStepper.h"
+
+class WaterScenario;
+class WaterSolver;
+
+
+// Picks the fastest step configuration for this host and lattice.
+//
+// Candidates are timed on a solver like the given one, set up with the
+// actual scenario by the candidate itself, within a fixed budget. The choice is cached on disk keyed by the CPU
+// model, the lattice size and the neighbors radius, and later startups
+// with the same key take it without timing anything.
+class WaterStepTuner
+{
+public:
+    WaterStepTuner();
+
+    WaterStepConfig tune(const WaterSolver& solver, const WaterScenario& scenario);
+
+    static std::string cpuModel();
+    static std::string cacheFileName();
+
+protected:
+    std::vector<WaterStepConfig> candidates(const WaterSolver& solver) const;
+    double timeStep(const WaterSolver& solver, const WaterScenario& scenario,
+                    const WaterStepConfig& config, double budget) const;
+
+    std::string cacheKey(const WaterSolver& solver) const;
+    bool readCache(const std::string& key, WaterStepConfig& config) const;
+    void writeCache(const std::string& key, const WaterStepConfig& config) const;
+
+private:
+    const double _BUDGET_SECONDS;
+    const int _MIN_STEPS;
+};
+
+#endif // WATERSTEPTUNER_H
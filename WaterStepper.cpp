@@ -0,0 +1,182 @@
+#include "WaterStepper.h"
+
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+
+#include "NumaTopology.h"
+#include "WaterScenario.h"
+#include "WaterSolver.h"
+#include "WorkerPool.h"
+
+using namespace std;
+
+
+WaterStepConfig::WaterStepConfig() :
+    threadCount(1),
+    tileSize(0)
+{
+}
+
+WaterStepConfig::WaterStepConfig(int threadCount, int tileSize) :
+    threadCount(threadCount),
+    tileSize(tileSize)
+{
+}
+
+std::string WaterStepConfig::name() const
+{
+    ostringstream out;
+    out << threadCount << " thread(s), ";
+    if(tileSize == 0)
+        out << "row bands";
+    else
+        out << "tiles of " << tileSize;
+    return out.str();
+}
+
+
+WaterStepper::WaterStepper(const WaterStepConfig& config) :
+    _config(config),
+    _pool(),
+    _isPinned(false)
+{
+    // A single thread steps on the caller, which is left where it runs
+    if(config.threadCount > 1)
+    {
+        _pool.reset(new WorkerPool(config.threadCount));
+
+        vector<int> cpus = NumaTopology::allowedCpus();
+        if(static_cast<int>(cpus.size()) >= config.threadCount)
+            _isPinned = _pool->pinWorkers(cpus);
+    }
+}
+
+WaterStepper::~WaterStepper()
+{
+}
+
+void WaterStepper::run(const std::function<void(int)>& body)
+{
+    if(_pool)
+        _pool->runOnWorkers(body);
+    else
+        body(0);
+}
+
+void WaterStepper::bandRows(const WaterSolver& solver, int worker,
+                            int& j0, int& j1) const
+{
+    const int y0 = solver.ownedY0();
+    const int y1 = solver.ownedY1();
+    const int n = _config.threadCount;
+
+    if(_config.tileSize == 0)
+    {
+        j0 = y0 + (y1 - y0) * worker / n;
+        j1 = y0 + (y1 - y0) * (worker + 1) / n;
+    }
+    else
+    {
+        const int size = _config.tileSize;
+        const int tileRows = (y1 - y0 + size - 1) / size;
+        j0 = min(y0 + tileRows * worker / n * size, y1);
+        j1 = min(y0 + tileRows * (worker + 1) / n * size, y1);
+    }
+}
+
+void WaterStepper::setupScenario(WaterSolver& solver, const WaterScenario& scenario)
+{
+    const int storageY1 = solver.storageY0() + solver.storageHeight();
+    run([&](int worker)
+    {
+        int j0, j1;
+        bandRows(solver, worker, j0, j1);
+
+        // The halo rows go to the bands next to them
+        if(worker == 0)
+            j0 = solver.storageY0();
+        if(worker == _config.threadCount - 1)
+            j1 = storageY1;
+        solver.fillScenario(scenario, j0, j1);
+    });
+
+    solver.startScenario();
+}
+
+void WaterStepper::step(WaterSolver& solver)
+{
+    const int x0 = solver.ownedX0();
+    const int x1 = solver.ownedX1();
+
+    run([&](int worker)
+    {
+        int j0, j1;
+        bandRows(solver, worker, j0, j1);
+
+        if(_config.tileSize == 0)
+        {
+            if(j0 < j1)
+                solver.stepRegion(x0, j0, x1, j1);
+            return;
+        }
+
+        const int size = _config.tileSize;
+        for(int tj=j0; tj < j1; tj += size)
+            for(int ti=x0; ti < x1; ti += size)
+                solver.stepRegion(ti, tj, min(ti + size, x1), min(tj + size, j1));
+    });
+
+    solver.swapBuffers();
+}
+
+void WaterStepper::reportPlacement(const WaterSolver& solver)
+{
+    const int SAMPLES = 64;
+    const int n = _config.threadCount;
+
+    vector<int> cpus(n, -1);
+    run([&](int worker) {cpus[worker] = NumaTopology::currentCpu();});
+
+    cout << "Placement of the lattice fields, " << _config.name()
+         << (_isPinned ? ", pinned" : ", not pinned") << endl;
+
+    // The other height buffer is filled and stepped like the current one
+    const char* NAMES[] = {"heights", "ground", "velocities"};
+    const FieldArray* fields[] = {
+        &solver.waterHeights(), &solver.groundHeights(), &solver.velocities()};
+
+    for(int f=0; f < 3; ++f)
+    {
+        const FieldArray& field = *fields[f];
+        size_t bytes = field.size() * sizeof(float);
+        uintptr_t address = reinterpret_cast<uintptr_t>(field.data());
+        const char* alignment =
+            address % FieldAllocator<float>::HUGE_PAGE == 0 ? "2 MiB" :
+            address % FieldAllocator<float>::CACHE_LINE == 0 ? "64 B" : "unaligned";
+
+        cout << "  " << NAMES[f] << ": " << bytes / 1048576.0 << " MiB, "
+             << alignment << " aligned, "
+             << NumaTopology::hugePageBytes(field.data(), bytes) / 1048576.0
+             << " MiB on huge pages" << endl;
+
+        for(int w=0; w < n; ++w)
+        {
+            int j0, j1;
+            bandRows(solver, w, j0, j1);
+            if(j0 == j1)
+                continue;
+
+            int node = NumaTopology::nodeOfCpu(cpus[w]);
+            const float* first = &field[solver.storageIndex(solver.ownedX0(), j0)];
+            size_t bandBytes = size_t(j1 - j0) * solver.storageWidth() * sizeof(float);
+            vector<int> nodes = NumaTopology::pageNodes(first, bandBytes, SAMPLES);
+            int local = static_cast<int>(count(nodes.begin(), nodes.end(), node));
+
+            cout << "    worker " << w << " on cpu " << cpus[w] << " node " << node
+                 << ", rows " << j0 << "-" << j1 << ": " << local << "/"
+                 << nodes.size() << " sampled pages local" << endl;
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef WATERSTEPPER_H
+#define WATERSTEPPER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+class WaterScenario;
+class WaterSolver;
+class WorkerPool;
+
+
+// How a lattice step is split : a tile size of 0 steps bands of rows
+struct WaterStepConfig
+{
+    WaterStepConfig();
+    WaterStepConfig(int threadCount, int tileSize);
+
+    std::string name() const;
+
+    int threadCount;
+    int tileSize;
+};
+
+
+// Steps a solver following a configuration. Cells only write themselves,
+// so any split gives the same surface as the plain step.
+//
+// Each worker owns a band of rows, of whole tiles when stepping tiles, and
+// keeps it from one step to the next. Workers are pinned to CPUs grouped
+// by NUMA node, and fill their own band when the scenario is set up, so
+// the pages of a band are first touched on the node that steps it.
+class WaterStepper
+{
+public:
+    WaterStepper(const WaterStepConfig& config);
+    ~WaterStepper();
+
+    const WaterStepConfig& config() const;
+    bool isPinned() const;
+
+    void setupScenario(WaterSolver& solver, const WaterScenario& scenario);
+    void step(WaterSolver& solver);
+
+    // Workers, their CPU and node, and where the pages of each band are
+    void reportPlacement(const WaterSolver& solver);
+
+protected:
+    void run(const std::function<void(int)>& body);
+    void bandRows(const WaterSolver& solver, int worker, int& j0, int& j1) const;
+
+private:
+    WaterStepConfig _config;
+    std::unique_ptr<WorkerPool> _pool;
+    bool _isPinned;
+};
+
+
+
+// IMPLEMENTATION //
+inline const WaterStepConfig& WaterStepper::config() const
+{
+    return _config;
+}
+
+inline bool WaterStepper::isPinned() const
+{
+    return _isPinned;
+}
+
+#endif // WATERSTEPPER_H
@@ -0,0 +1,141 @@
+#include "WaterTimestep.h"
+
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include <DataStructure/Vector.h>
+
+#include "WaterSolver.h"
+
+using namespace std;
+using namespace cellar;
+
+
+const float WaterTimestep::NOMINAL_STEP = 1.0f / 60.0f;
+const float WaterTimestep::_SAFETY = 0.85f;
+const float WaterTimestep::_MAX_HEIGHT_CHANGE = 0.01f;
+const int WaterTimestep::_MAX_SUBSTEPS = 16;
+
+
+WaterTimestep::WaterTimestep(const WaterSolver& solver) :
+    _stretchness(solver.stretchness()),
+    _waveScale(0.0f),
+    _pendingTime(0.0f),
+    _droppedTime(0.0f),
+    _savedSteps(0.0f),
+    _frameSubsteps(0),
+    _stepCount(0),
+    _secondTime(0.0f),
+    _secondSteps(0),
+    _secondMinScale(0.0f),
+    _secondMaxScale(0.0f),
+    _secondSubdivided(0),
+    _secondDropped(0.0f)
+{
+    // Symplectic Euler on h'' = k L h is stable while dt^2 k |lambda| < 4,
+    // lambda being the most negative eigenvalue of the stencil
+    const StencilArray& stencil = solver.stencil();
+    float totalContribution = 0.0f;
+    for(size_t t=0; t < stencil.size(); ++t)
+        totalContribution += stencil[t].baseContribution;
+
+    const int SAMPLES = 64;
+    float minEigenvalue = 0.0f;
+    for(int b=0; b <= SAMPLES; ++b)
+    {
+        for(int a=0; a <= SAMPLES; ++a)
+        {
+            float kx = PI * a / SAMPLES;
+            float ky = PI * b / SAMPLES;
+            float eigenvalue = 0.0f;
+            for(size_t t=0; t < stencil.size(); ++t)
+                eigenvalue += stencil[t].baseContribution / totalContribution *
+                    (cos(kx * stencil[t].di + ky * stencil[t].dj) - 1.0f);
+            minEigenvalue = min(minEigenvalue, eigenvalue);
+        }
+    }
+
+    _waveScale = _SAFETY * 2.0f / sqrt(_stretchness * -minEigenvalue);
+}
+
+void WaterTimestep::addTime(float nominalSteps)
+{
+    _pendingTime += nominalSteps;
+    _frameSubsteps = 0;
+}
+
+float WaterTimestep::nextScale(const WaterSolver& solver)
+{
+    float scale = stableScale(solver);
+    if(_frameSubsteps >= _MAX_SUBSTEPS)
+    {
+        // Left over, the time would pile up frame after frame
+        if(_pendingTime >= scale)
+        {
+            _droppedTime += _pendingTime;
+            _secondDropped += _pendingTime;
+            _pendingTime = 0.0f;
+        }
+        return 0.0f;
+    }
+
+    if(_pendingTime < scale)
+        return 0.0f;
+
+    _pendingTime -= scale;
+    _savedSteps += scale - 1.0f;
+    ++_frameSubsteps;
+    ++_stepCount;
+
+    if(_secondSteps == 0)
+    {
+        _secondMinScale = scale;
+        _secondMaxScale = scale;
+    }
+    _secondMinScale = min(_secondMinScale, scale);
+    _secondMaxScale = max(_secondMaxScale, scale);
+    _secondSubdivided += _frameSubsteps == 2 ? 1 : 0;
+    ++_secondSteps;
+    _secondTime += scale;
+    if(_secondTime * NOMINAL_STEP >= 1.0f)
+        logSecond();
+
+    return scale;
+}
+
+float WaterTimestep::stableScale(const WaterSolver& solver) const
+{
+    float velocity = solver.velocityBound();
+    float gradient = solver.gradientBound();
+
+    // The step moves about dt v + dt^2 k gradient of water
+    float scale = _waveScale;
+    if(velocity > 0.0f)
+        scale = min(scale, _MAX_HEIGHT_CHANGE / velocity);
+    if(gradient > 0.0f)
+        scale = min(scale, sqrt(_MAX_HEIGHT_CHANGE / (_stretchness * gradient)));
+
+    // No shorter than the saved steps allow, within the wave limit
+    if(_savedSteps < 1.0f - scale)
+        scale = min(max(scale, 1.0f - _savedSteps), _waveScale);
+    return scale;
+}
+
+void WaterTimestep::logSecond()
+{
+    cout << "Timestep: " << _secondSteps << " steps over "
+         << _secondTime * NOMINAL_STEP << " s, dt "
+         << _secondMinScale * NOMINAL_STEP * 1000.0f << " to "
+         << _secondMaxScale * NOMINAL_STEP * 1000.0f << " ms";
+    if(_secondSubdivided != 0)
+        cout << ", " << _secondSubdivided << " frames subdivided";
+    if(_secondDropped != 0.0f)
+        cout << ", " << _secondDropped * NOMINAL_STEP * 1000.0f << " ms dropped";
+    cout << endl;
+
+    _secondTime = 0.0f;
+    _secondSteps = 0;
+    _secondSubdivided = 0;
+    _secondDropped = 0.0f;
+}
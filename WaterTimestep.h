@@ -0,0 +1,91 @@
+#ifndef WATERTIMESTEP_H
+#define WATERTIMESTEP_H
+
+#include <vector>
+
+class WaterSolver;
+
+
+// Stability driven step length of a solver, in nominal steps of a 60th of
+// a second.
+//
+// Frames add their duration to a pending time. Steps are then taken as
+// long as the pending time covers a stable step, each one as long as the
+// current surface allows. Calm water thus skips frames, sharp fronts are
+// subdivided. The step is bounded by the linear stability of the stencil,
+// and by a maximum height change per step, estimated from the steepest
+// wet gradient and the fastest velocity the solver gathers as it steps.
+//
+// Steps shorter than the nominal one are paid for with the steps calm
+// water saved, so the timestep never takes more steps than fixed steps
+// would over the same time. Only the stability of the stencil may ask for
+// more.
+class WaterTimestep
+{
+public:
+    // The solver must track its bounds
+    WaterTimestep(const WaterSolver& solver);
+
+    // Nominal steps of time to cover
+    void addTime(float nominalSteps);
+
+    // Length of the next step, 0 when the pending time is shorter than a
+    // stable step or the frame has taken its maximum of substeps. The time
+    // such a frame leaves uncovered is dropped.
+    float nextScale(const WaterSolver& solver);
+
+    // Bound of the step length on the current surface, and the length of
+    // step the saved steps allow
+    float stableScale(const WaterSolver& solver) const;
+
+    float pendingTime() const;
+    float droppedTime() const;
+    int stepCount() const;
+
+    static const float NOMINAL_STEP;
+
+protected:
+    void logSecond();
+
+private:
+    static const float _SAFETY;
+    static const float _MAX_HEIGHT_CHANGE;
+    static const int _MAX_SUBSTEPS;
+
+    float _stretchness;
+    float _waveScale;
+
+    float _pendingTime;
+    float _droppedTime;
+    float _savedSteps;
+    int _frameSubsteps;
+    int _stepCount;
+
+    // Steps of the current simulated second, for the log
+    float _secondTime;
+    int _secondSteps;
+    float _secondMinScale;
+    float _secondMaxScale;
+    int _secondSubdivided;
+    float _secondDropped;
+};
+
+
+
+// IMPLEMENTATION //
+inline float WaterTimestep::pendingTime() const
+{
+    return _pendingTime;
+}
+
+inline float WaterTimestep::droppedTime() const
+{
+    return _droppedTime;
+}
+
+inline int WaterTimestep::stepCount() const
+{
+    return _stepCount;
+}
+
+#endif // WATERTIMESTEP_H
@@ -0,0 +1,237 @@
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <algorithm>
+
+#include <pthread.h>
+#include <sched.h>
+
+using namespace std;
+
+
+namespace
+{
+    struct ParallelForState
+    {
+        int begin;
+        int end;
+        int chunkSize;
+        int chunkCount;
+        function<void(int, int)> body;
+
+        atomic<int> nextChunk;
+        atomic<bool> hasFailed;
+        int doneChunks;
+        exception_ptr error;
+        mutex doneMutex;
+        condition_variable allDone;
+
+        // Chunks left after a failure are counted without running them,
+        // the caller rethrows the first error once they are all counted
+        void runChunks()
+        {
+            for(int c = nextChunk++; c < chunkCount; c = nextChunk++)
+            {
+                exception_ptr chunkError;
+                if(!hasFailed.load(memory_order_relaxed))
+                {
+                    int chunkBegin = begin + c * chunkSize;
+                    try
+                    {
+                        body(chunkBegin, min(chunkBegin + chunkSize, end));
+                    }
+                    catch(...)
+                    {
+                        chunkError = current_exception();
+                        hasFailed.store(true, memory_order_relaxed);
+                    }
+                }
+
+                lock_guard<mutex> lock(doneMutex);
+                if(chunkError && !error)
+                    error = chunkError;
+                if(++doneChunks == chunkCount)
+                    allDone.notify_all();
+            }
+        }
+    };
+}
+
+
+WorkerPool::WorkerPool(int threadCount) :
+    _threads(),
+    _mutex(),
+    _wakeUp(),
+    _tasks(),
+    _workerTasks(threadCount),
+    _isStopping(false)
+{
+    for(int t=0; t < threadCount; ++t)
+        _threads.push_back(thread(&WorkerPool::work, this, t));
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+        _isStopping = true;
+    }
+    _wakeUp.notify_all();
+
+    for(size_t t=0; t < _threads.size(); ++t)
+        _threads[t].join();
+}
+
+std::future<void> WorkerPool::submit(const std::function<void()>& task)
+{
+    shared_ptr<packaged_task<void()>> packaged(new packaged_task<void()>(task));
+    future<void> result = packaged->get_future();
+
+    if(_threads.empty())
+    {
+        (*packaged)();
+        return result;
+    }
+
+    {
+        lock_guard<mutex> lock(_mutex);
+        _tasks.push_back([packaged]() {(*packaged)();});
+    }
+    _wakeUp.notify_one();
+
+    return result;
+}
+
+void WorkerPool::parallelFor(int begin, int end,
+                             const std::function<void(int, int)>& body)
+{
+    if(begin >= end)
+        return;
+
+    // A few chunks per thread to even out uneven rows
+    int participants = threadCount() + 1;
+    int count = end - begin;
+
+    shared_ptr<ParallelForState> state(new ParallelForState());
+    state->begin = begin;
+    state->end = end;
+    state->chunkCount = min(count, participants * 4);
+    state->chunkSize = (count + state->chunkCount - 1) / state->chunkCount;
+    state->chunkCount = (count + state->chunkSize - 1) / state->chunkSize;
+    state->body = body;
+    state->nextChunk.store(0);
+    state->hasFailed.store(false);
+    state->doneChunks = 0;
+
+    int helpers = min(threadCount(), state->chunkCount - 1);
+    if(helpers > 0)
+    {
+        {
+            lock_guard<mutex> lock(_mutex);
+            for(int h=0; h < helpers; ++h)
+                _tasks.push_back([state]() {state->runChunks();});
+        }
+        _wakeUp.notify_all();
+    }
+
+    state->runChunks();
+
+    unique_lock<mutex> lock(state->doneMutex);
+    state->allDone.wait(lock, [&state]() {
+        return state->doneChunks == state->chunkCount;});
+
+    if(state->error)
+        rethrow_exception(state->error);
+}
+
+void WorkerPool::runOnWorkers(const std::function<void(int)>& body)
+{
+    if(_threads.empty())
+    {
+        body(0);
+        return;
+    }
+
+    int remaining = threadCount();
+    exception_ptr error;
+    mutex doneMutex;
+    condition_variable allDone;
+    {
+        lock_guard<mutex> lock(_mutex);
+        for(int w=0; w < threadCount(); ++w)
+        {
+            _workerTasks[w].push_back([&, w]()
+            {
+                exception_ptr workerError;
+                try
+                {
+                    body(w);
+                }
+                catch(...)
+                {
+                    workerError = current_exception();
+                }
+
+                lock_guard<mutex> doneLock(doneMutex);
+                if(workerError && !error)
+                    error = workerError;
+                if(--remaining == 0)
+                    allDone.notify_all();
+            });
+        }
+    }
+    _wakeUp.notify_all();
+
+    unique_lock<mutex> lock(doneMutex);
+    allDone.wait(lock, [&remaining]() {return remaining == 0;});
+
+    // The first worker to fail, once every worker is done with body
+    if(error)
+        rethrow_exception(error);
+}
+
+bool WorkerPool::pinWorkers(const std::vector<int>& cpus)
+{
+    bool isPinned = true;
+    for(size_t w=0; w < _threads.size() && w < cpus.size(); ++w)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[w], &set);
+        isPinned = pthread_setaffinity_np(_threads[w].native_handle(),
+                                          sizeof(set), &set) == 0 && isPinned;
+    }
+    return isPinned && cpus.size() >= _threads.size();
+}
+
+void WorkerPool::work(int worker)
+{
+    deque<function<void()>>& ownTasks = _workerTasks[worker];
+    for(;;)
+    {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(_mutex);
+            _wakeUp.wait(lock, [&]() {
+                return _isStopping || !ownTasks.empty() || !_tasks.empty();});
+
+            // Tasks meant for this worker go first
+            deque<function<void()>>& tasks = ownTasks.empty() ? _tasks : ownTasks;
+            if(tasks.empty())
+                return;
+
+            task = move(tasks.front());
+            tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+WorkerPool& getWorkerPool()
+{
+    static WorkerPool pool(max(static_cast<int>(thread::hardware_concurrency()) - 1, 0));
+    return pool;
+}
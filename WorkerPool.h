@@ -0,0 +1,63 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <future>
+#include <functional>
+#include <condition_variable>
+
+
+// Fixed set of worker threads running queued tasks. parallelFor() splits a
+// range in chunks shared by the workers and the calling thread, so it may
+// be called from a task without starving the pool.
+class WorkerPool
+{
+public:
+    WorkerPool(int threadCount);
+    ~WorkerPool();
+
+    int threadCount() const;
+
+    std::future<void> submit(const std::function<void()>& task);
+
+    // Runs body(chunkBegin, chunkEnd) over [begin, end) and waits for it. The
+    // first exception thrown by body is rethrown once every chunk is done
+    void parallelFor(int begin, int end,
+                     const std::function<void(int, int)>& body);
+
+    // Runs body(worker) once on each worker thread and waits for them, so
+    // a worker keeps the same share from one call to the next. Without
+    // workers, the calling thread runs body(0). The first exception thrown
+    // by a worker is rethrown once they are all done.
+    void runOnWorkers(const std::function<void(int)>& body);
+
+    // Binds worker w to cpus[w], returns false if any could not be bound
+    bool pinWorkers(const std::vector<int>& cpus);
+
+protected:
+    void work(int worker);
+
+private:
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _wakeUp;
+    std::deque<std::function<void()>> _tasks;
+    std::vector<std::deque<std::function<void()>>> _workerTasks;
+    bool _isStopping;
+};
+
+// Process wide pool, one worker per core besides the calling thread
+WorkerPool& getWorkerPool();
+
+
+
+// IMPLEMENTATION //
+inline int WorkerPool::threadCount() const
+{
+    return static_cast<int>(_threads.size());
+}
+
+#endif // WORKERPOOL_H
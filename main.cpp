@@ -1,4 +1,5 @@
 #include <exception>
+#include <fstream>
 #include <iostream>
 using namespace std;
 
@@ -11,14 +12,48 @@ using namespace cellar;
 using namespace scaena;
 
 #include "WaterPlay.h"
+#include "WaterOptions.h"
+#include "MemoryAccounting.h"
+#include "HeadlessWaterRun.h"
+#include "SessionRecord.h"
+
+
+namespace
+{
+    // The run is still alive here, current bytes are those of its end
+    int finish(const WaterOptions& options, int status)
+    {
+        if(!options.memoryReport.empty())
+        {
+            ofstream report(options.memoryReport.c_str());
+            getMemoryAccounting().report(report, double(options.width) * options.height);
+            cout << "Memory report written to " << options.memoryReport << endl;
+        }
+        return status;
+    }
+}
 
 
 int main(int argc, char** argv) try
 {
     getLog().setOuput(cout);
 
+    WaterOptions options;
+    if(!options.parse(argc, argv))
+    {
+        cerr << WaterOptions::usage();
+        return 1;
+    }
+
+    unique_ptr<HeadlessWaterRun> run = HeadlessWaterRun::create(options);
+    if(run)
+        return finish(options, run->execute());
+
+    if(!options.replayFile.empty())
+        options = SessionPlayer(options.replayFile).recordedOptions(options);
+
     getApplication().init(argc, argv);
-    getApplication().setPlay(std::shared_ptr<AbstractPlay>(new WaterPlay()));
+    getApplication().setPlay(std::shared_ptr<AbstractPlay>(new WaterPlay(options)));
 
     QGLStage* stage = new QGLStage();
     getApplication().addCustomStage(stage);
@@ -32,7 +67,7 @@ int main(int argc, char** argv) try
     stage->setDrawSynch( true );
     stage->setUpdateInterval( 16 );
 
-    return getApplication().execute();
+    return finish(options, getApplication().execute());
 }
 catch(exception& e)
 {
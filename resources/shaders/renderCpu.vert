@@ -3,6 +3,7 @@
 uniform mat4 Projection;
 uniform mat4 View;
 uniform mat3 Normal;
+uniform vec3 Offset;
 
 attribute vec3 position;
 attribute vec3 normal;
@@ -16,6 +17,6 @@ void main(void)
 {
     texc = texCoord;
     norm = Normal * normal;
-    fragPos = View * vec4(position, 1);
+    fragPos = View * vec4(position + Offset, 1);
     gl_Position = Projection * fragPos;
 }
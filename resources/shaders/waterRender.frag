@@ -10,6 +10,6 @@ in vec3 normal;
 
 void main(void)
 {
-    normal = normalize(normal);
-    gl_FragColor = vec4(texture(WaterHeightTex, position).rgb * Color.rgb, Color.a);
+    vec3 pos = vec3(position, texture(WaterHeightTex, position).r);
+    gl_FragColor = vec4(pos * Color.rgb, Color.a);
 }
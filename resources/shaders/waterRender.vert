@@ -12,9 +12,12 @@ out vec3 normal;
 void main(void)
 {
     position = position_att.xy;
-    vec3 pos = texture(HeightTex, position).xyz;
-    vec3 posRt = textureOffset(HeightTex, position, ivec2(1, 0)).xyz;
-    vec3 posUp = textureOffset(HeightTex, position, ivec2(0, 1)).xyz;
+    vec2 texel = 1.0 / vec2(textureSize(HeightTex, 0));
+    vec3 pos   = vec3(position, texture(HeightTex, position).r);
+    vec3 posRt = vec3(position + vec2(texel.x, 0.0),
+                      textureOffset(HeightTex, position, ivec2(1, 0)).r);
+    vec3 posUp = vec3(position + vec2(0.0, texel.y),
+                      textureOffset(HeightTex, position, ivec2(0, 1)).r);
     normal = cross(posRt - pos, posUp - pos) / Scale;
     gl_Position = Projection * View * vec4(pos * Scale, 1.0);
 }
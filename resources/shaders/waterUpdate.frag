@@ -0,0 +1,58 @@
+#version 130
+
+uniform sampler2D GroundHeightTex;
+uniform sampler2D WaterHeightTex;
+uniform sampler2D WaterVelocityTex;
+
+out float WaterVelocity;
+out float WaterHeight;
+
+const ivec2 offsets[25] = ivec2[25](
+    ivec2(-2, -2), ivec2(-1, -2), ivec2(0, -2), ivec2(1, -2), ivec2(2, -2),
+    ivec2(-2, -1), ivec2(-1, -1), ivec2(0, -1), ivec2(1, -1), ivec2(2, -1),
+    ivec2(-2,  0), ivec2(-1,  0), ivec2(0,  0), ivec2(1,  0), ivec2(2,  0),
+    ivec2(-2,  1), ivec2(-1,  1), ivec2(0,  1), ivec2(1,  1), ivec2(2,  1),
+    ivec2(-2,  2), ivec2(-1,  2), ivec2(0,  2), ivec2(1,  2), ivec2(2,  2)
+);
+const float coeffs[25] = float[25](
+    0, 3, 4, 3, 0,
+    3, 6, 7, 6, 3,
+    4, 7, 0, 7, 4,
+    3, 6, 7, 6, 3,
+    0, 3, 4, 3, 0
+);
+
+void main(void)
+{
+    // Offsets are not constant in the loop, so neighbors are fetched
+    // and clamped to the edge by hand
+    ivec2 cell = ivec2(gl_FragCoord.xy);
+    ivec2 last = textureSize(WaterHeightTex, 0) - ivec2(1);
+
+    float mgh = texelFetch(GroundHeightTex,  cell, 0).r;
+    float mwh = texelFetch(WaterHeightTex,   cell, 0).r;
+    float mwv = texelFetch(WaterVelocityTex, cell, 0).r;
+    float mwp = max(mwh - mgh, 0.0);
+
+    float acc = 0.0;
+    float sum = 0.0;
+    for(int i=0; i < 25; ++i)
+    {
+        ivec2 neighbor = clamp(cell + offsets[i], ivec2(0), last);
+        float gh = texelFetch(GroundHeightTex, neighbor, 0).r;
+        float wh = texelFetch(WaterHeightTex,  neighbor, 0).r;
+        float wp = max(wh - gh, 0.0);
+
+        float door = step(0.0, mwh - gh) * step(0.0, wh - mgh);
+
+        sum += (wp - mwp) * door * coeffs[i];
+        acc += coeffs[i];
+    }
+
+    float f = -mwv * 0.001;
+    float v = mwv + f + (sum/acc)*0.8;
+
+    // Water never sinks under the ground before moving
+    WaterVelocity = v;
+    WaterHeight = max(mwh, mgh) + v;
+}
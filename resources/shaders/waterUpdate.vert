@@ -1,10 +1,8 @@
 #version 130
 
-in  vec3 position_att;
-out vec2 position;
+in vec3 position_att;
 
 void main(void)
 {
-    position = position_att.xy;
     gl_Position = vec4(position_att*2.0 -vec3(1.0), 1.0);
 }